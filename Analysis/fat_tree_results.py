@@ -38,6 +38,6 @@ def plot_all_metrics_per_scenario(df, scenario_label):
     # plt.show()
     plt.savefig(f"{scenario_label}_comparison.png")
 
-# Filter and plot for Scenario 1
-df_scenario1 = df_clean[df_clean["Scenario"] == "Scenario1"]
-plot_all_metrics_per_scenario(df_scenario1, "Fat Tree (K=4)")
+# Filter and plot the k=4 fat tree (older result files label it Scenario1)
+df_k4 = df_clean[df_clean["Scenario"].isin(["FatTree-k4", "Scenario1"])]
+plot_all_metrics_per_scenario(df_k4, "Fat Tree (K=4)")
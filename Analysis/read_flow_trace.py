@@ -0,0 +1,63 @@
+import struct
+import sys
+
+import numpy as np
+import pandas as pd
+import matplotlib.pyplot as plt
+
+# Matches FlowTraceSample in flow_tracer.h
+SAMPLE = np.dtype([("time_ns", "<u8"), ("rx_bytes", "<u8"), ("pacing_bps", "<u8"),
+                   ("cwnd_bytes", "<u4"), ("rtt_us", "<u4")])
+
+
+def load_flow_trace(path):
+    """Reads a .ftrc file into one DataFrame with a row per flow sample."""
+    with open(path, "rb") as f:
+        data = f.read()
+
+    magic, version, interval_ns, n_flows = struct.unpack_from("<4sIQI", data, 0)
+    if magic != b"FTRC" or version != 1:
+        raise ValueError(f"{path} is not a version 1 flow trace")
+    off = 20
+    names = []
+    for _ in range(n_flows):
+        (length,) = struct.unpack_from("<H", data, off)
+        names.append(data[off + 2:off + 2 + length].decode())
+        off += 2 + length
+
+    blocks = [[] for _ in range(n_flows)]
+    while off < len(data):
+        flow, count = struct.unpack_from("<II", data, off)
+        off += 8
+        blocks[flow].append(np.frombuffer(data, SAMPLE, count, off))
+        off += count * SAMPLE.itemsize
+
+    frames = []
+    for name, parts in zip(names, blocks):
+        if not parts:
+            continue
+        df = pd.DataFrame(np.concatenate(parts))
+        df["flow"] = name
+        frames.append(df)
+    df = pd.concat(frames, ignore_index=True)
+    df["time_s"] = df["time_ns"] / 1e9
+    df["rtt_ms"] = df["rtt_us"] / 1e3
+    # Goodput over each sampling interval
+    df["goodput_mbps"] = df.groupby("flow")["rx_bytes"].diff().fillna(0) * 8 / (interval_ns / 1e9) / 1e6
+    return df
+
+
+if __name__ == "__main__":
+    trace = load_flow_trace(sys.argv[1])
+    fig, axs = plt.subplots(3, 1, figsize=(12, 9), sharex=True)
+    for flow, df in trace.groupby("flow"):
+        axs[0].plot(df["time_s"], df["cwnd_bytes"], label=flow)
+        axs[1].plot(df["time_s"], df["rtt_ms"], label=flow)
+        axs[2].plot(df["time_s"], df["goodput_mbps"], label=flow)
+    axs[0].set_ylabel("cwnd (bytes)")
+    axs[1].set_ylabel("RTT (ms)")
+    axs[2].set_ylabel("Goodput (Mbps)")
+    axs[2].set_xlabel("Time (s)")
+    axs[0].legend()
+    plt.tight_layout()
+    plt.savefig(sys.argv[1] + ".png")
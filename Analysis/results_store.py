@@ -0,0 +1,76 @@
+import os
+import struct
+import sys
+
+import numpy as np
+import pandas as pd
+
+
+def load_columns(directory):
+    """Loads a --exportColumns directory; every column is memory-mapped, not parsed."""
+    with open(os.path.join(directory, "columns.txt")) as f:
+        names = [line.strip() for line in f if line.strip()]
+    columns = {}
+    for name in names:
+        file = "".join(c if c.isalnum() or c == "_" else "_" for c in name)
+        col = np.load(os.path.join(directory, file + ".npy"), mmap_mode="r")
+        columns[name] = col.astype(str) if col.dtype.kind == "S" else col
+    return pd.DataFrame(columns)
+
+
+def load_store(path):
+    """Reads a results store written with --results directly, without exporting it first."""
+    with open(path, "rb") as f:
+        data = f.read()
+
+    magic, version, n_metrics = struct.unpack_from("<4sII", data, 0)
+    if magic != b"SRES" or version != 2:
+        raise ValueError(f"{path} is not a version 2 results store")
+    off = 12
+    metrics = []
+    for _ in range(n_metrics):
+        (length,) = struct.unpack_from("<H", data, off)
+        metrics.append(data[off + 2:off + 2 + length].decode())
+        off += 2 + length
+
+    # Matches ResultsStore::Encode in results_store.h
+    record = np.dtype([("Scenario", "S128"), ("Variant", "S128"), ("Flow", "S128"), ("CodeVersion", "S128"),
+                       ("CBR(Mbps)", "<f8"), ("Seed", "<u4"), ("Run", "<u4")]
+                      + [(m, "<f8") for m in metrics] + [("checksum", "<u4"), ("pad", "<u4")])
+    count = (len(data) - off) // record.itemsize
+    # Like ResultsStore::Open, stop at the first record whose checksum does not match
+    for i in range(count):
+        start = off + i * record.itemsize
+        (stored,) = struct.unpack_from("<I", data, start + record.itemsize - 8)
+        if stored != fnv1a(data[start:start + record.itemsize - 8]):
+            count = i
+            break
+    df = pd.DataFrame(np.frombuffer(data, record, count, off)).drop(columns=["checksum", "pad"])
+    for name in ("Scenario", "Variant", "Flow", "CodeVersion"):
+        df[name] = df[name].str.decode("ascii")
+
+    # Keep the rows of the last completed attempt of every configuration, as the
+    # store itself does: a #begin marker starts an attempt, #complete accepts it
+    attempt, completed = {}, {}
+    keys = zip(df["CodeVersion"], df["Scenario"], df["Variant"], df["CBR(Mbps)"], df["Seed"], df["Run"])
+    for i, (key, flow) in enumerate(zip(keys, df["Flow"])):
+        if flow == "#begin":
+            attempt[key] = []
+        elif flow == "#complete":
+            completed[key] = attempt.get(key, [])
+        else:
+            attempt.setdefault(key, []).append(i)
+    rows = sorted(i for rows in completed.values() for i in rows)
+    return df.iloc[rows].reset_index(drop=True)
+
+
+def fnv1a(data):
+    h = 2166136261
+    for b in data:
+        h = ((h ^ b) * 16777619) & 0xFFFFFFFF
+    return h
+
+
+if __name__ == "__main__":
+    path = sys.argv[1]
+    print(load_columns(path) if os.path.isdir(path) else load_store(path))
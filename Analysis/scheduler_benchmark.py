@@ -0,0 +1,72 @@
+"""Runs Scenarios 1-4 and the fat tree under every ns-3 event scheduler.
+
+Usage: python3 scheduler_benchmark.py <ns-3 directory> [output directory]
+
+Both programs must already be in the ns-3 scratch/ directory. Every workload runs
+serially (--jobs=1) so the timings are not skewed by other workers. The result rows
+of each workload must be identical under all schedulers; the script reports events
+per second per workload and scheduler and the fastest scheduler for each workload.
+"""
+import os
+import subprocess
+import sys
+
+import pandas as pd
+
+SCHEDULERS = ["Map", "Heap", "List", "Calendar", "PriorityQueue"]
+FAT_TREE_SIZES = [4, 8, 16]
+
+# (workload name, program, arguments)
+WORKLOADS = [(f"Scenario{i}", "tcp_congestion_control_simulation",
+              f"--scenarios=Scenario{i} --jobs=1") for i in range(1, 5)]
+WORKLOADS += [(f"FatTree-k{k}", "fat_tree_simulation", f"--k={k} --variant=TcpCubic --jobs=1")
+              for k in FAT_TREE_SIZES]
+
+
+def run(ns3_dir, out_dir, workload, program, args, scheduler):
+    perf = os.path.join(out_dir, f"{workload}-{scheduler}-perf.csv")
+    if os.path.exists(perf):
+        os.remove(perf)
+    cmd = f"scratch/{program} {args} --scheduler={scheduler} --perfOut={os.path.abspath(perf)}"
+    result = subprocess.run(["./ns3", "run", "--no-build", cmd], cwd=ns3_dir, check=True,
+                            capture_output=True, text=True)
+    return result.stdout, pd.read_csv(perf)
+
+
+def main():
+    ns3_dir = sys.argv[1]
+    out_dir = sys.argv[2] if len(sys.argv) > 2 else "scheduler_benchmark"
+    os.makedirs(out_dir, exist_ok=True)
+
+    rows = []
+    mismatches = []
+    for workload, program, args in WORKLOADS:
+        reference = None
+        for scheduler in SCHEDULERS:
+            print(f"{workload} / {scheduler}", file=sys.stderr)
+            output, perf = run(ns3_dir, out_dir, workload, program, args, scheduler)
+            if reference is None:
+                reference = output
+            elif output != reference:
+                mismatches.append((workload, scheduler))
+            rows.append({"Workload": workload, "Scheduler": scheduler,
+                         "Events": perf["Events"].sum(), "RunSec": perf["RunSec"].sum(),
+                         "MaxPendingEvents": perf["MaxPendingEvents"].max()})
+
+    df = pd.DataFrame(rows)
+    df["EventsPerSec"] = df["Events"] / df["RunSec"]
+    df.to_csv(os.path.join(out_dir, "scheduler_benchmark.csv"), index=False)
+    print(df.pivot(index="Workload", columns="Scheduler", values="EventsPerSec").round(0))
+    fastest = df.loc[df.groupby("Workload")["EventsPerSec"].idxmax(), ["Workload", "Scheduler", "EventsPerSec"]]
+    print("\nFastest scheduler per workload:")
+    print(fastest.to_string(index=False))
+
+    if mismatches:
+        for workload, scheduler in mismatches:
+            print(f"MISMATCH: {workload} under {scheduler} differs from {SCHEDULERS[0]}", file=sys.stderr)
+        sys.exit(1)
+    print("\nAll schedulers produced identical results.")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,184 @@
+#ifndef BOTTLENECK_AQM_H
+#define BOTTLENECK_AQM_H
+
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/point-to-point-module.h"
+#include "ns3/traffic-control-module.h"
+
+#include "flow_probe.h"
+#include "results_store.h"
+
+#include <fstream>
+#include <string>
+
+namespace ns3 {
+
+struct BottleneckQueueOptions
+{
+    // Default keeps what the stack installed; otherwise DropTail, RED, CoDel,
+    // FqCoDel, PIE or DctcpStep.
+    std::string aqm = "Default";
+    bool ecn = false;                   // AQMs mark ECN-capable packets instead of dropping them
+    std::string limit = "100p";         // queue disc capacity
+    double markThreshold = 20;          // DctcpStep: mark every packet above this many queued packets
+};
+
+inline bool IsDefaultAqm (const std::string& aqm)
+{
+    return aqm.empty () || aqm == "Default";
+}
+
+// Root queue disc of one bottleneck device and what it did during the run: drops,
+// ECN marks, time-averaged occupancy and sojourn times. Without a queue disc (the
+// default of hand-addressed devices) the device queue is watched instead, which has
+// no sojourn times.
+class BottleneckQueue
+{
+public:
+    // Replaces the root queue disc of device with the one options name. The device
+    // queue shrinks to one packet so that the queue builds up where the AQM sees it.
+    void Install (Ptr<NetDevice> device, const BottleneckQueueOptions& options)
+    {
+        if (!IsDefaultAqm (options.aqm))
+        {
+            TrafficControlHelper tch;
+            if (options.aqm == "DropTail")
+            {
+                tch.SetRootQueueDisc ("ns3::FifoQueueDisc", "MaxSize", StringValue (options.limit));
+            }
+            else if (options.aqm == "RED")
+            {
+                tch.SetRootQueueDisc ("ns3::RedQueueDisc", "MaxSize", StringValue (options.limit),
+                                      "UseEcn", BooleanValue (options.ecn));
+            }
+            else if (options.aqm == "CoDel")
+            {
+                tch.SetRootQueueDisc ("ns3::CoDelQueueDisc", "MaxSize", StringValue (options.limit),
+                                      "UseEcn", BooleanValue (options.ecn));
+            }
+            else if (options.aqm == "FqCoDel")
+            {
+                tch.SetRootQueueDisc ("ns3::FqCoDelQueueDisc", "MaxSize", StringValue (options.limit),
+                                      "UseEcn", BooleanValue (options.ecn));
+            }
+            else if (options.aqm == "PIE")
+            {
+                tch.SetRootQueueDisc ("ns3::PieQueueDisc", "MaxSize", StringValue (options.limit),
+                                      "UseEcn", BooleanValue (options.ecn));
+            }
+            else if (options.aqm == "DctcpStep")
+            {
+                // RED degenerated into the DCTCP marking rule: instantaneous queue, one threshold.
+                // Gentle RED would ramp the marking probability up to 2 * MaxTh, so it is off
+                // and every packet arriving at a queue of K or more is marked.
+                tch.SetRootQueueDisc ("ns3::RedQueueDisc", "MaxSize", StringValue (options.limit),
+                                      "UseEcn", BooleanValue (true), "UseHardDrop", BooleanValue (false),
+                                      "Gentle", BooleanValue (false), "QW", DoubleValue (1.0),
+                                      "MinTh", DoubleValue (options.markThreshold),
+                                      "MaxTh", DoubleValue (options.markThreshold));
+            }
+            else
+            {
+                NS_ABORT_MSG ("Unknown AQM: " << options.aqm);
+            }
+            Ptr<TrafficControlLayer> tc = device->GetNode ()->GetObject<TrafficControlLayer> ();
+            if (tc->GetRootQueueDiscOnDevice (device))
+            {
+                tch.Uninstall (device);
+            }
+            tch.Install (device);
+            DynamicCast<PointToPointNetDevice> (device)->GetQueue ()->SetMaxSize (QueueSize ("1p"));
+        }
+
+        Ptr<TrafficControlLayer> tc = device->GetNode ()->GetObject<TrafficControlLayer> ();
+        m_qdisc = tc ? tc->GetRootQueueDiscOnDevice (device) : nullptr;
+        if (m_qdisc)
+        {
+            m_qdisc->TraceConnectWithoutContext ("PacketsInQueue", MakeCallback (&BottleneckQueue::Occupancy, this));
+            m_qdisc->TraceConnectWithoutContext ("SojournTime", MakeCallback (&BottleneckQueue::Sojourn, this));
+        }
+        else
+        {
+            m_queue = DynamicCast<PointToPointNetDevice> (device)->GetQueue ();
+            m_queue->TraceConnectWithoutContext ("PacketsInQueue", MakeCallback (&BottleneckQueue::Occupancy, this));
+        }
+    }
+
+    uint64_t GetDrops () const
+    {
+        return m_qdisc ? m_qdisc->GetStats ().nTotalDroppedPackets : m_queue->GetTotalDroppedPackets ();
+    }
+
+    uint64_t GetMarks () const { return m_qdisc ? m_qdisc->GetStats ().nTotalMarkedPackets : 0; }
+
+    // Packets queued, averaged over time since Install.
+    double GetMeanPackets () const
+    {
+        double now = Simulator::Now ().GetSeconds ();
+        double area = m_area + m_packets * (now - m_lastChange);
+        return now > 0 ? area / now : 0;
+    }
+
+    // Fills the queue columns of a result row.
+    void Fill (ResultRecord& r) const
+    {
+        r.queueDrops = GetDrops ();
+        r.queueMarks = GetMarks ();
+        r.queueMeanPackets = GetMeanPackets ();
+        if (m_qdisc)
+        {
+            r.sojournP50Ms = m_sojourn.total ? m_sojourn.Percentile (0.5) / 1e6 : -1;
+            r.sojournP99Ms = m_sojourn.total ? m_sojourn.Percentile (0.99) / 1e6 : -1;
+        }
+    }
+
+    // Writes "Time(s),Packets,Bytes,MaxSojourn(ms)" every interval from start
+    // (absolute time) on; the sojourn column is the largest since the last line.
+    void Trace (const std::string& path, Time interval, Time start)
+    {
+        m_trace.open (path);
+        NS_ABORT_MSG_IF (!m_trace, "Cannot open queue trace " << path);
+        m_trace << "Time(s),Packets,Bytes,MaxSojourn(ms)\n";
+        m_traceInterval = interval;
+        Simulator::Schedule (std::max (start - Simulator::Now (), Time (0)), &BottleneckQueue::Sample, this);
+    }
+
+private:
+    void Occupancy (uint32_t, uint32_t packets)
+    {
+        double now = Simulator::Now ().GetSeconds ();
+        m_area += m_packets * (now - m_lastChange);
+        m_lastChange = now;
+        m_packets = packets;
+    }
+
+    void Sojourn (Time sojourn)
+    {
+        m_sojourn.Record (sojourn.GetNanoSeconds ());
+        m_maxSojourn = std::max (m_maxSojourn, sojourn);
+    }
+
+    void Sample ()
+    {
+        uint32_t bytes = m_qdisc ? m_qdisc->GetNBytes () : m_queue->GetNBytes ();
+        m_trace << Simulator::Now ().GetSeconds () << "," << m_packets << "," << bytes << ","
+                << m_maxSojourn.GetSeconds () * 1000.0 << "\n";
+        m_maxSojourn = Time (0);
+        Simulator::Schedule (m_traceInterval, &BottleneckQueue::Sample, this);
+    }
+
+    Ptr<QueueDisc> m_qdisc;
+    Ptr<Queue<Packet>> m_queue;
+    uint32_t m_packets = 0;
+    double m_lastChange = 0;
+    double m_area = 0;                  // packet-seconds
+    LogHistogram m_sojourn;
+    Time m_maxSojourn;
+    std::ofstream m_trace;
+    Time m_traceInterval;
+};
+
+} // namespace ns3
+
+#endif // BOTTLENECK_AQM_H
@@ -0,0 +1,185 @@
+#ifndef CONVERGENCE_MONITOR_H
+#define CONVERGENCE_MONITOR_H
+
+#include "ns3/core-module.h"
+#include "ns3/flow-monitor-module.h"
+
+#include "flow_probe.h"
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <vector>
+
+namespace ns3 {
+
+// 97.5% quantile of Student's t: tabulated up to 30 degrees of freedom, beyond that
+// from its Cornish-Fisher expansion around 1.96.
+inline double StudentT975 (double dof)
+{
+    static const double table[] = {12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+                                   2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+                                   2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042};
+    if (dof >= 1 && dof <= 30)
+    {
+        return table[int (dof) - 1];
+    }
+    const double z = 1.959964;
+    double z3 = z * z * z;
+    double z5 = z3 * z * z;
+    return z + (z3 + z) / (4 * dof) + (5 * z5 + 16 * z3 + 3 * z) / (96 * dof * dof);
+}
+
+struct ConvergenceOptions
+{
+    bool enabled = false;
+    Time window = Seconds (2);     // batch length; batches must be long enough to be nearly independent
+    double precision = 0.05;       // target 95% half-width relative to the mean
+    Time minTime = Seconds (20);   // measured time before stopping is considered
+    Time maxTime = Seconds (0);    // measured time after which the run stops anyway, 0 leaves it to the scenario
+    uint32_t minBatches = 5;
+};
+
+// Cumulative counters of the measured flow.
+struct ConvergenceCounters
+{
+    uint64_t rxBytes = 0;
+    uint64_t rxPackets = 0;
+    double delaySumSec = 0;
+};
+
+// Batch-means steady-state detector. Every window it samples the measured flow,
+// turns the increments into one goodput and one mean-delay batch, and calls
+// Simulator::Stop once the 95% confidence intervals of both batch means are
+// within the target precision. The first window (slow start) is discarded.
+class ConvergenceMonitor
+{
+public:
+    typedef std::function<ConvergenceCounters ()> Sampler;
+
+    ConvergenceMonitor (const ConvergenceOptions& options, Sampler sampler)
+        : m_options (options),
+          m_sampler (sampler)
+    {
+    }
+
+    // Watches from the absolute time start, normally the start of the measured flow.
+    // Batches stay aligned to start even when the monitor is attached later, as in a
+    // run resumed from a warm-up snapshot.
+    void Start (Time start)
+    {
+        m_start = start;
+        Time first = start + m_options.window;
+        while (first < Simulator::Now ())
+        {
+            first += m_options.window;
+        }
+        Simulator::Schedule (first - Simulator::Now (), &ConvergenceMonitor::Check, this);
+    }
+
+    bool Converged () const { return m_converged; }
+
+private:
+    void Check ()
+    {
+        ConvergenceCounters now = m_sampler ();
+        if (m_primed)
+        {
+            double window = m_options.window.GetSeconds ();
+            m_goodput.push_back ((now.rxBytes - m_last.rxBytes) * 8.0 / window);
+            if (now.rxPackets > m_last.rxPackets)
+            {
+                m_delay.push_back ((now.delaySumSec - m_last.delaySumSec) / (now.rxPackets - m_last.rxPackets));
+            }
+        }
+        m_primed = true;
+        m_last = now;
+
+        Time elapsed = Simulator::Now () - m_start;
+        if (elapsed >= m_options.minTime && Precise (m_goodput) && Precise (m_delay))
+        {
+            m_converged = true;
+            Simulator::Stop ();
+            return;
+        }
+        if (m_options.maxTime.IsStrictlyPositive () && elapsed >= m_options.maxTime)
+        {
+            Simulator::Stop ();
+            return;
+        }
+        Simulator::Schedule (m_options.window, &ConvergenceMonitor::Check, this);
+    }
+
+    bool Precise (const std::vector<double>& batches) const
+    {
+        size_t n = batches.size ();
+        if (n < std::max<uint32_t> (2, m_options.minBatches))
+        {
+            return false;
+        }
+        double mean = 0;
+        for (double b : batches)
+        {
+            mean += b;
+        }
+        mean /= n;
+        double var = 0;
+        for (double b : batches)
+        {
+            var += (b - mean) * (b - mean);
+        }
+        var /= n - 1;
+        return mean > 0 && StudentT975 (n - 1) * std::sqrt (var / n) <= m_options.precision * mean;
+    }
+
+    ConvergenceOptions m_options;
+    Sampler m_sampler;
+    Time m_start;
+    ConvergenceCounters m_last;
+    bool m_primed = false;
+    bool m_converged = false;
+    std::vector<double> m_goodput;
+    std::vector<double> m_delay;
+};
+
+// Samples the FlowMonitor counters of the flow towards a destination port.
+inline ConvergenceMonitor::Sampler FlowMonitorSampler (Ptr<FlowMonitor> monitor, Ptr<FlowClassifier> classifier,
+                                                        uint16_t port)
+{
+    Ptr<Ipv4FlowClassifier> ipv4 = DynamicCast<Ipv4FlowClassifier> (classifier);
+    return [monitor, ipv4, port] () {
+        ConvergenceCounters c;
+        for (const auto& entry : monitor->GetFlowStats ())
+        {
+            if (ipv4->FindFlow (entry.first).destinationPort == port)
+            {
+                c.rxBytes += entry.second.rxBytes;
+                c.rxPackets += entry.second.rxPackets;
+                c.delaySumSec += entry.second.delaySum.GetSeconds ();
+            }
+        }
+        return c;
+    };
+}
+
+// Samples the endpoint probe counters of the TCP flow towards a destination port.
+inline ConvergenceMonitor::Sampler EndpointProbeSampler (const EndpointFlowProbe& probe, uint16_t port)
+{
+    return [&probe, port] () {
+        ConvergenceCounters c;
+        for (const auto& flow : probe.GetFlows ())
+        {
+            if (flow.first.protocol == 6 && flow.first.dstPort == port)
+            {
+                c.rxBytes += flow.second.rxBytes;
+                c.rxPackets += flow.second.rxPackets;
+                c.delaySumSec += flow.second.delaySumNs / 1e9;
+            }
+        }
+        return c;
+    };
+}
+
+} // namespace ns3
+
+#endif // CONVERGENCE_MONITOR_H
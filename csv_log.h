@@ -0,0 +1,49 @@
+#ifndef CSV_LOG_H
+#define CSV_LOG_H
+
+#include "ns3/core-module.h"
+
+#include <string>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace ns3 {
+
+// CSV file that the forked sweep workers append to through one shared O_APPEND
+// descriptor. Every Write is a single write(), so the lines of one run never
+// interleave with another's; the header is written when the file is new.
+class CsvLog
+{
+public:
+    bool IsOpen () const { return m_fd >= 0; }
+
+    // what names the log in error messages, e.g. "performance log".
+    void Open (const std::string& path, const std::string& header, const std::string& what)
+    {
+        m_what = what;
+        m_fd = open (path.c_str (), O_WRONLY | O_CREAT | O_APPEND, 0644);
+        NS_ABORT_MSG_IF (m_fd < 0, "Cannot open " << what << " " << path);
+        struct stat st;
+        NS_ABORT_MSG_IF (fstat (m_fd, &st) != 0, "Cannot stat " << what << " " << path);
+        if (st.st_size == 0)
+        {
+            Write (header);
+        }
+    }
+
+    void Write (const std::string& lines)
+    {
+        NS_ABORT_MSG_IF (write (m_fd, lines.data (), lines.size ()) != ssize_t (lines.size ()),
+                         "Short write to " << m_what);
+    }
+
+private:
+    int m_fd = -1;
+    std::string m_what;
+};
+
+} // namespace ns3
+
+#endif // CSV_LOG_H
@@ -0,0 +1,420 @@
+#ifndef DC_WORKLOAD_H
+#define DC_WORKLOAD_H
+
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/internet-module.h"
+
+#include "csv_log.h"
+#include "flow_probe.h"
+
+#include <algorithm>
+#include <fstream>
+#include <functional>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace ns3 {
+
+// Empirical flow size distribution, one "<size in bytes> <cumulative probability>"
+// point per line in increasing order (the format of the web-search and data-mining
+// CDFs of the pFabric and HPCC papers); '#' starts a comment. Sizes between two
+// points are interpolated linearly.
+class FlowSizeCdf
+{
+public:
+    void Load (const std::string& path)
+    {
+        std::ifstream in (path);
+        NS_ABORT_MSG_IF (!in, "Cannot open flow size CDF " << path);
+        std::string line;
+        while (std::getline (in, line))
+        {
+            line = line.substr (0, line.find ('#'));
+            std::istringstream fields (line);
+            double size, cdf;
+            if (!(fields >> size >> cdf))
+            {
+                continue;
+            }
+            // Some published files give the probability in percent.
+            m_points.push_back ({cdf > 1.0 ? cdf / 100.0 : cdf, size});
+        }
+        NS_ABORT_MSG_IF (m_points.empty () || m_points.back ().first < 1.0 - 1e-6,
+                         "Flow size CDF " << path << " must end at probability 1");
+        for (size_t i = 1; i < m_points.size (); ++i)
+        {
+            NS_ABORT_MSG_IF (m_points[i].first < m_points[i - 1].first || m_points[i].second < m_points[i - 1].second,
+                             "Flow size CDF " << path << " is not increasing at line " << i + 1);
+        }
+    }
+
+    double Mean () const
+    {
+        double mean = m_points.front ().first * m_points.front ().second;
+        for (size_t i = 1; i < m_points.size (); ++i)
+        {
+            mean += (m_points[i].first - m_points[i - 1].first) * (m_points[i].second + m_points[i - 1].second) / 2;
+        }
+        return mean;
+    }
+
+    // Size at cumulative probability u (0..1), at least one byte.
+    uint64_t Sample (double u) const
+    {
+        auto it = std::lower_bound (m_points.begin (), m_points.end (), std::make_pair (u, 0.0));
+        if (it == m_points.begin ())
+        {
+            return std::max<uint64_t> (1, uint64_t (it->second));
+        }
+        if (it == m_points.end ())
+        {
+            return uint64_t (m_points.back ().second);
+        }
+        auto prev = it - 1;
+        double f = (u - prev->first) / (it->first - prev->first);
+        return std::max<uint64_t> (1, uint64_t (prev->second + f * (it->second - prev->second)));
+    }
+
+private:
+    std::vector<std::pair<double, double>> m_points;   // (cumulative probability, size)
+};
+
+struct WorkloadOptions
+{
+    std::string cdfPath;            // flow sizes; the workload is off when empty
+    double load = 0.5;              // offered load relative to the capacity passed to Install
+    Time start = Seconds (1);
+    Time stop = Seconds (10);       // no flow starts after this
+    uint64_t maxFlows = 0;          // Poisson flows to start at most, 0 for no limit
+    Time incastInterval = Seconds (0);  // partition/aggregate bursts, 0 disables them
+    uint32_t incastFanIn = 100;     // senders per burst; more than there are hosts reuses hosts
+    uint64_t incastBytes = 20000;   // response size per sender
+    uint16_t port = 7000;
+    Time timeWait = MilliSeconds (10);  // TIME_WAIT of a finished flow's sockets (2 MSL, 240 s by default)
+};
+
+// Flow completion times bucketed by flow size, with incast responses and whole
+// bursts on their own. FCTs are kept in nanoseconds and slowdowns (FCT over the
+// ideal FCT) in thousandths, both in log histograms.
+struct FctReport
+{
+    static constexpr size_t kBuckets = 6;
+    static const char* BucketName (size_t b)
+    {
+        static const char* names[kBuckets] = {"<=10KB", "10KB-100KB", "100KB-1MB", ">1MB", "Incast", "IncastBurst"};
+        return names[b];
+    }
+    static size_t SizeBucket (uint64_t bytes)
+    {
+        return bytes <= 10000 ? 0 : bytes <= 100000 ? 1 : bytes <= 1000000 ? 2 : 3;
+    }
+
+    LogHistogram fct[kBuckets];
+    LogHistogram slowdown[kBuckets];
+    double fctSumMs[kBuckets] = {};
+    uint64_t started = 0;
+    uint64_t unfinished = 0;
+};
+
+// Open-loop data-center traffic between hosts: flows arrive as a Poisson process
+// sized for a target load, with sizes from an empirical CDF, plus optional incast
+// bursts. There is no application object per flow: each flow is one TCP socket
+// pair driven by this generator, its bookkeeping lives in a slot that is reused
+// once the flow completes, and the next arrival is only scheduled when the current
+// one starts. Memory therefore follows the number of concurrent flows, not the
+// number of flows in the run.
+class DcWorkload
+{
+public:
+    // Ideal completion time of a flow of bytes from senders[src] to receivers[dst].
+    typedef std::function<Time (uint32_t src, uint32_t dst, uint64_t bytes)> IdealFct;
+
+    // Flows go from a random sender to a random receiver other than itself. The
+    // arrival rate is load * capacityBps / (8 * mean flow size).
+    void Install (const NodeContainer& senders, const NodeContainer& receivers, const WorkloadOptions& options,
+                  double capacityBps, IdealFct ideal)
+    {
+        m_senders = senders;
+        m_receivers = receivers;
+        m_options = options;
+        m_ideal = ideal;
+        m_cdf.Load (options.cdfPath);
+        m_uniform = CreateObject<UniformRandomVariable> ();
+        m_interArrival = CreateObject<ExponentialRandomVariable> ();
+        m_interArrival->SetAttribute ("Mean", DoubleValue (8 * m_cdf.Mean () / (options.load * capacityBps)));
+
+        for (uint32_t i = 0; i < receivers.GetN (); ++i)
+        {
+            Ptr<Socket> listener = Socket::CreateSocket (receivers.Get (i), TcpSocketFactory::GetTypeId ());
+            // Accepted sockets inherit the listener's segment lifetime.
+            listener->SetAttribute ("MaxSegLifetime", DoubleValue (options.timeWait.GetSeconds () / 2));
+            listener->Bind (InetSocketAddress (Ipv4Address::GetAny (), options.port));
+            listener->Listen ();
+            listener->SetAcceptCallback (MakeNullCallback<bool, Ptr<Socket>, const Address&> (),
+                                         MakeCallback (&DcWorkload::Accepted, this));
+            m_listeners.push_back (listener);
+        }
+        Simulator::Schedule (options.start - Simulator::Now (), &DcWorkload::Arrival, this);
+        if (options.incastInterval > Time (0))
+        {
+            Simulator::Schedule (options.start - Simulator::Now (), &DcWorkload::Incast, this);
+        }
+    }
+
+    // Report of the flows finished so far; flows still running count as unfinished.
+    FctReport Finish () const
+    {
+        FctReport report = m_report;
+        report.unfinished = m_active.size ();
+        return report;
+    }
+
+private:
+    struct Flow
+    {
+        uint64_t size = 0;
+        uint64_t sent = 0;
+        uint64_t received = 0;
+        Time start;
+        uint32_t src = 0;
+        uint32_t dst = 0;
+        int64_t burst = -1;         // incast burst, -1 for Poisson flows
+        Ptr<Socket> tx;
+    };
+
+    struct Burst
+    {
+        uint32_t remaining;
+        Time start;
+    };
+
+    static uint64_t Endpoint (Ipv4Address address, uint16_t port)
+    {
+        return (uint64_t (address.Get ()) << 16) | port;
+    }
+
+    void Arrival ()
+    {
+        if (Simulator::Now () > m_options.stop || (m_options.maxFlows > 0 && m_poissonFlows >= m_options.maxFlows))
+        {
+            return;
+        }
+        m_poissonFlows++;
+        uint32_t src = m_uniform->GetInteger (0, m_senders.GetN () - 1);
+        uint32_t dst = m_uniform->GetInteger (0, m_receivers.GetN () - 1);
+        while (m_receivers.Get (dst) == m_senders.Get (src))
+        {
+            dst = m_uniform->GetInteger (0, m_receivers.GetN () - 1);
+        }
+        StartFlow (src, dst, m_cdf.Sample (m_uniform->GetValue ()), -1);
+        Simulator::Schedule (Seconds (m_interArrival->GetValue ()), &DcWorkload::Arrival, this);
+    }
+
+    // One aggregator asks incastFanIn workers for incastBytes each at the same time.
+    void Incast ()
+    {
+        if (Simulator::Now () > m_options.stop)
+        {
+            return;
+        }
+        uint32_t dst = m_uniform->GetInteger (0, m_receivers.GetN () - 1);
+        int64_t burst = m_nextBurst++;
+        m_bursts[burst] = Burst {m_options.incastFanIn, Simulator::Now ()};
+        for (uint32_t i = 0; i < m_options.incastFanIn; ++i)
+        {
+            uint32_t src = m_uniform->GetInteger (0, m_senders.GetN () - 1);
+            while (m_senders.Get (src) == m_receivers.Get (dst))
+            {
+                src = m_uniform->GetInteger (0, m_senders.GetN () - 1);
+            }
+            StartFlow (src, dst, m_options.incastBytes, burst);
+        }
+        Simulator::Schedule (m_options.incastInterval, &DcWorkload::Incast, this);
+    }
+
+    void StartFlow (uint32_t src, uint32_t dst, uint64_t size, int64_t burst)
+    {
+        uint32_t slot;
+        if (m_free.empty ())
+        {
+            slot = m_flows.size ();
+            m_flows.emplace_back ();
+        }
+        else
+        {
+            slot = m_free.back ();
+            m_free.pop_back ();
+        }
+        Flow& flow = m_flows[slot];
+        flow = Flow ();
+        flow.size = size;
+        flow.start = Simulator::Now ();
+        flow.src = src;
+        flow.dst = dst;
+        flow.burst = burst;
+        m_report.started++;
+
+        Ptr<Node> node = m_senders.Get (src);
+        flow.tx = Socket::CreateSocket (node, TcpSocketFactory::GetTypeId ());
+        // Closed flows would otherwise sit in TIME_WAIT for longer than the run.
+        flow.tx->SetAttribute ("MaxSegLifetime", DoubleValue (m_options.timeWait.GetSeconds () / 2));
+        flow.tx->Bind ();
+        Address local;
+        flow.tx->GetSockName (local);
+        Ipv4Address srcAddress = node->GetObject<Ipv4> ()->GetAddress (1, 0).GetLocal ();
+        m_active[Endpoint (srcAddress, InetSocketAddress::ConvertFrom (local).GetPort ())] = slot;
+
+        Ipv4Address dstAddress = m_receivers.Get (dst)->GetObject<Ipv4> ()->GetAddress (1, 0).GetLocal ();
+        flow.tx->SetConnectCallback (MakeBoundCallback (&DcWorkload::Connected, this, slot),
+                                     MakeNullCallback<void, Ptr<Socket>> ());
+        flow.tx->SetSendCallback (MakeBoundCallback (&DcWorkload::SendMore, this, slot));
+        flow.tx->Connect (InetSocketAddress (dstAddress, m_options.port));
+    }
+
+    static void Connected (DcWorkload* self, uint32_t slot, Ptr<Socket>)
+    {
+        self->Send (slot);
+    }
+
+    static void SendMore (DcWorkload* self, uint32_t slot, Ptr<Socket>, uint32_t)
+    {
+        self->Send (slot);
+    }
+
+    void Send (uint32_t slot)
+    {
+        Flow& flow = m_flows[slot];
+        if (!flow.tx)
+        {
+            return;
+        }
+        while (flow.sent < flow.size)
+        {
+            uint32_t chunk = std::min<uint64_t> ({flow.size - flow.sent, flow.tx->GetTxAvailable (), 65536});
+            if (chunk == 0 || flow.tx->Send (Create<Packet> (chunk)) != int (chunk))
+            {
+                return;
+            }
+            flow.sent += chunk;
+        }
+        // The slot is reused after completion, so the socket must stop calling back into it.
+        flow.tx->SetSendCallback (MakeNullCallback<void, Ptr<Socket>, uint32_t> ());
+        flow.tx->Close ();
+        flow.tx = nullptr;
+    }
+
+    void Accepted (Ptr<Socket> socket, const Address& from)
+    {
+        InetSocketAddress peer = InetSocketAddress::ConvertFrom (from);
+        auto it = m_active.find (Endpoint (peer.GetIpv4 (), peer.GetPort ()));
+        NS_ABORT_MSG_IF (it == m_active.end (), "Connection from an unknown flow");
+        socket->SetRecvCallback (MakeBoundCallback (&DcWorkload::Receive, this, it->second, it->first));
+    }
+
+    static void Receive (DcWorkload* self, uint32_t slot, uint64_t endpoint, Ptr<Socket> socket)
+    {
+        Flow& flow = self->m_flows[slot];
+        while (Ptr<Packet> packet = socket->Recv ())
+        {
+            flow.received += packet->GetSize ();
+        }
+        if (flow.received >= flow.size)
+        {
+            socket->SetRecvCallback (MakeNullCallback<void, Ptr<Socket>> ());
+            socket->Close ();
+            self->Complete (slot, endpoint);
+        }
+    }
+
+    void Complete (uint32_t slot, uint64_t endpoint)
+    {
+        Flow& flow = m_flows[slot];
+        Time fct = Simulator::Now () - flow.start;
+        Time ideal = m_ideal (flow.src, flow.dst, flow.size);
+        size_t bucket = flow.burst < 0 ? FctReport::SizeBucket (flow.size) : 4;
+        Record (bucket, fct, ideal);
+        if (flow.burst >= 0)
+        {
+            auto burst = m_bursts.find (flow.burst);
+            if (--burst->second.remaining == 0)
+            {
+                // A burst ideally completes when the aggregator's link has carried all responses.
+                Record (5, Simulator::Now () - burst->second.start,
+                        m_ideal (flow.src, flow.dst, m_options.incastBytes * m_options.incastFanIn));
+                m_bursts.erase (burst);
+            }
+        }
+        m_active.erase (endpoint);
+        m_free.push_back (slot);
+    }
+
+    void Record (size_t bucket, Time fct, Time ideal)
+    {
+        m_report.fct[bucket].Record (fct.GetNanoSeconds ());
+        m_report.slowdown[bucket].Record (uint64_t (1000.0 * fct.GetSeconds () / ideal.GetSeconds ()));
+        m_report.fctSumMs[bucket] += fct.GetSeconds () * 1000.0;
+    }
+
+    NodeContainer m_senders, m_receivers;
+    WorkloadOptions m_options;
+    IdealFct m_ideal;
+    FlowSizeCdf m_cdf;
+    Ptr<UniformRandomVariable> m_uniform;
+    Ptr<ExponentialRandomVariable> m_interArrival;
+    std::vector<Ptr<Socket>> m_listeners;
+    std::vector<Flow> m_flows;
+    std::vector<uint32_t> m_free;
+    std::unordered_map<uint64_t, uint32_t> m_active;    // sender address and port -> slot
+    std::unordered_map<int64_t, Burst> m_bursts;
+    int64_t m_nextBurst = 0;
+    uint64_t m_poissonFlows = 0;
+    FctReport m_report;
+};
+
+// CSV log of FCT reports, one line per size bucket and run.
+class FctLog
+{
+public:
+    bool IsOpen () const { return m_log.IsOpen (); }
+
+    void Open (const std::string& path)
+    {
+        m_log.Open (path,
+                    "Scenario,Variant,Load,Run,Bucket,Flows,MeanFct(ms),FctP50(ms),FctP99(ms),FctP99.9(ms),"
+                    "SlowdownP50,SlowdownP99,Started,Unfinished\n",
+                    "FCT log");
+    }
+
+    void Append (const std::string& scenario, const std::string& variant, double load, const FctReport& r)
+    {
+        if (!IsOpen ())
+        {
+            return;
+        }
+        std::ostringstream lines;
+        for (size_t b = 0; b < FctReport::kBuckets; ++b)
+        {
+            uint64_t n = r.fct[b].total;
+            if (n == 0)
+            {
+                continue;
+            }
+            lines << scenario << "," << variant << "," << load << "," << RngSeedManager::GetRun () << ","
+                  << FctReport::BucketName (b) << "," << n << "," << r.fctSumMs[b] / n << ","
+                  << r.fct[b].Percentile (0.5) / 1e6 << "," << r.fct[b].Percentile (0.99) / 1e6 << ","
+                  << r.fct[b].Percentile (0.999) / 1e6 << "," << r.slowdown[b].Percentile (0.5) / 1000 << ","
+                  << r.slowdown[b].Percentile (0.99) / 1000 << "," << r.started << "," << r.unfinished << "\n";
+        }
+        m_log.Write (lines.str ());
+    }
+
+private:
+    CsvLog m_log;
+};
+
+} // namespace ns3
+
+#endif // DC_WORKLOAD_H
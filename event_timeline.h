@@ -0,0 +1,443 @@
+#ifndef EVENT_TIMELINE_H
+#define EVENT_TIMELINE_H
+
+#include "csv_log.h"
+#include "flow_probe.h"
+#include "packet_capture.h"
+
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/internet-module.h"
+#include "ns3/applications-module.h"
+#include "ns3/point-to-point-module.h"
+
+#include <algorithm>
+#include <functional>
+#include <map>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace ns3 {
+
+struct NetworkEvent
+{
+    Time at;
+    std::string action;     // rate, delay, fail, restore or flow
+    std::string argument;   // new rate or delay, link, congestion control of the added flow
+};
+
+// Parses "<time>:<action>[=<argument>]" items separated by commas, e.g.
+// "20s:rate=5Mbps,40s:delay=50ms,60s:fail=bottleneck,65s:restore=bottleneck,70s:flow=TcpCubic".
+// rate and delay change the bottleneck; fail and restore take a link the scenario
+// names or <node>-<node>; flow starts another bulk flow along the measured one,
+// with the scenario's variant unless one is given.
+inline std::vector<NetworkEvent> ParseTimeline (const std::string& spec)
+{
+    std::vector<NetworkEvent> events;
+    std::istringstream items (spec);
+    std::string item;
+    while (std::getline (items, item, ','))
+    {
+        if (item.empty ())
+        {
+            continue;
+        }
+        size_t colon = item.find (':');
+        NS_ABORT_MSG_IF (colon == std::string::npos, "Timeline events are <time>:<action>[=<argument>]: " << item);
+        std::string action = item.substr (colon + 1);
+        size_t equals = action.find ('=');
+        NetworkEvent e;
+        e.at = Time (item.substr (0, colon));
+        e.action = action.substr (0, equals);
+        e.argument = equals == std::string::npos ? "" : action.substr (equals + 1);
+        NS_ABORT_MSG_IF (e.action != "rate" && e.action != "delay" && e.action != "fail" && e.action != "restore" &&
+                             e.action != "flow",
+                         "Unknown timeline action: " << e.action);
+        NS_ABORT_MSG_IF (e.action != "flow" && e.argument.empty (), "Timeline action " << e.action << " needs an argument");
+        events.push_back (e);
+    }
+    std::stable_sort (events.begin (), events.end (),
+                      [] (const NetworkEvent& a, const NetworkEvent& b) { return a.at < b.at; });
+    return events;
+}
+
+// What a scenario lets its timeline change.
+struct TimelineHooks
+{
+    Ptr<NetDevice> bottleneck;                                  // one end of the link rate and delay apply to
+    std::map<std::string, Ptr<NetDevice>> links;                // names of links that may fail, besides "bottleneck"
+    // Starts the n-th added flow with the given congestion control; null if the
+    // scenario cannot add flows.
+    std::function<void (uint32_t, const std::string&)> addFlow;
+    std::function<void ()> rerouted;                            // after a link failed or came back, e.g. to recompute routes
+};
+
+// Applies the events of a timeline to a built network at their times.
+class EventTimeline
+{
+public:
+    void Schedule (const std::vector<NetworkEvent>& events, const TimelineHooks& hooks)
+    {
+        m_hooks = hooks;
+        m_hooks.links.emplace ("bottleneck", hooks.bottleneck);
+        for (const auto& e : events)
+        {
+            NS_ABORT_MSG_IF (e.at < Simulator::Now (), "Timeline event at " << e.at.GetSeconds ()
+                                                                             << "s lies before the run or its warm-up");
+            Simulator::Schedule (e.at - Simulator::Now (), &EventTimeline::Apply, this, e);
+        }
+    }
+
+private:
+    void Apply (NetworkEvent e)
+    {
+        Ptr<Channel> channel = m_hooks.bottleneck->GetChannel ();
+        if (e.action == "rate")
+        {
+            for (size_t i = 0; i < channel->GetNDevices (); ++i)
+            {
+                channel->GetDevice (i)->SetAttribute ("DataRate", DataRateValue (DataRate (e.argument)));
+            }
+        }
+        else if (e.action == "delay")
+        {
+            channel->SetAttribute ("Delay", TimeValue (Time (e.argument)));
+        }
+        else if (e.action == "flow")
+        {
+            NS_ABORT_MSG_IF (!m_hooks.addFlow, "This scenario cannot add flows");
+            m_hooks.addFlow (m_addedFlows++, e.argument);
+        }
+        else
+        {
+            SetLinkUp (Resolve (e.argument), e.action == "restore");
+        }
+    }
+
+    Ptr<NetDevice> Resolve (const std::string& name) const
+    {
+        auto alias = m_hooks.links.find (name);
+        if (alias != m_hooks.links.end ())
+        {
+            return alias->second;
+        }
+        size_t dash = name.find ('-');
+        NS_ABORT_MSG_IF (dash == std::string::npos, "Unknown timeline link: " << name);
+        Ptr<NetDevice> device = FindLinkDevice (std::stoul (name.substr (0, dash)), std::stoul (name.substr (dash + 1)));
+        NS_ABORT_MSG_IF (!device, "No point-to-point link " << name);
+        return device;
+    }
+
+    // A failed link loses everything on the wire and neither end routes over it.
+    void SetLinkUp (Ptr<NetDevice> device, bool up)
+    {
+        Ptr<Channel> channel = device->GetChannel ();
+        for (size_t i = 0; i < channel->GetNDevices (); ++i)
+        {
+            Ptr<NetDevice> end = channel->GetDevice (i);
+            Ptr<RateErrorModel>& loss = m_loss[end];
+            if (!loss)
+            {
+                loss = CreateObject<RateErrorModel> ();
+                loss->SetUnit (RateErrorModel::ERROR_UNIT_PACKET);
+                loss->SetRate (1);
+                end->SetAttribute ("ReceiveErrorModel", PointerValue (loss));
+            }
+            up ? loss->Disable () : loss->Enable ();
+            Ptr<Ipv4> ipv4 = end->GetNode ()->GetObject<Ipv4> ();
+            int32_t interface = ipv4->GetInterfaceForDevice (end);
+            if (interface >= 0)
+            {
+                up ? ipv4->SetUp (interface) : ipv4->SetDown (interface);
+            }
+        }
+        if (m_hooks.rerouted)
+        {
+            m_hooks.rerouted ();
+        }
+    }
+
+    TimelineHooks m_hooks;
+    std::map<Ptr<NetDevice>, Ptr<RateErrorModel>> m_loss;
+    uint32_t m_addedFlows = 0;
+};
+
+struct TransientOptions
+{
+    Time sample = MilliSeconds (100);   // goodput and RTT bins
+    Time window = MilliSeconds (500);   // goodput is averaged over this long after an event
+    double fraction = 0.9;              // share of the fair share or settled goodput that counts as converged
+    std::vector<double> shares;         // fair share after each event in Mbps, overriding the computed one (-1: computed)
+};
+
+// Fair shares of --eventsShare, "5,,2.5": one per event, empty entries are computed.
+inline std::vector<double> ParseShares (const std::string& list)
+{
+    std::vector<double> shares;
+    std::istringstream items (list);
+    std::string item;
+    while (std::getline (items, item, ','))
+    {
+        shares.push_back (item.empty () ? -1 : std::stod (item));
+    }
+    return shares;
+}
+
+// How the measured flow responded to one event.
+struct TransientReport
+{
+    NetworkEvent event;
+    double settledMbps = -1;        // mean goodput over the second half of the time until the next event
+    double fairShareMbps = -1;      // what the flow should get after the event, -1 when unknown
+    double convergenceSec = -1;     // until the averaged goodput is within fraction of the fair share
+    double selfConvergenceSec = -1; // until the averaged goodput is within fraction of the settled goodput
+    double overshoot = -1;          // highest averaged goodput over the settled goodput, minus 1
+    double baseRttMs = -1;          // mean RTT in the second before the event
+    double rttSpikeMs = -1;         // highest RTT after the event over that base
+};
+
+// Goodput and RTT of the measured flow in fixed bins, to be cut into the intervals
+// between timeline events after the run.
+class TransientMonitor
+{
+public:
+    TransientMonitor (const TransientOptions& options, Time start)
+        : m_options (options),
+          m_start (start)
+    {
+    }
+
+    // The fair share after an event is the bottleneck rate left over by cbrMbps of
+    // constant-rate traffic, split evenly among tcpFlows TCP flows, followed through
+    // the rate and flow events. It is unknown while a link other than the
+    // bottleneck is down, and without this call unless --eventsShare gives it.
+    void SetFairShare (Ptr<NetDevice> bottleneck, double cbrMbps, uint32_t tcpFlows)
+    {
+        DataRateValue rate;
+        bottleneck->GetAttribute ("DataRate", rate);
+        m_bottleneckMbps = rate.Get ().GetBitRate () / 1e6;
+        m_cbrMbps = cbrMbps;
+        m_tcpFlows = tcpFlows;
+    }
+
+    // sender's socket must exist from the start on.
+    void Install (Ptr<Application> sender, Ptr<Application> sink)
+    {
+        sink->TraceConnectWithoutContext ("Rx", MakeCallback (&TransientMonitor::Rx, this));
+        Simulator::Schedule (Max (m_start - Simulator::Now (), Time (0)) + NanoSeconds (1), [this, sender] () {
+            Ptr<Socket> socket = GetSenderSocket (sender);
+            NS_ABORT_MSG_IF (!socket, "No sender socket to sample RTTs from");
+            socket->TraceConnectWithoutContext ("RTT", MakeCallback (&TransientMonitor::Rtt, this));
+        });
+    }
+
+    std::vector<TransientReport> Finish (const std::vector<NetworkEvent>& events) const
+    {
+        Time end = Simulator::Now ();
+        std::vector<TransientReport> reports;
+        double bottleneckMbps = m_bottleneckMbps;
+        uint32_t tcpFlows = m_tcpFlows;
+        std::set<std::string> down;
+        for (size_t i = 0; i < events.size (); ++i)
+        {
+            TransientReport r;
+            r.event = events[i];
+            const NetworkEvent& e = events[i];
+            if (e.action == "rate")
+            {
+                bottleneckMbps = DataRate (e.argument).GetBitRate () / 1e6;
+            }
+            else if (e.action == "flow")
+            {
+                tcpFlows++;
+            }
+            else if (e.action == "fail")
+            {
+                down.insert (e.argument);
+            }
+            else if (e.action == "restore")
+            {
+                down.erase (e.argument);
+            }
+            if (down.count ("bottleneck"))
+            {
+                r.fairShareMbps = 0;
+            }
+            else if (m_bottleneckMbps >= 0 && down.empty ())
+            {
+                r.fairShareMbps = std::max (0.0, bottleneckMbps - m_cbrMbps) / tcpFlows;
+            }
+            if (i < m_options.shares.size () && m_options.shares[i] >= 0)
+            {
+                r.fairShareMbps = m_options.shares[i];
+            }
+            Time next = i + 1 < events.size () ? std::min (events[i + 1].at, end) : end;
+            if (r.event.at >= m_start && r.event.at < next)
+            {
+                Measure (r, Bin (r.event.at), Bin (next));
+            }
+            reports.push_back (r);
+        }
+        return reports;
+    }
+
+private:
+    struct Sample
+    {
+        uint64_t bytes = 0;
+        double rttSumMs = 0;
+        uint32_t rttCount = 0;
+        double rttMaxMs = 0;
+    };
+
+    size_t Bin (Time t) const { return size_t ((t - m_start).GetNanoSeconds () / m_options.sample.GetNanoSeconds ()); }
+
+    Sample& Current ()
+    {
+        size_t bin = Bin (Simulator::Now ());
+        if (bin >= m_samples.size ())
+        {
+            m_samples.resize (bin + 1);
+        }
+        return m_samples[bin];
+    }
+
+    void Rx (Ptr<const Packet> packet, const Address&)
+    {
+        if (Simulator::Now () >= m_start)
+        {
+            Current ().bytes += packet->GetSize ();
+        }
+    }
+
+    void Rtt (Time, Time rtt)
+    {
+        Sample& s = Current ();
+        s.rttSumMs += rtt.GetSeconds () * 1e3;
+        s.rttCount++;
+        s.rttMaxMs = std::max (s.rttMaxMs, rtt.GetSeconds () * 1e3);
+    }
+
+    double Mbps (size_t bin) const
+    {
+        return bin < m_samples.size () ? m_samples[bin].bytes * 8.0 / m_options.sample.GetSeconds () / 1e6 : 0.0;
+    }
+
+    bool InBand (double mbps, double target) const
+    {
+        return mbps >= m_options.fraction * target && mbps <= (2 - m_options.fraction) * target;
+    }
+
+    // Bins [from, to) are the time from the event to the next one.
+    void Measure (TransientReport& r, size_t from, size_t to) const
+    {
+        if (to < from + 2)
+        {
+            return;
+        }
+        double settled = 0;
+        size_t mid = (from + to) / 2;
+        for (size_t b = mid; b < to; ++b)
+        {
+            settled += Mbps (b);
+        }
+        r.settledMbps = settled / (to - mid);
+
+        // Goodput averaged over the window, but only over bins after the event, so
+        // that the rate before it does not count towards convergence.
+        size_t window = std::max<size_t> (1, m_options.window.GetNanoSeconds () / m_options.sample.GetNanoSeconds ());
+        double sum = 0;
+        double highest = 0;
+        for (size_t b = from; b < to; ++b)
+        {
+            sum += Mbps (b) - (b >= from + window ? Mbps (b - window) : 0.0);
+            double mean = sum / std::min (window, b - from + 1);
+            double elapsed = (b + 1 - from) * m_options.sample.GetSeconds ();
+            if (r.convergenceSec < 0 && r.fairShareMbps > 0 && InBand (mean, r.fairShareMbps))
+            {
+                r.convergenceSec = elapsed;
+            }
+            if (r.selfConvergenceSec < 0 && r.settledMbps > 0 && InBand (mean, r.settledMbps))
+            {
+                r.selfConvergenceSec = elapsed;
+            }
+            if (b + 1 >= from + window)
+            {
+                highest = std::max (highest, mean);
+            }
+        }
+        if (r.settledMbps > 0)
+        {
+            r.overshoot = std::max (0.0, highest / r.settledMbps - 1);
+        }
+
+        size_t before = std::min (from, size_t (1.0 / m_options.sample.GetSeconds ()));
+        double rttSum = 0;
+        uint32_t rttCount = 0;
+        for (size_t b = from - before; b < from && b < m_samples.size (); ++b)
+        {
+            rttSum += m_samples[b].rttSumMs;
+            rttCount += m_samples[b].rttCount;
+        }
+        double rttMax = -1;
+        for (size_t b = from; b < to && b < m_samples.size (); ++b)
+        {
+            rttMax = m_samples[b].rttCount > 0 ? std::max (rttMax, m_samples[b].rttMaxMs) : rttMax;
+        }
+        if (rttCount > 0 && rttMax >= 0)
+        {
+            r.baseRttMs = rttSum / rttCount;
+            r.rttSpikeMs = std::max (0.0, rttMax - r.baseRttMs);
+        }
+    }
+
+    TransientOptions m_options;
+    Time m_start;
+    double m_bottleneckMbps = -1;   // at the start, -1 without SetFairShare
+    double m_cbrMbps = 0;
+    uint32_t m_tcpFlows = 1;
+    std::vector<Sample> m_samples;
+};
+
+// CSV log of the transient reports of every run, one line per event.
+class TransientLog
+{
+public:
+    bool IsOpen () const { return m_log.IsOpen (); }
+
+    void Open (const std::string& path)
+    {
+        m_log.Open (path,
+                    "Scenario,Variant,CBR(Mbps),Run,Time(s),Event,Settled(Mbps),FairShare(Mbps),Convergence(s),"
+                    "SelfConvergence(s),Overshoot,BaseRtt(ms),RttSpike(ms)\n",
+                    "event log");
+    }
+
+    void Append (const std::string& scenario, const std::string& variant, double cbrRateMbps,
+                 const std::vector<TransientReport>& reports)
+    {
+        if (!IsOpen ())
+        {
+            return;
+        }
+        std::ostringstream lines;
+        for (const auto& r : reports)
+        {
+            lines << scenario << "," << variant << "," << cbrRateMbps << "," << RngSeedManager::GetRun () << ","
+                  << r.event.at.GetSeconds () << "," << r.event.action
+                  << (r.event.argument.empty () ? "" : "=" + r.event.argument) << "," << r.settledMbps << ","
+                  << r.fairShareMbps << "," << r.convergenceSec << "," << r.selfConvergenceSec << "," << r.overshoot
+                  << "," << r.baseRttMs << "," << r.rttSpikeMs << "\n";
+        }
+        m_log.Write (lines.str ());
+    }
+
+private:
+    CsvLog m_log;
+};
+
+} // namespace ns3
+
+#endif // EVENT_TIMELINE_H
@@ -4,119 +4,830 @@
 #include "ns3/point-to-point-module.h"
 #include "ns3/applications-module.h"
 #include "ns3/flow-monitor-module.h"
-#include "ns3/tcp-vegas.h"
-#include "ns3/tcp-veno.h"
-#include "ns3/tcp-westwood-plus.h"
-#include "ns3/tcp-bbr.h"
-#include "ns3/tcp-cubic.h"
+
+#ifdef NS3_MPI
+#include "ns3/mpi-interface.h"
+#include <mpi.h>
+#endif
+
+#include "bottleneck_aqm.h"
+#include "dc_workload.h"
+#include "event_timeline.h"
+#include "flow_probe.h"
+#include "flow_tracer.h"
+#include "knee_search.h"
+#include "packet_capture.h"
+#include "perf_counters.h"
+#include "regression.h"
+#include "results_store.h"
+#include "sweep_runner.h"
+#include "tcp_variants.h"
+
+#include <chrono>
+#include <cstdio>
+#include <deque>
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include <unordered_map>
+
+#include <unistd.h>
 
 using namespace ns3;
 
-TypeId GetTcpVariant(const std::string &variant)
+// Routing for the k-ary fat tree. Every node knows only its own position, so the
+// next hop is computed from the destination address instead of a routing table:
+// hosts are 10.pod.edge.(4*host+2) and each link is a /30 whose upper end (towards
+// the core) is .1 and lower end .2. Upward traffic is spread over the uplinks
+// according to the balancing mode, by default with the two-level (destination host
+// suffix) scheme of Al-Fares et al. Downward paths are unique, so an uplink is only
+// taken while the switches above it can still reach the destination's edge switch.
+class FatTreeRouting : public Ipv4RoutingProtocol
 {
-  if (variant == "TcpVegas") return TcpVegas::GetTypeId();
-  if (variant == "TcpVeno") return TcpVeno::GetTypeId();
-  if (variant == "TcpWestwoodPlus") return TcpWestwoodPlus::GetTypeId();
-  if (variant == "TcpBbr") return TcpBbr::GetTypeId();
-  if (variant == "TcpCubic") return TcpCubic::GetTypeId();
-  NS_ABORT_MSG("Invalid TCP variant");
+public:
+  enum Role { HOST, EDGE, AGG, CORE };
+  // TWO_LEVEL: by destination host suffix, so all traffic to one host shares a path.
+  // ECMP: by five-tuple hash. FLOWLET: like ECMP, but a flow that has been idle for
+  // longer than the flowlet gap moves to a random uplink. SPRAY: round robin per packet.
+  enum Balancing { TWO_LEVEL, ECMP, FLOWLET, SPRAY };
+
+  static TypeId GetTypeId();
+  static Balancing ParseBalancing(const std::string& name);
+
+  void Configure(Role role, uint32_t k, uint32_t index,
+                 const std::vector<uint32_t>& down, const std::vector<uint32_t>& up);
+  void SetBalancing(Balancing balancing, Time flowletGap);
+  // Whether a packet to a host below edge switch edge of pod pod that reaches this
+  // switch gets there over links that are up.
+  bool Delivers(uint32_t pod, uint32_t edge) const;
+
+  Ptr<Ipv4Route> RouteOutput(Ptr<Packet> p, const Ipv4Header& header, Ptr<NetDevice> oif,
+                             Socket::SocketErrno& sockerr) override;
+  bool RouteInput(Ptr<const Packet> p, const Ipv4Header& header, Ptr<const NetDevice> idev,
+                  const UnicastForwardCallback& ucb, const MulticastForwardCallback& mcb,
+                  const LocalDeliverCallback& lcb, const ErrorCallback& ecb) override;
+  void NotifyInterfaceUp(uint32_t interface) override {}
+  void NotifyInterfaceDown(uint32_t interface) override {}
+  void NotifyAddAddress(uint32_t interface, Ipv4InterfaceAddress address) override {}
+  void NotifyRemoveAddress(uint32_t interface, Ipv4InterfaceAddress address) override {}
+  void SetIpv4(Ptr<Ipv4> ipv4) override { m_ipv4 = ipv4; }
+  void PrintRoutingTable(Ptr<OutputStreamWrapper> stream, Time::Unit unit = Time::S) const override;
+
+private:
+  struct Flowlet
+  {
+    Time last;
+    uint32_t uplink;
+  };
+
+  Ptr<Ipv4Route> Lookup(const Ipv4Header& header, Ptr<const Packet> p);
+  uint32_t PickUp(uint32_t preferred, uint32_t pod, uint32_t edge) const;
+  uint32_t PickBalanced(uint32_t host, uint32_t pod, uint32_t edge, const Ipv4Header& header,
+                        Ptr<const Packet> p);
+  bool DeliversUp(uint32_t uplink, uint32_t pod, uint32_t edge) const;
+  Ptr<FatTreeRouting> Peer(uint32_t interface) const;
+  uint32_t FlowHash(const Ipv4Header& header, Ptr<const Packet> p) const;
+  Ptr<Ipv4Route> MakeRoute(uint32_t interface, Ipv4Address dst) const;
+
+  Ptr<Ipv4> m_ipv4;
+  Role m_role = HOST;
+  uint32_t m_k = 0;
+  uint32_t m_pod = 0;
+  uint32_t m_index = 0;          // edge or agg index in the pod, core index a * k/2 + j
+  std::vector<uint32_t> m_down;  // interface per host / edge / pod below this node
+  std::vector<uint32_t> m_up;    // interface per agg / core above this node
+  std::vector<Ptr<FatTreeRouting>> m_downPeers;  // switch at the other end of each m_down interface
+  std::vector<Ptr<FatTreeRouting>> m_upPeers;    // and of each m_up interface
+  Balancing m_balancing = TWO_LEVEL;
+  Time m_flowletGap;
+  std::unordered_map<uint32_t, Flowlet> m_flowlets;  // by five-tuple hash
+  uint32_t m_spray = 0;
+  Ptr<UniformRandomVariable> m_rng;
+};
+
+NS_OBJECT_ENSURE_REGISTERED(FatTreeRouting);
+
+TypeId FatTreeRouting::GetTypeId()
+{
+  static TypeId tid = TypeId("ns3::FatTreeRouting")
+                          .SetParent<Ipv4RoutingProtocol>()
+                          .SetGroupName("Internet")
+                          .AddConstructor<FatTreeRouting>();
+  return tid;
 }
 
-void RunScenario1(const std::string& variant, double cbrRateMbps)
+void FatTreeRouting::Configure(Role role, uint32_t k, uint32_t index,
+                               const std::vector<uint32_t>& down, const std::vector<uint32_t>& up)
 {
-  Config::SetDefault("ns3::TcpL4Protocol::SocketType", TypeIdValue(GetTcpVariant(variant)));
-  Config::SetDefault("ns3::TcpSocket::DelAckCount", UintegerValue(1));
+  m_role = role;
+  m_k = k;
+  m_pod = (role == CORE) ? 0 : index / (k / 2);
+  m_index = (role == CORE) ? index : index % (k / 2);
+  m_down = down;
+  m_up = up;
+  if (role == HOST) return;
+  m_downPeers.clear();
+  m_upPeers.clear();
+  for (uint32_t i : m_down) m_downPeers.push_back(Peer(i));
+  for (uint32_t i : m_up) m_upPeers.push_back(Peer(i));
+}
 
-  NodeContainer hosts, core, agg, edge;
-  NodeContainer allNodes;
-  PointToPointHelper p2p;
-  p2p.SetDeviceAttribute("DataRate", StringValue("1Mbps"));
-  p2p.SetChannelAttribute("Delay", StringValue("2ms"));
-  p2p.SetQueue("ns3::DropTailQueue<Packet>", "MaxSize", QueueSizeValue(QueueSize("5p")));
+Ptr<FatTreeRouting> FatTreeRouting::Peer(uint32_t interface) const
+{
+  Ptr<NetDevice> dev = m_ipv4->GetNetDevice(interface);
+  Ptr<Channel> channel = dev->GetChannel();
+  Ptr<NetDevice> other = channel->GetDevice(channel->GetDevice(0) == dev ? 1 : 0);
+  return DynamicCast<FatTreeRouting>(other->GetNode()->GetObject<Ipv4>()->GetRoutingProtocol());
+}
+
+bool FatTreeRouting::Delivers(uint32_t pod, uint32_t edge) const
+{
+  switch (m_role)
+  {
+  case HOST:
+    return false;
+  case CORE:
+    return m_ipv4->IsUp(m_down[pod]) && m_downPeers[pod]->Delivers(pod, edge);
+  case AGG:
+    if (pod == m_pod) return m_ipv4->IsUp(m_down[edge]);
+    break;
+  case EDGE:
+    if (pod == m_pod && edge == m_index) return true;
+    break;
+  }
+  for (uint32_t t = 0; t < m_up.size(); ++t)
+  {
+    if (DeliversUp(t, pod, edge)) return true;
+  }
+  return false;
+}
+
+bool FatTreeRouting::DeliversUp(uint32_t uplink, uint32_t pod, uint32_t edge) const
+{
+  return m_ipv4->IsUp(m_up[uplink]) && m_upPeers[uplink]->Delivers(pod, edge);
+}
+
+FatTreeRouting::Balancing FatTreeRouting::ParseBalancing(const std::string& name)
+{
+  if (name == "TwoLevel") return TWO_LEVEL;
+  if (name == "Ecmp") return ECMP;
+  if (name == "Flowlet") return FLOWLET;
+  if (name == "Spray") return SPRAY;
+  NS_ABORT_MSG("Unknown load balancing: " << name);
+}
+
+void FatTreeRouting::SetBalancing(Balancing balancing, Time flowletGap)
+{
+  m_balancing = balancing;
+  m_flowletGap = flowletGap;
+  if (balancing == FLOWLET && !m_rng) m_rng = CreateObject<UniformRandomVariable>();
+}
+
+// First uplink starting from the preferred one whose path down to the destination's
+// edge switch is up, so a failed link, above or below this switch, diverts traffic to
+// a neighbour instead of blackholing it. Without such a path the first uplink that
+// is up is taken anyway.
+uint32_t FatTreeRouting::PickUp(uint32_t preferred, uint32_t pod, uint32_t edge) const
+{
+  for (uint32_t t = 0; t < m_up.size(); ++t)
+  {
+    uint32_t u = (preferred + t) % m_up.size();
+    if (DeliversUp(u, pod, edge)) return m_up[u];
+  }
+  for (uint32_t t = 0; t < m_up.size(); ++t)
+  {
+    uint32_t i = m_up[(preferred + t) % m_up.size()];
+    if (m_ipv4->IsUp(i)) return i;
+  }
+  return 0;
+}
+
+// Salted with the node so that the aggregation layer does not repeat the edge
+// layer's choice, which would leave half of the core links idle.
+uint32_t FatTreeRouting::FlowHash(const Ipv4Header& header, Ptr<const Packet> p) const
+{
+  uint32_t key[5] = {header.GetSource().Get(), header.GetDestination().Get(), 0, header.GetProtocol(),
+                     m_ipv4->GetObject<Node>()->GetId()};
+  // Forwarded packets start with their TCP/UDP header, whose first four bytes are the ports.
+  if (p && p->GetSize() >= 4 && (key[3] == 6 || key[3] == 17))
+  {
+    p->CopyData(reinterpret_cast<uint8_t*>(&key[2]), 4);
+  }
+  return Hash32(reinterpret_cast<const char*>(key), sizeof(key));
+}
+
+uint32_t FatTreeRouting::PickBalanced(uint32_t host, uint32_t pod, uint32_t edge, const Ipv4Header& header,
+                                      Ptr<const Packet> p)
+{
+  switch (m_balancing)
+  {
+  case TWO_LEVEL:
+    return PickUp(host + m_index, pod, edge);
+  case ECMP:
+    return PickUp(FlowHash(header, p) % m_up.size(), pod, edge);
+  case FLOWLET:
+  {
+    Time now = Simulator::Now();
+    uint32_t hash = FlowHash(header, p);
+    auto it = m_flowlets.find(hash);
+    if (it == m_flowlets.end())
+    {
+      it = m_flowlets.emplace(hash, Flowlet{now, hash % uint32_t(m_up.size())}).first;
+    }
+    else if (now - it->second.last > m_flowletGap)
+    {
+      // The packets in flight have drained, so the new path cannot reorder them.
+      it->second.uplink = m_rng->GetInteger(0, m_up.size() - 1);
+    }
+    it->second.last = now;
+    return PickUp(it->second.uplink, pod, edge);
+  }
+  case SPRAY:
+    return PickUp(m_spray++ % m_up.size(), pod, edge);
+  }
+  return 0;
+}
+
+Ptr<Ipv4Route> FatTreeRouting::MakeRoute(uint32_t interface, Ipv4Address dst) const
+{
+  if (interface == 0 || !m_ipv4->IsUp(interface)) return nullptr;
+  Ipv4Address local = m_ipv4->GetAddress(interface, 0).GetLocal();
+  Ptr<Ipv4Route> route = Create<Ipv4Route>();
+  route->SetDestination(dst);
+  route->SetSource(local);
+  route->SetGateway(Ipv4Address(local.Get() ^ 3));
+  route->SetOutputDevice(m_ipv4->GetNetDevice(interface));
+  return route;
+}
+
+Ptr<Ipv4Route> FatTreeRouting::Lookup(const Ipv4Header& header, Ptr<const Packet> p)
+{
+  uint32_t half = m_k / 2;
+  Ipv4Address dst = header.GetDestination();
+  uint32_t d = dst.Get();
+  uint32_t pod = (d >> 16) & 0xff;
+  uint32_t edge = (d >> 8) & 0xff;
+  uint32_t host = (d & 0xff) / 4;
+  bool isHost = (d >> 24) == 10 && pod < m_k && edge < half && (d & 3) == 2 && host < half;
+
+  if (isHost)
+  {
+    switch (m_role)
+    {
+    case HOST:
+      return MakeRoute(1, dst);
+    case EDGE:
+      if (pod == m_pod && edge == m_index) return MakeRoute(m_down[host], dst);
+      return MakeRoute(PickBalanced(host, pod, edge, header, p), dst);
+    case AGG:
+      if (pod == m_pod) return MakeRoute(m_down[edge], dst);
+      return MakeRoute(PickBalanced(host, pod, edge, header, p), dst);
+    case CORE:
+      return MakeRoute(m_down[pod], dst);
+    }
+  }
 
+  // Switch link addresses are only reachable from the other end of their /30.
+  for (uint32_t i = 1; i < m_ipv4->GetNInterfaces(); ++i)
+  {
+    Ipv4Address local = m_ipv4->GetAddress(i, 0).GetLocal();
+    if ((local.Get() & ~3u) == (d & ~3u)) return MakeRoute(i, dst);
+  }
+  return nullptr;
+}
+
+Ptr<Ipv4Route> FatTreeRouting::RouteOutput(Ptr<Packet> p, const Ipv4Header& header, Ptr<NetDevice> oif,
+                                           Socket::SocketErrno& sockerr)
+{
+  Ptr<Ipv4Route> route = Lookup(header, p);
+  sockerr = route ? Socket::ERROR_NOTERROR : Socket::ERROR_NOROUTETOHOST;
+  return route;
+}
+
+bool FatTreeRouting::RouteInput(Ptr<const Packet> p, const Ipv4Header& header, Ptr<const NetDevice> idev,
+                                const UnicastForwardCallback& ucb, const MulticastForwardCallback& mcb,
+                                const LocalDeliverCallback& lcb, const ErrorCallback& ecb)
+{
+  uint32_t iif = m_ipv4->GetInterfaceForDevice(idev);
+  if (m_ipv4->IsDestinationAddress(header.GetDestination(), iif))
+  {
+    if (lcb.IsNull()) return false;
+    lcb(p, header, iif);
+    return true;
+  }
+  if (header.GetDestination().IsMulticast() || header.GetDestination().IsBroadcast()) return false;
+
+  Ptr<Ipv4Route> route = Lookup(header, p);
+  if (!route) return false;
+  ucb(route, p, header);
+  return true;
+}
+
+void FatTreeRouting::PrintRoutingTable(Ptr<OutputStreamWrapper> stream, Time::Unit unit) const
+{
+  static const char* names[] = {"host", "edge", "agg", "core"};
+  *stream->GetStream() << "FatTreeRouting " << names[m_role] << " pod " << m_pod << " index " << m_index
+                       << ", " << m_down.size() << " down / " << m_up.size() << " up interfaces" << std::endl;
+}
+
+class FatTreeRoutingHelper : public Ipv4RoutingHelper
+{
+public:
+  FatTreeRoutingHelper* Copy() const override { return new FatTreeRoutingHelper(*this); }
+  Ptr<Ipv4RoutingProtocol> Create(Ptr<Node> node) const override { return CreateObject<FatTreeRouting>(); }
+};
+
+struct FatTreeConfig
+{
   uint32_t k = 4;
-  uint32_t pods = k;
-  uint32_t numCore = (k / 2) * (k / 2);
-  uint32_t numAggPerPod = k / 2;
-  uint32_t numEdgePerPod = k / 2;
-  uint32_t numHostsPerEdge = k / 2;
+  bool globalRouting = false;   // Ipv4GlobalRoutingHelper instead of FatTreeRouting, for comparison
+  std::string balancing = "TwoLevel";   // FatTreeRouting uplink choice: TwoLevel, Ecmp, Flowlet or Spray
+  Time flowletGap = MilliSeconds(50);   // idle time after which a Flowlet flow may change path
+  bool endpointProbe = false;   // measure with EndpointFlowProbe, required once flows span processes
+  uint32_t ranks = 1;           // MPI ranks the pods are partitioned across
+  uint32_t rank = 0;            // rank of this process
+  std::string tracePrefix;      // per-flow time series of the TCP flow, disabled when empty
+  Time traceInterval = MilliSeconds(10);
+  bool report = true;           // emit result rows; off for the sequential baseline of a distributed run
+  BottleneckQueueOptions queue; // queue of the destination's edge downlink, where the cross traffic converges
+  PacketCaptureOptions capture; // links are "bottleneck", "core" (pod 0's first aggregation uplink) or <node>-<node>
+  std::vector<NetworkEvent> events;   // timeline of every run; links fail and come back with local rerouting
+  TransientOptions transient;
+};
 
-  core.Create(numCore);
-  allNodes.Add(core);
+ResultsStore g_results;
+PerfLog g_perfLog;
+FctLog g_fctLog;
+TransientLog g_eventLog;
 
-  std::vector<NodeContainer> aggSwitches, edgeSwitches, hostGroups;
-  for (uint32_t p = 0; p < pods; ++p)
+// Scenario label of a fat tree result; the arity, a non-default load balancing and a
+// non-default AQM are part of the configuration key.
+std::string FatTreeLabel(const FatTreeConfig& config)
+{
+  std::string label = "FatTree-k" + std::to_string(config.k);
+  if (config.balancing != "TwoLevel") label += "-" + config.balancing;
+  return IsDefaultAqm(config.queue.aqm) ? label : label + "-" + config.queue.aqm;
+}
+
+ResultKey ConfigKey(const FatTreeConfig& config, const std::string& variant, double cbrRateMbps)
+{
+  return ResultKey{FatTreeLabel(config), variant, cbrRateMbps, RngSeedManager::GetSeed(),
+                   uint32_t(RngSeedManager::GetRun())};
+}
+
+// Bytes every switch sends up each of its uplinks, for the UplinkImbalance column:
+// per switch the busiest uplink's bytes over the mean of its uplinks (1 is an even
+// spread, k/2 everything on one uplink), averaged over the switches weighted by
+// their upward bytes.
+class UplinkMonitor
+{
+public:
+  void Install(const std::vector<std::vector<Ptr<NetDevice>>>& uplinks, uint32_t rank)
   {
-    NodeContainer agg, edge;
-    agg.Create(numAggPerPod);
-    edge.Create(numEdgePerPod);
-    aggSwitches.push_back(agg);
-    edgeSwitches.push_back(edge);
-    allNodes.Add(agg);
-    allNodes.Add(edge);
+    m_bytes.reserve(uplinks.size());
+    for (const auto& devices : uplinks)
+    {
+      if (devices.empty() || devices.front()->GetNode()->GetSystemId() != rank) continue;
+      m_bytes.emplace_back(devices.size(), 0);
+      for (size_t i = 0; i < devices.size(); ++i)
+      {
+        devices[i]->TraceConnectWithoutContext("PhyTxEnd", MakeBoundCallback(&UplinkMonitor::Tx, &m_bytes.back()[i]));
+      }
+    }
+  }
 
-    for (uint32_t e = 0; e < numEdgePerPod; ++e)
+  double Imbalance() const
+  {
+    double weighted = 0, total = 0;
+    for (const auto& bytes : m_bytes)
     {
-      NodeContainer hosts;
-      hosts.Create(numHostsPerEdge);
-      hostGroups.push_back(hosts);
-      allNodes.Add(hosts);
+      uint64_t sum = 0, max = 0;
+      for (uint64_t b : bytes)
+      {
+        sum += b;
+        max = std::max(max, b);
+      }
+      if (sum == 0) continue;
+      weighted += double(max) * bytes.size();
+      total += sum;
     }
+    return total > 0 ? weighted / total : -1;
+  }
+
+  void Fill(ResultRecord& r) const { r.uplinkImbalance = Imbalance(); }
+
+private:
+  static void Tx(uint64_t* bytes, Ptr<const Packet> p) { *bytes += p->GetSize(); }
+
+  std::vector<std::vector<uint64_t>> m_bytes;  // per switch, per uplink; reserved, so the trace pointers stay valid
+};
+
+// probeStats and rtt add the tail-latency and reordering columns when the endpoint
+// probe measured the flow, queue the bottleneck queue counters when this process
+// owns the bottleneck, uplinks the load balancing column.
+void ReportFlow(const FatTreeConfig& config, const std::string& variant, double cbrRateMbps, uint16_t port,
+                double throughput, double avgRtt, double dropRate, const BottleneckQueue* queue,
+                const FlowProbeStats* probeStats = nullptr, const LogHistogram* rtt = nullptr,
+                const UplinkMonitor* uplinks = nullptr)
+{
+  if (!config.report) return;
+  ResultRecord r;
+  r.key = ConfigKey(config, variant, cbrRateMbps);
+  r.flow = std::to_string(port);
+  r.throughputMbps = throughput;
+  r.avgRttMs = avgRtt;
+  r.dropRate = dropRate;
+  r.stopTimeSec = Simulator::Now().GetSeconds();
+  if (probeStats) SetTailLatency(r, *probeStats, rtt);
+  if (queue) queue->Fill(r);
+  if (uplinks) uplinks->Fill(r);
+  EmitResult(g_results, r);
+}
+
+// A built k-ary fat tree. Switches are indexed pod * k/2 + i (core: a * k/2 + j,
+// attached to aggregation switch a of every pod), hosts (pod * k/2 + edge) * k/2 + host.
+struct FatTree
+{
+  uint32_t k = 0;
+  NodeContainer core, agg, edge, hosts;
+  NodeContainer allNodes;
+  std::vector<std::vector<Ptr<NetDevice>>> uplinks;  // per edge and aggregation switch, in uplink order
+
+  Ptr<Node> Host(uint32_t pod, uint32_t e, uint32_t h) const { return hosts.Get((pod * k / 2 + e) * k / 2 + h); }
+  static Ipv4Address HostAddress(uint32_t pod, uint32_t e, uint32_t h)
+  {
+    return Ipv4Address((10u << 24) | (pod << 16) | (e << 8) | (4 * h + 2));
+  }
+};
+
+// Resident set size of this process in bytes.
+uint64_t ResidentBytes()
+{
+  std::ifstream statm("/proc/self/statm");
+  uint64_t size = 0, resident = 0;
+  statm >> size >> resident;
+  return resident * sysconf(_SC_PAGESIZE);
+}
+
+// Adds a device to a node's IPv4 stack with a /30 address and returns the interface index.
+uint32_t AddFatTreeInterface(Ptr<Node> node, Ptr<NetDevice> dev, uint32_t address)
+{
+  Ptr<Ipv4> ipv4 = node->GetObject<Ipv4>();
+  uint32_t i = ipv4->AddInterface(dev);
+  ipv4->AddAddress(i, Ipv4InterfaceAddress(Ipv4Address(address), Ipv4Mask("255.255.255.252")));
+  ipv4->SetUp(i);
+  return i;
+}
+
+void BuildFatTree(FatTree& ft, const FatTreeConfig& config, PointToPointHelper& p2p, PerfCounters& perf)
+{
+  uint32_t k = config.k;
+  NS_ABORT_MSG_IF(k < 4 || k % 2 != 0 || k > 48, "Fat tree arity must be even and between 4 and 48: " << k);
+  uint32_t half = k / 2;
+  ft.k = k;
+
+  auto start = std::chrono::steady_clock::now();
+  uint64_t rssBefore = ResidentBytes();
+
+  // Each pod lives on one rank, so only aggregation-core links cross processes.
+  for (uint32_t c = 0; c < half * half; ++c)
+  {
+    ft.core.Create(1, c % config.ranks);
+  }
+  ft.allNodes.Add(ft.core);
+  for (uint32_t p = 0; p < k; ++p)
+  {
+    NodeContainer agg, edge, hosts;
+    agg.Create(half, p % config.ranks);
+    edge.Create(half, p % config.ranks);
+    hosts.Create(half * half, p % config.ranks);
+    ft.agg.Add(agg);
+    ft.edge.Add(edge);
+    ft.hosts.Add(hosts);
+    ft.allNodes.Add(agg);
+    ft.allNodes.Add(edge);
+    ft.allNodes.Add(hosts);
   }
 
   InternetStackHelper stack;
-  stack.Install(allNodes);
+  if (!config.globalRouting)
+  {
+    stack.SetRoutingHelper(FatTreeRoutingHelper());
+  }
+  stack.Install(ft.allNodes);
 
-  Ptr<Node> src = hostGroups[0].Get(0);
-  Ptr<Node> dst = hostGroups[hostGroups.size() - 1].Get(1);
+  std::vector<std::vector<uint32_t>> down(NodeList::GetNNodes()), up(NodeList::GetNNodes());
+  std::vector<std::vector<Ptr<NetDevice>>> uplinks(NodeList::GetNNodes());
+  auto connect = [&](Ptr<Node> lower, Ptr<Node> upper, uint32_t subnet) {
+    NetDeviceContainer devs = p2p.Install(lower, upper);
+    up[lower->GetId()].push_back(AddFatTreeInterface(lower, devs.Get(0), subnet + 2));
+    down[upper->GetId()].push_back(AddFatTreeInterface(upper, devs.Get(1), subnet + 1));
+    uplinks[lower->GetId()].push_back(devs.Get(0));
+  };
 
-  NodeContainer router;
-  router.Create(1);
-  stack.Install(router);
-  allNodes.Add(router);
+  for (uint32_t p = 0; p < k; ++p)
+  {
+    for (uint32_t e = 0; e < half; ++e)
+    {
+      for (uint32_t h = 0; h < half; ++h)
+      {
+        connect(ft.Host(p, e, h), ft.edge.Get(p * half + e), (10u << 24) | (p << 16) | (e << 8) | (4 * h));
+      }
+    }
+    for (uint32_t a = 0; a < half; ++a)
+    {
+      for (uint32_t e = 0; e < half; ++e)
+      {
+        connect(ft.edge.Get(p * half + e), ft.agg.Get(p * half + a),
+                (10u << 24) | (p << 16) | ((half + a) << 8) | (4 * e));
+      }
+    }
+  }
+  for (uint32_t a = 0; a < half; ++a)
+  {
+    for (uint32_t j = 0; j < half; ++j)
+    {
+      for (uint32_t p = 0; p < k; ++p)
+      {
+        connect(ft.agg.Get(p * half + a), ft.core.Get(a * half + j),
+                (10u << 24) | ((64 + a) << 16) | (j << 8) | (4 * p));
+      }
+    }
+  }
+  for (NodeContainer* layer : {&ft.edge, &ft.agg})
+  {
+    for (uint32_t i = 0; i < layer->GetN(); ++i)
+    {
+      ft.uplinks.push_back(std::move(uplinks[layer->Get(i)->GetId()]));
+    }
+  }
+  double buildSec = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
 
-  NetDeviceContainer dev1 = p2p.Install(NodeContainer(src, router.Get(0)));
-  Ipv4AddressHelper addr1;
-  addr1.SetBase("10.1.1.0", "255.255.255.0");
-  Ipv4InterfaceContainer iface1 = addr1.Assign(dev1);
+  start = std::chrono::steady_clock::now();
+  perf.BeginRouting();
+  if (config.globalRouting)
+  {
+    NS_ABORT_MSG_IF(config.balancing != "TwoLevel", "Load balancing modes need the structural routing");
+    Ipv4GlobalRoutingHelper::PopulateRoutingTables();
+  }
+  else
+  {
+    FatTreeRouting::Balancing balancing = FatTreeRouting::ParseBalancing(config.balancing);
+    auto configure = [&](NodeContainer& nodes, FatTreeRouting::Role role) {
+      for (uint32_t i = 0; i < nodes.GetN(); ++i)
+      {
+        Ptr<Node> n = nodes.Get(i);
+        Ptr<FatTreeRouting> routing = DynamicCast<FatTreeRouting>(n->GetObject<Ipv4>()->GetRoutingProtocol());
+        routing->Configure(role, k, i, down[n->GetId()], up[n->GetId()]);
+        routing->SetBalancing(balancing, config.flowletGap);
+      }
+    };
+    configure(ft.hosts, FatTreeRouting::HOST);
+    configure(ft.edge, FatTreeRouting::EDGE);
+    configure(ft.agg, FatTreeRouting::AGG);
+    configure(ft.core, FatTreeRouting::CORE);
+  }
+  perf.EndRouting();
+  double routingSec = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
 
-  NetDeviceContainer dev2 = p2p.Install(NodeContainer(router.Get(0), dst));
-  Ipv4AddressHelper addr2;
-  addr2.SetBase("10.1.2.0", "255.255.255.0");
-  Ipv4InterfaceContainer iface2 = addr2.Assign(dev2);
+  uint64_t rssAfter = ResidentBytes();
+  if (config.rank != 0) return;
+  std::clog << "# fat-tree k=" << k << " hosts=" << ft.hosts.GetN()
+            << " switches=" << ft.allNodes.GetN() - ft.hosts.GetN()
+            << " build=" << buildSec << "s routing=" << routingSec << "s ("
+            << (config.globalRouting ? "global" : "structural " + config.balancing) << ")"
+            << " rss/node=" << (rssAfter > rssBefore ? (rssAfter - rssBefore) / ft.allNodes.GetN() : 0) << "B"
+            << std::endl;
+}
+
+#ifdef NS3_MPI
+// Collects every rank's endpoint counters on rank 0. A flow that crosses the cut is
+// sent on one rank and received on another, so its two halves are summed by key.
+FlowProbeMap GatherFlows(const EndpointFlowProbe& probe, const FatTreeConfig& config)
+{
+  std::vector<uint8_t> local = probe.Serialize();
+  int size = local.size();
+  std::vector<int> sizes(config.ranks), offsets(config.ranks, 0);
+  MPI_Gather(&size, 1, MPI_INT, sizes.data(), 1, MPI_INT, 0, MPI_COMM_WORLD);
 
-  Ipv4GlobalRoutingHelper::PopulateRoutingTables();
+  std::vector<uint8_t> all;
+  if (config.rank == 0)
+  {
+    for (uint32_t r = 1; r < config.ranks; ++r)
+    {
+      offsets[r] = offsets[r - 1] + sizes[r - 1];
+    }
+    all.resize(offsets.back() + sizes.back());
+  }
+  MPI_Gatherv(local.data(), size, MPI_BYTE, all.data(), sizes.data(), offsets.data(), MPI_BYTE, 0, MPI_COMM_WORLD);
+
+  FlowProbeMap flows;
+  EndpointFlowProbe::Merge(flows, all.data(), all.size());
+  return flows;
+}
+#endif
+
+// Runs one configuration and returns the wall-clock seconds spent in Simulator::Run.
+double RunScenario1(const std::string& variant, double cbrRateMbps, const FatTreeConfig& config)
+{
+  Config::SetDefault("ns3::TcpL4Protocol::SocketType", TypeIdValue(GetTcpVariant(variant)));
+  Config::SetDefault("ns3::TcpSocket::DelAckCount", UintegerValue(1));
+
+  PointToPointHelper p2p;
+  p2p.SetDeviceAttribute("DataRate", StringValue("1Mbps"));
+  p2p.SetChannelAttribute("Delay", StringValue("2ms"));
+  p2p.SetQueue("ns3::DropTailQueue<Packet>", "MaxSize", QueueSizeValue(QueueSize("5p")));
+
+  PerfCounters perf;
+  perf.Begin();
+  FatTree ft;
+  BuildFatTree(ft, config, p2p, perf);
+  uint32_t half = ft.k / 2;
+  // Applications only exist on the rank that owns their node.
+  auto local = [&](Ptr<Node> n) { return n->GetSystemId() == config.rank; };
+
+  // TCP from the first host of pod 0 to the second host of the last edge switch
+  Ptr<Node> src = ft.Host(0, 0, 0);
+  Ptr<Node> dst = ft.Host(ft.k - 1, half - 1, 1);
+  Ipv4Address dstAddress = FatTree::HostAddress(ft.k - 1, half - 1, 1);
 
   uint16_t port = 5000;
-  BulkSendHelper tcpSource("ns3::TcpSocketFactory", InetSocketAddress(iface2.GetAddress(1), port));
-  tcpSource.SetAttribute("MaxBytes", UintegerValue(0));
-  ApplicationContainer tcpApps = tcpSource.Install(src);
-  tcpApps.Start(Seconds(1.0));
+  // Throughput is measured from here to the end of the run.
+  Time tcpStart = Seconds(1.0);
+  ApplicationContainer tcpApps, tcpSinkApps;
+  if (local(src))
+  {
+    BulkSendHelper tcpSource("ns3::TcpSocketFactory", InetSocketAddress(dstAddress, port));
+    tcpSource.SetAttribute("MaxBytes", UintegerValue(0));
+    tcpApps = tcpSource.Install(src);
+    tcpApps.Start(tcpStart);
+  }
 
-  PacketSinkHelper tcpSink("ns3::TcpSocketFactory", InetSocketAddress(Ipv4Address::GetAny(), port));
-  ApplicationContainer tcpSinkApps = tcpSink.Install(dst);
+  if (local(dst))
+  {
+    PacketSinkHelper tcpSink("ns3::TcpSocketFactory", InetSocketAddress(Ipv4Address::GetAny(), port));
+    tcpSinkApps = tcpSink.Install(dst);
+  }
 
+  uint32_t edges = ft.k * half;
   for (int i = 0; i < 6; ++i)
   {
-    Ptr<Node> udpSrc = hostGroups[(i + 1) % hostGroups.size()].Get(0);
-    OnOffHelper udp("ns3::UdpSocketFactory", InetSocketAddress(iface2.GetAddress(1), 9000 + i));
-    udp.SetAttribute("DataRate", DataRateValue(DataRate(std::to_string(int(cbrRateMbps)) + "Mbps")));
-    udp.SetAttribute("PacketSize", UintegerValue(200));
-    udp.SetAttribute("OnTime", StringValue("ns3::ConstantRandomVariable[Constant=1]"));
-    udp.SetAttribute("OffTime", StringValue("ns3::ConstantRandomVariable[Constant=0]"));
-    udp.SetAttribute("StartTime", TimeValue(Seconds(0.5)));
-    udp.SetAttribute("StopTime", TimeValue(Seconds(20.0)));
-    udp.Install(udpSrc);
+    uint32_t group = (i + 1) % edges;
+    Ptr<Node> udpSrc = ft.Host(group / half, group % half, 0);
+    if (local(udpSrc))
+    {
+      OnOffHelper udp("ns3::UdpSocketFactory", InetSocketAddress(dstAddress, 9000 + i));
+      udp.SetAttribute("DataRate", DataRateValue(DataRate(uint64_t(cbrRateMbps * 1e6))));
+      udp.SetAttribute("PacketSize", UintegerValue(200));
+      udp.SetAttribute("OnTime", StringValue("ns3::ConstantRandomVariable[Constant=1]"));
+      udp.SetAttribute("OffTime", StringValue("ns3::ConstantRandomVariable[Constant=0]"));
+      udp.SetAttribute("StartTime", TimeValue(Seconds(0.5)));
+      udp.SetAttribute("StopTime", TimeValue(Seconds(20.0)));
+      udp.Install(udpSrc);
+    }
 
-    PacketSinkHelper udpSink("ns3::UdpSocketFactory", InetSocketAddress(Ipv4Address::GetAny(), 9000 + i));
-    udpSink.Install(dst);
+    if (local(dst))
+    {
+      PacketSinkHelper udpSink("ns3::UdpSocketFactory", InetSocketAddress(Ipv4Address::GetAny(), 9000 + i));
+      udpSink.Install(dst);
+    }
+  }
+
+  // Every UDP source sends to dst, which makes dst's edge downlink the bottleneck.
+  BottleneckQueue queue;
+  Ptr<NetDevice> bottleneck;
+  if (local(dst))
+  {
+    Ptr<Channel> downlink = dst->GetDevice(1)->GetChannel();
+    bottleneck = downlink->GetDevice(downlink->GetDevice(0)->GetNode() == dst ? 1 : 0);
+    queue.Install(bottleneck, config.queue);
   }
 
+  // Only reported by single-process runs; a rank sees just its own pods' switches.
+  UplinkMonitor uplinks;
+  uplinks.Install(ft.uplinks, config.rank);
+  const UplinkMonitor* reportedUplinks = config.ranks == 1 ? &uplinks : nullptr;
+
   FlowMonitorHelper flowmon;
-  Ptr<FlowMonitor> monitor = flowmon.InstallAll();
+  Ptr<FlowMonitor> monitor;
+  EndpointFlowProbe probe;
+  if (config.endpointProbe)
+  {
+    // Only the measured flow is reported, so only its two hosts are probed.
+    if (local(src))
+    {
+      probe.Install(src);
+      probe.TraceRtt(tcpApps.Get(0), tcpStart, port);
+    }
+    if (local(dst))
+    {
+      probe.Install(dst);
+      probe.InstallBottleneck(bottleneck);
+    }
+  }
+  else
+  {
+    monitor = flowmon.Install(ft.hosts);
+  }
+
+  std::unique_ptr<FlowTracer> tracer;
+  if (!config.tracePrefix.empty())
+  {
+    NS_ABORT_MSG_IF(config.ranks > 1, "Flow tracing needs both ends of the flow in one process");
+    std::ostringstream path;
+    path << config.tracePrefix << "-" << FatTreeLabel(config) << "-" << variant << "-" << cbrRateMbps;
+    tracer = std::make_unique<FlowTracer>(path.str() + ".ftrc", config.traceInterval);
+    tracer->AddFlow(std::to_string(port), tcpApps.Get(0), tcpSinkApps.Get(0), tcpStart);
+    tracer->Start(tcpStart);
+    queue.Trace(path.str() + "-queue.csv", config.traceInterval, tcpStart);
+  }
+
+  std::unique_ptr<PacketCapture> capture;
+  if (!config.capture.links.empty())
+  {
+    NS_ABORT_MSG_IF(config.ranks > 1, "Packet capture is not supported in distributed runs");
+    std::ostringstream path;
+    path << config.capture.prefix << "-" << FatTreeLabel(config) << "-" << variant << "-" << cbrRateMbps;
+    capture = std::make_unique<PacketCapture>(config.capture, path.str());
+    capture->Install({{"bottleneck", bottleneck},
+                      {"core", FindLinkDevice(ft.agg.Get(0)->GetId(), ft.core.Get(0)->GetId())}});
+  }
+
+  // FatTreeRouting skips uplinks that are down by itself; global routing is recomputed.
+  EventTimeline timeline;
+  std::unique_ptr<TransientMonitor> transient;
+  if (!config.events.empty())
+  {
+    NS_ABORT_MSG_IF(config.ranks > 1, "Event timelines are not supported in distributed runs");
+    TimelineHooks hooks;
+    hooks.bottleneck = bottleneck;
+    hooks.links["core"] = FindLinkDevice(ft.agg.Get(0)->GetId(), ft.core.Get(0)->GetId());
+    Ptr<Node> extra = ft.Host(0, 0, 1);
+    hooks.addFlow = [extra, dst, dstAddress, variant](uint32_t n, const std::string& flowVariant) {
+      uint16_t flowPort = 5100 + n;
+      PacketSinkHelper sink("ns3::TcpSocketFactory", InetSocketAddress(Ipv4Address::GetAny(), flowPort));
+      sink.Install(dst);
+      InstallFlowSender(extra, InetSocketAddress(dstAddress, flowPort), flowVariant.empty() ? variant : flowVariant);
+    };
+    if (config.globalRouting)
+    {
+      hooks.rerouted = []() { Ipv4GlobalRoutingHelper::RecomputeRoutingTables(); };
+    }
+    timeline.Schedule(config.events, hooks);
+    transient = std::make_unique<TransientMonitor>(config.transient, tcpStart);
+    // Six CBR senders converge on the destination's downlink with the TCP flow.
+    transient->SetFairShare(bottleneck, 6 * cbrRateMbps, 1);
+    transient->Install(tcpApps.Get(0), tcpSinkApps.Get(0));
+  }
+
+  if (g_perfLog.IsOpen())
+  {
+    perf.CountLinks();
+  }
 
   Simulator::Stop(Seconds(20.0));
-  Simulator::Run();
+  perf.Run();
+  double runSec = perf.RunSeconds();
+  if (tracer)
+  {
+    tracer->Finish();
+  }
+  if (capture)
+  {
+    capture->Finish();
+  }
+  if (transient && config.report)
+  {
+    g_eventLog.Append(FatTreeLabel(config), variant, cbrRateMbps, transient->Finish(config.events));
+  }
+
+  if (config.endpointProbe)
+  {
+    FlowProbeMap flows = probe.GetFlows();
+#ifdef NS3_MPI
+    if (config.ranks > 1) flows = GatherFlows(probe, config);
+#endif
+    if (config.rank == 0)
+    {
+      for (const auto& flow : flows)
+      {
+        if (flow.first.protocol != 6 || flow.first.dstPort != port) continue;
+
+        const FlowProbeStats& st = flow.second;
+        double throughput = st.rxBytes * 8.0 / ((Simulator::Now() - tcpStart).GetSeconds() * 1e6);
+        double avgRtt = st.rxPackets > 0 ? st.delaySumNs / 1e6 / st.rxPackets : -1.0;
+        double dropRate = DropRate(st.txPackets, st.rxPackets);
+        ReportFlow(config, variant, cbrRateMbps, port, throughput, avgRtt, dropRate, bottleneck ? &queue : nullptr,
+                   &st, probe.GetRtt(port), reportedUplinks);
+      }
+    }
+    if (config.report && config.rank == 0)
+    {
+      g_perfLog.Append(FatTreeLabel(config), variant, cbrRateMbps, perf.Finish(probe.GetPacketsSeen()));
+    }
+    Simulator::Destroy();
+    return runSec;
+  }
 
   monitor->CheckForLostPackets();
   FlowMonitor::FlowStatsContainer stats = monitor->GetFlowStats();
@@ -127,29 +838,372 @@ void RunScenario1(const std::string& variant, double cbrRateMbps)
     if (t.protocol != 6) continue;
     if (t.destinationPort != 5000) continue;
 
-    double throughput = stat.second.rxBytes * 8.0 / (20.0 * 1e6);
+    double throughput = stat.second.rxBytes * 8.0 / ((Simulator::Now() - tcpStart).GetSeconds() * 1e6);
     double avgRtt = stat.second.delaySum.GetSeconds() / stat.second.rxPackets * 1000;
-    double dropRate = stat.second.lostPackets * 1.0 / (stat.second.txPackets + stat.second.lostPackets);
-    std::cout << "Scenario3," << variant << "," << cbrRateMbps << "," << throughput << "," << avgRtt << "," << dropRate << std::endl;
+    double dropRate = DropRate(stat.second.txPackets, stat.second.rxPackets);
+    ReportFlow(config, variant, cbrRateMbps, port, throughput, avgRtt, dropRate, &queue, nullptr, nullptr, &uplinks);
+  }
+  if (config.report)
+  {
+    g_perfLog.Append(FatTreeLabel(config), variant, cbrRateMbps, perf.Finish(PerfCounters::FlowMonitorPackets(monitor)));
+  }
+
+  Simulator::Destroy();
+  return runSec;
+}
+
+// Data-center workload between all hosts of the fat tree, each of them both sender
+// and receiver, in one process. The load is relative to the hosts' combined access
+// capacity and the ideal FCT of a flow is its base RTT over the shortest path plus
+// its serialization at 1 Mbps.
+void RunWorkload(const std::string& variant, double load, const FatTreeConfig& config, const WorkloadOptions& workload)
+{
+  Config::SetDefault("ns3::TcpL4Protocol::SocketType", TypeIdValue(GetTcpVariant(variant)));
+  Config::SetDefault("ns3::TcpSocket::DelAckCount", UintegerValue(1));
+
+  PointToPointHelper p2p;
+  p2p.SetDeviceAttribute("DataRate", StringValue("1Mbps"));
+  p2p.SetChannelAttribute("Delay", StringValue("2ms"));
+  p2p.SetQueue("ns3::DropTailQueue<Packet>", "MaxSize", QueueSizeValue(QueueSize("5p")));
+
+  PerfCounters perf;
+  perf.Begin();
+  FatTree ft;
+  BuildFatTree(ft, config, p2p, perf);
+  uint32_t half = ft.k / 2;
+
+  // Every host is a receiver, so a non-default AQM goes on every edge downlink.
+  std::deque<BottleneckQueue> queues;
+  for (uint32_t i = 0; i < ft.hosts.GetN() && !IsDefaultAqm(config.queue.aqm); ++i)
+  {
+    Ptr<Node> host = ft.hosts.Get(i);
+    Ptr<Channel> downlink = host->GetDevice(1)->GetChannel();
+    queues.emplace_back();
+    queues.back().Install(downlink->GetDevice(downlink->GetDevice(0)->GetNode() == host ? 1 : 0), config.queue);
   }
 
+  WorkloadOptions options = workload;
+  options.load = load;
+  DcWorkload generator;
+  generator.Install(ft.hosts, ft.hosts, options, ft.hosts.GetN() * 1e6,
+                    [half](uint32_t src, uint32_t dst, uint64_t bytes) {
+                      // Links on the path: via the edge switch, the aggregation layer or the core.
+                      uint32_t hops = src / half == dst / half ? 2 : src / (half * half) == dst / (half * half) ? 4 : 6;
+                      return MilliSeconds(2 * hops * 2) + Seconds(bytes * 8.0 / 1e6);
+                    });
+  if (g_perfLog.IsOpen())
+  {
+    perf.CountLinks();
+  }
+
+  Simulator::Stop(options.stop + Seconds(10));
+  perf.Run();
+
+  g_fctLog.Append(FatTreeLabel(config) + "-Workload", variant, load, generator.Finish());
+  g_perfLog.Append(FatTreeLabel(config) + "-Workload", variant, load, perf.Finish(0));
   Simulator::Destroy();
 }
 
+#ifdef NS3_MPI
+// One configuration partitioned by pod across the MPI ranks (mpirun -np N). The
+// distributed simulator derives its lookahead from the aggregation-core link delay.
+int RunDistributed(const std::string& variant, double cbrRateMbps, FatTreeConfig config, bool compareSequential)
+{
+  config.ranks = MpiInterface::GetSize();
+  config.rank = MpiInterface::GetSystemId();
+  config.endpointProbe = true;
 
+  // The sequential baseline runs on rank 0 alone while the other ranks wait.
+  double sequentialSec = 0;
+  if (compareSequential)
+  {
+    if (config.rank == 0)
+    {
+      FatTreeConfig sequential = config;
+      sequential.ranks = 1;
+      sequential.report = false;
+      GlobalValue::Bind("SimulatorImplementationType", StringValue("ns3::DefaultSimulatorImpl"));
+      sequentialSec = RunScenario1(variant, cbrRateMbps, sequential);
+      GlobalValue::Bind("SimulatorImplementationType", StringValue("ns3::DistributedSimulatorImpl"));
+    }
+    MPI_Barrier(MPI_COMM_WORLD);
+  }
+
+  if (config.rank == 0)
+  {
+    PrintCsvHeader(std::cout);
+  }
+  double runSec = RunScenario1(variant, cbrRateMbps, config);
+  double slowestSec = 0;
+  MPI_Reduce(&runSec, &slowestSec, 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+
+  if (config.rank == 0)
+  {
+    std::clog << "# distributed ranks=" << config.ranks << " run=" << slowestSec << "s";
+    if (compareSequential)
+    {
+      std::clog << " sequential=" << sequentialSec << "s speedup=" << sequentialSec / slowestSec;
+    }
+    std::clog << std::endl;
+  }
+  MpiInterface::Disable();
+  return 0;
+}
+#endif
 
 int main(int argc, char *argv[])
 {
+  SweepOptions sweep;
+  sweep.workers = std::max(1u, std::thread::hardware_concurrency());
+  FatTreeConfig fatTree;
+  std::string onlyVariant;
+  double onlyRate = 0;
+  bool distributed = false;
+  bool compareSequential = false;
+  std::string resultsPath;
+  std::string codeVersion = SIM_CODE_VERSION;
+  std::string exportCsv;
+  std::string exportColumns;
+  std::string perfOut;
+  std::string perfLinksOut;
+  std::string scheduler = "Map";
+  WorkloadOptions workload;
+  std::string workloadLoads = "0.5";
+  std::string fctOut = "fct.csv";
+  bool kneeSearch = false;
+  KneeOptions knee;
+  std::string kneeSummary;
+  std::string events;
+  std::string eventsShare;
+  std::string eventsOut = "events.csv";
+  RegressionOptions regression;
+
+  CommandLine cmd(__FILE__);
+  cmd.AddValue("k", "Fat tree arity (even, 4..48)", fatTree.k);
+  cmd.AddValue("globalRouting", "Populate routing tables with Ipv4GlobalRoutingHelper instead of FatTreeRouting", fatTree.globalRouting);
+  cmd.AddValue("balancing", "Uplink choice of the switches: TwoLevel (by destination host), Ecmp (five-tuple hash), Flowlet or Spray (per packet)", fatTree.balancing);
+  cmd.AddValue("flowletGap", "Idle time after which a flow may move to another uplink with --balancing=Flowlet", fatTree.flowletGap);
+  cmd.AddValue("endpointProbe", "Measure flows with the endpoint probe instead of FlowMonitor", fatTree.endpointProbe);
+  cmd.AddValue("trace", "Write cwnd/RTT/pacing/goodput time series of the TCP flow to <prefix>-FatTree-k<k>-<variant>-<rate>.ftrc and the bottleneck queue to ...-queue.csv", fatTree.tracePrefix);
+  cmd.AddValue("traceInterval", "Sampling interval of the flow trace", fatTree.traceInterval);
+  cmd.AddValue("capture", "Comma-separated links to write pcap files of: bottleneck, core or <node>-<node> (what the first node sends the second)", fatTree.capture.links);
+  cmd.AddValue("capturePrefix", "Capture files are <prefix>-FatTree-k<k>-<variant>-<rate>-<link>-<n>.pcap", fatTree.capture.prefix);
+  cmd.AddValue("capturePorts", "Comma-separated TCP/UDP ports to capture (default: every packet)", fatTree.capture.ports);
+  cmd.AddValue("captureSnapLen", "Bytes kept of each captured packet, PPP header included", fatTree.capture.snapLength);
+  cmd.AddValue("captureSample", "Capture 1 in N of the matching packets", fatTree.capture.sampleEvery);
+  cmd.AddValue("captureStart", "Start of the capture window", fatTree.capture.windowStart);
+  cmd.AddValue("captureStop", "End of the capture window (0: end of the run)", fatTree.capture.windowStop);
+  cmd.AddValue("captureFileBytes", "Size at which a capture file is rotated", fatTree.capture.fileBytes);
+  cmd.AddValue("captureFiles", "Capture files kept per link; older ones are removed", fatTree.capture.files);
+  cmd.AddValue("captureTrigger", "Only capture around intervals in which a captured link drops at least this fraction (0: always)", fatTree.capture.triggerDropRate);
+  cmd.AddValue("captureTriggerInterval", "Interval over which the trigger drop rate is measured", fatTree.capture.triggerInterval);
+  cmd.AddValue("captureTriggerHold", "Time the capture continues after the last triggering interval", fatTree.capture.triggerHold);
+  cmd.AddValue("capturePreTrigger", "Packets per link kept from before a trigger", fatTree.capture.preTriggerPackets);
+  cmd.AddValue("events", "Timeline of every run, e.g. 5s:rate=500kbps,10s:fail=core,12s:restore=core,15s:flow=TcpCubic", events);
+  cmd.AddValue("eventsOut", "Append the TCP flow's response to every timeline event to this CSV file", eventsOut);
+  cmd.AddValue("eventsSample", "Bin width of the goodput and RTT the event responses are computed from", fatTree.transient.sample);
+  cmd.AddValue("eventsWindow", "Averaging window of the goodput after an event", fatTree.transient.window);
+  cmd.AddValue("eventsFraction", "Fraction of the fair share or settled goodput within which the flow counts as converged", fatTree.transient.fraction);
+  cmd.AddValue("eventsShare", "Comma-separated fair shares (Mbps) of the measured flow after each event; empty entries are computed", eventsShare);
+  cmd.AddValue("variant", "Only run this TCP variant", onlyVariant);
+  cmd.AddValue("aqm", "Bottleneck queue: Default, DropTail, RED, CoDel, FqCoDel, PIE or DctcpStep", fatTree.queue.aqm);
+  cmd.AddValue("ecn", "Negotiate ECN on every TCP connection and let the AQM mark instead of drop", fatTree.queue.ecn);
+  cmd.AddValue("aqmLimit", "Capacity of a non-default bottleneck queue disc", fatTree.queue.limit);
+  cmd.AddValue("aqmMarkThreshold", "Queued packets above which DctcpStep marks", fatTree.queue.markThreshold);
+  cmd.AddValue("rate", "Only run this CBR rate in Mbps", onlyRate);
+  cmd.AddValue("workloadCdf", "Run a data-center workload with flow sizes from this CDF file instead of the CBR sweep", workload.cdfPath);
+  cmd.AddValue("workloadLoads", "Comma-separated offered loads of the workload, relative to the host access capacity", workloadLoads);
+  cmd.AddValue("workloadStop", "Time after which the workload starts no new flows", workload.stop);
+  cmd.AddValue("workloadFlows", "Poisson flows the workload starts at most (0: until workloadStop)", workload.maxFlows);
+  cmd.AddValue("incastInterval", "Time between partition/aggregate incast bursts (0 disables them)", workload.incastInterval);
+  cmd.AddValue("incastFanIn", "Senders answering each incast burst", workload.incastFanIn);
+  cmd.AddValue("incastBytes", "Bytes each incast sender answers with", workload.incastBytes);
+  cmd.AddValue("workloadTimeWait", "TIME_WAIT of the workload's finished flows (twice the TCP segment lifetime)", workload.timeWait);
+  cmd.AddValue("fctOut", "Append the workload's flow completion times by size bucket to this CSV file", fctOut);
+  cmd.AddValue("knee", "Search for the CBR rate at which the TCP flow collapses instead of running rates 1..10", kneeSearch);
+  cmd.AddValue("kneeLow", "Lowest CBR rate (Mbps) of the knee search", knee.low);
+  cmd.AddValue("kneeHigh", "Highest CBR rate (Mbps) of the knee search", knee.high);
+  cmd.AddValue("kneePoints", "Evenly spaced rates the knee search starts with, both ends included", knee.initialPoints);
+  cmd.AddValue("kneeResolution", "Rate interval (Mbps) to which the knee is narrowed down", knee.resolution);
+  cmd.AddValue("kneeBudget", "Runs per variant the knee search may use", knee.budget);
+  cmd.AddValue("kneeMetric", "Knee criterion: DropRate (reaches kneeDropRate) or Throughput (falls below kneeThroughputFraction of the best)", knee.metric);
+  cmd.AddValue("kneeDropRate", "Drop rate that marks the knee", knee.dropRate);
+  cmd.AddValue("kneeThroughputFraction", "Fraction of the best throughput below which the knee is passed", knee.throughputFraction);
+  cmd.AddValue("kneeSummary", "Write the knee of every variant to this CSV file (default: stderr)", kneeSummary);
+  cmd.AddValue("distributed", "Partition the fabric by pod across MPI ranks (run under mpirun)", distributed);
+  cmd.AddValue("compareSequential", "With --distributed, also time a sequential run on rank 0 and report the speedup", compareSequential);
+  cmd.AddValue("jobs", "Worker processes for the sweep (0 runs every configuration in this process)", sweep.workers);
+  cmd.AddValue("jobTimeout", "Per-configuration wall-clock limit in seconds (0 disables it)", sweep.timeoutSec);
+  cmd.AddValue("scheduler", "Event scheduler: Map, Heap, List, Calendar or PriorityQueue", scheduler);
+  cmd.AddValue("perfOut", "Append a performance record (phase times, events, queue depth, peak RSS, link packets) per run to this CSV file", perfOut);
+  cmd.AddValue("perfLinksOut", "Append the packets of every link per run to this CSV file (needs --perfOut)", perfLinksOut);
+  cmd.AddValue("regression", "Run the fixed-seed regression suite and compare its rows with this golden CSV file", regression.golden);
+  cmd.AddValue("regressionBaseline", "Performance log (see --perfOut) whose wall times, event rates and peak RSS the suite is compared with", regression.baseline);
+  cmd.AddValue("regressionUpdate", "Rewrite the golden file and the baseline from this run instead of comparing", regression.update);
+  cmd.AddValue("regressionSummary", "Append the comparison table to this CSV file (default: stderr)", regression.summary);
+  cmd.AddValue("regressionThroughputTol", "Relative throughput change that counts as a regression", regression.throughputTolerance);
+  cmd.AddValue("regressionRttTol", "Relative RTT change that counts as a regression", regression.rttTolerance);
+  cmd.AddValue("regressionDropTol", "Absolute drop rate change that counts as a regression", regression.dropTolerance);
+  cmd.AddValue("regressionSlowdown", "Factor by which wall time or peak RSS may grow, and the event rate shrink, over the baseline", regression.slowdown);
+  cmd.AddValue("results", "Append results to this store and skip configurations it already holds", resultsPath);
+  cmd.AddValue("codeVersion", "Code version recorded with each result; stored results of other versions are rerun", codeVersion);
+  cmd.AddValue("exportCsv", "Write every record of the results store to this CSV file and exit", exportCsv);
+  cmd.AddValue("exportColumns", "Write the results store as one .npy file per column into this directory and exit", exportColumns);
+  cmd.Parse(argc, argv);
+
+  NS_ABORT_MSG_IF(fatTree.capture.sampleEvery < 1, "--captureSample must be at least 1");
+  SelectScheduler(scheduler);
+  fatTree.events = ParseTimeline(events);
+  fatTree.transient.shares = ParseShares(eventsShare);
+  if (!fatTree.events.empty())
+  {
+    g_eventLog.Open(eventsOut);
+  }
+  if (fatTree.queue.ecn)
+  {
+    Config::SetDefault("ns3::TcpSocketBase::UseEcn", StringValue("On"));
+  }
+  if (!perfOut.empty())
+  {
+    g_perfLog.Open(perfOut);
+  }
+  if (!perfLinksOut.empty())
+  {
+    g_perfLog.OpenLinks(perfLinksOut);
+  }
+  if (!resultsPath.empty())
+  {
+    g_results.Open(resultsPath, codeVersion);
+  }
+  if (!exportCsv.empty() || !exportColumns.empty())
+  {
+    NS_ABORT_MSG_IF(!g_results.IsOpen(), "Exporting needs --results");
+    if (!exportCsv.empty()) g_results.ExportCsv(exportCsv);
+    if (!exportColumns.empty()) g_results.ExportColumns(exportColumns);
+    return 0;
+  }
+
+  if (distributed)
+  {
+#ifdef NS3_MPI
+    NS_ABORT_MSG_IF(!workload.cdfPath.empty(), "The workload runs in one process; drop --distributed");
+    NS_ABORT_MSG_IF(onlyVariant.empty() || onlyRate <= 0, "--distributed runs one configuration: set --variant and --rate");
+    GlobalValue::Bind("SimulatorImplementationType", StringValue("ns3::DistributedSimulatorImpl"));
+    MpiInterface::Enable(&argc, &argv);
+    return RunDistributed(onlyVariant, onlyRate, fatTree, compareSequential);
+#else
+    NS_ABORT_MSG("--distributed needs ns-3 configured with --enable-mpi");
+#endif
+  }
+
   std::vector<std::string> tcpVariants = {"TcpVegas", "TcpWestwoodPlus", "TcpBbr", "TcpCubic", "TcpVeno"};
-  std::cout << "Scenario,Variant,CBR(Mbps),Throughput(Mbps),AvgRTT(ms),DropRate" << std::endl;
+  if (!onlyVariant.empty()) tcpVariants = {onlyVariant};
+  std::vector<SweepJob> jobs;
+
+  // Regression suite: every variant at two rates with a fixed seed, one run at a time
+  // so that wall times and peak RSS are comparable.
+  if (!regression.golden.empty())
+  {
+    RngSeedManager::SetSeed(1);
+    RngSeedManager::SetRun(1);
+    std::string perfLog = perfOut;
+    if (perfLog.empty())
+    {
+      perfLog = regression.golden + ".perf";
+      std::remove(perfLog.c_str());
+      g_perfLog.Open(perfLog);
+    }
+    regression.codeVersion = codeVersion;
+    for (const auto& variant : tcpVariants)
+    {
+      for (int rate : {2, 8})
+      {
+        jobs.push_back({"FatTree/" + variant + "/" + std::to_string(rate), 0,
+                        [=]() { RunScenario1(variant, rate, fatTree); }});
+      }
+    }
+    SweepOptions sequential = sweep;
+    sequential.workers = 1;
+    PrintCsvHeader(std::cout);
+    std::vector<ResultRecord> rows;
+    size_t failed = RunSweep(jobs, sequential, [&](size_t, const SweepOutcome& outcome) {
+      std::cout << outcome.output << std::flush;
+      std::istringstream lines(outcome.output);
+      std::string line;
+      ResultRecord r;
+      while (std::getline(lines, line))
+      {
+        if (ParseCsvRow(line, r)) rows.push_back(r);
+      }
+    });
+    NS_ABORT_MSG_IF(failed > 0 && regression.update, failed << " regression runs failed; nothing was updated");
+    size_t regressed = RegressionCheck(regression).Finish(rows, perfLog);
+    std::clog << "# regression: " << jobs.size() << " runs, " << failed << " failed, " << regressed
+              << " values regressed" << std::endl;
+    return failed + regressed == 0 ? 0 : 1;
+  }
+
+  if (!workload.cdfPath.empty())
+  {
+    g_fctLog.Open(fctOut);
+    std::istringstream loads(workloadLoads);
+    std::string load;
+    while (std::getline(loads, load, ','))
+    {
+      double l = std::stod(load);
+      for (const auto& variant : tcpVariants)
+      {
+        jobs.push_back({"FatTree-Workload/" + variant + "/" + load,
+                        (workload.stop.GetSeconds() + 10) * (1.0 + 10 * l) * fatTree.k,
+                        [=]() { RunWorkload(variant, l, fatTree, workload); }});
+      }
+    }
+    size_t failed = RunSweep(jobs, sweep);
+    return failed == 0 ? 0 : 1;
+  }
+
+  if (kneeSearch)
+  {
+    NS_ABORT_MSG_IF(knee.metric != "DropRate" && knee.metric != "Throughput", "Unknown knee metric: " << knee.metric);
+    NS_ABORT_MSG_IF(knee.resolution <= 0 || knee.high <= knee.low, "The knee search needs kneeLow < kneeHigh and a positive resolution");
+    std::vector<KneeConfig> configs;
+    for (const auto& variant : tcpVariants)
+    {
+      configs.push_back({"FatTree/" + variant,
+                         [k = fatTree.k](double rate) { return 20.0 * (1.0 + 6 * rate / 10.0) * k; },
+                         [=](double rate) { RunScenario1(variant, rate, fatTree); }, ConfigKey(fatTree, variant, 0)});
+    }
+    PrintCsvHeader(std::cout);
+    std::cout.flush();
+    size_t failed = 0;
+    std::vector<KneeSummary> summaries = RunKneeSearches(configs, knee, sweep, g_results, failed);
+    if (kneeSummary.empty())
+    {
+      PrintKneeSummary(std::clog, configs, summaries, knee);
+    }
+    else
+    {
+      std::ofstream out(kneeSummary);
+      PrintKneeSummary(out, configs, summaries, knee);
+    }
+    return failed == 0 ? 0 : 1;
+  }
 
   for (const auto& variant : tcpVariants)
   {
     for (int rate = 1; rate <= 10; ++rate)
     {
-      RunScenario1(variant, rate);
+      if (onlyRate > 0 && rate != onlyRate) continue;
+      SweepJob job{"FatTree/" + variant + "/" + std::to_string(rate),
+                   20.0 * (1.0 + 6 * rate / 10.0) * fatTree.k, [=]() { RunScenario1(variant, rate, fatTree); }};
+      ResumeFromStore(job, g_results, ConfigKey(fatTree, variant, rate));
+      jobs.push_back(job);
     }
   }
 
-  return 0;
+  PrintCsvHeader(std::cout);
+  std::cout.flush();
+  size_t failed = RunSweep(jobs, sweep);
+
+  return failed == 0 ? 0 : 1;
 }
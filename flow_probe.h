@@ -0,0 +1,428 @@
+#ifndef FLOW_PROBE_H
+#define FLOW_PROBE_H
+
+#include "results_store.h"
+#include "tcp_variants.h"
+
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/internet-module.h"
+#include "ns3/applications-module.h"
+#include "ns3/point-to-point-module.h"
+#include "ns3/traffic-control-module.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <tuple>
+#include <vector>
+
+namespace ns3 {
+
+// Send time of a packet, attached where it leaves its source host. It is a packet
+// tag, so it also crosses the serialized MPI remote channels of a distributed run.
+class FlowProbeTimestampTag : public Tag
+{
+public:
+    static TypeId GetTypeId ()
+    {
+        static TypeId tid = TypeId ("ns3::FlowProbeTimestampTag")
+                                .SetParent<Tag> ()
+                                .SetGroupName ("FlowMonitor")
+                                .AddConstructor<FlowProbeTimestampTag> ();
+        return tid;
+    }
+    TypeId GetInstanceTypeId () const override { return GetTypeId (); }
+    uint32_t GetSerializedSize () const override { return 8; }
+    void Serialize (TagBuffer i) const override { i.WriteU64 (m_sendNs); }
+    void Deserialize (TagBuffer i) override { m_sendNs = i.ReadU64 (); }
+    void Print (std::ostream& os) const override { os << "send=" << m_sendNs << "ns"; }
+
+    uint64_t m_sendNs = 0;
+};
+
+NS_OBJECT_ENSURE_REGISTERED (FlowProbeTimestampTag);
+
+// Fixed-memory log-linear histogram of nanosecond values in the style of
+// HdrHistogram: every power of two is split into 2^kSubBits linear buckets, so a
+// recorded value is known to within 1/32 of itself from 32 ns to over an hour.
+// Recording is a bit scan and an increment; histograms merge by adding counts.
+struct LogHistogram
+{
+    static constexpr uint32_t kSubBits = 5;
+    static constexpr uint32_t kSub = 1u << kSubBits;
+    static constexpr uint32_t kMaxExp = 41;
+    static constexpr uint32_t kBuckets = (kMaxExp - kSubBits + 2) * kSub;
+
+    uint64_t total = 0;
+    uint64_t counts[kBuckets] = {};
+
+    static uint32_t Index (uint64_t v)
+    {
+        if (v < kSub)
+        {
+            return v;
+        }
+        uint32_t e = 63 - __builtin_clzll (v);
+        if (e > kMaxExp)
+        {
+            return kBuckets - 1;
+        }
+        return (e - kSubBits + 1) * kSub + ((v >> (e - kSubBits)) & (kSub - 1));
+    }
+
+    // Midpoint of the values a bucket holds.
+    static double Value (uint32_t index)
+    {
+        if (index < kSub)
+        {
+            return index;
+        }
+        uint32_t e = index / kSub + kSubBits - 1;
+        uint64_t width = uint64_t (1) << (e - kSubBits);
+        return double ((kSub + index % kSub) * width) + width / 2.0;
+    }
+
+    void Record (uint64_t v)
+    {
+        counts[Index (v)]++;
+        total++;
+    }
+
+    void Merge (const LogHistogram& o)
+    {
+        for (uint32_t i = 0; i < kBuckets; ++i)
+        {
+            counts[i] += o.counts[i];
+        }
+        total += o.total;
+    }
+
+    // Value at quantile q (0..1), -1 when empty.
+    double Percentile (double q) const
+    {
+        if (total == 0)
+        {
+            return -1;
+        }
+        uint64_t rank = std::max<uint64_t> (1, uint64_t (std::ceil (q * total)));
+        uint64_t seen = 0;
+        for (uint32_t i = 0; i < kBuckets; ++i)
+        {
+            seen += counts[i];
+            if (seen >= rank)
+            {
+                return Value (i);
+            }
+        }
+        return Value (kBuckets - 1);
+    }
+};
+
+// Socket of a sender application once it has started.
+inline Ptr<Socket> GetSenderSocket (Ptr<Application> sender)
+{
+    if (Ptr<BulkSendApplication> bulk = DynamicCast<BulkSendApplication> (sender))
+    {
+        return bulk->GetSocket ();
+    }
+    if (Ptr<FlowSender> flow = DynamicCast<FlowSender> (sender))
+    {
+        return flow->GetSocket ();
+    }
+    return nullptr;
+}
+
+struct FlowProbeKey
+{
+    uint32_t src;
+    uint32_t dst;
+    uint16_t srcPort;
+    uint16_t dstPort;
+    uint8_t protocol;
+
+    bool operator< (const FlowProbeKey& o) const
+    {
+        return std::tie (src, dst, srcPort, dstPort, protocol) <
+               std::tie (o.src, o.dst, o.srcPort, o.dstPort, o.protocol);
+    }
+
+    // Field by field: the padding after protocol is indeterminate.
+    bool operator== (const FlowProbeKey& o) const
+    {
+        return src == o.src && dst == o.dst && srcPort == o.srcPort && dstPort == o.dstPort && protocol == o.protocol;
+    }
+};
+
+struct FlowProbeStats
+{
+    uint64_t txPackets = 0;
+    uint64_t txBytes = 0;
+    uint64_t rxPackets = 0;
+    uint64_t rxBytes = 0;
+    int64_t delaySumNs = 0;
+    int64_t lastDelayNs = -1;
+    uint64_t bottleneckTxPackets = 0;   // at the devices InstallBottleneck was called for
+    uint64_t bottleneckDrops = 0;
+    uint64_t reordered = 0;             // delivered after a packet of the flow that was sent later
+    uint64_t maxSendNs = 0;             // latest send time delivered so far, receiver side only
+    LogHistogram delay;                 // one-way delay
+    LogHistogram jitter;                // |delay - previous delay|, the RFC 3393 IPDV
+
+    void Merge (const FlowProbeStats& o)
+    {
+        txPackets += o.txPackets;
+        txBytes += o.txBytes;
+        rxPackets += o.rxPackets;
+        rxBytes += o.rxBytes;
+        delaySumNs += o.delaySumNs;
+        bottleneckTxPackets += o.bottleneckTxPackets;
+        bottleneckDrops += o.bottleneckDrops;
+        reordered += o.reordered;
+        delay.Merge (o.delay);
+        jitter.Merge (o.jitter);
+    }
+};
+
+typedef std::map<FlowProbeKey, FlowProbeStats> FlowProbeMap;
+
+// Packets sent but not delivered over packets sent, 1 when nothing was sent. Every
+// DropRate column is computed this way, whichever counters the packets come from.
+inline double DropRate (uint64_t txPackets, uint64_t rxPackets)
+{
+    return txPackets > 0 ? (txPackets - std::min (txPackets, rxPackets)) / double (txPackets) : 1.0;
+}
+
+// Per-flow counters and delay/jitter histograms kept only at the hosts it is
+// installed on, plus optional bottleneck devices. Unlike FlowMonitor it keeps no
+// per-packet state and does one lookup per packet, so the sending and receiving
+// halves of a flow can live in different processes and be merged by five-tuple.
+class EndpointFlowProbe
+{
+public:
+    void Install (Ptr<Node> node)
+    {
+        Ptr<Ipv4L3Protocol> ipv4 = node->GetObject<Ipv4L3Protocol> ();
+        ipv4->TraceConnectWithoutContext ("SendOutgoing", MakeCallback (&EndpointFlowProbe::SendOutgoing, this));
+        ipv4->TraceConnectWithoutContext ("LocalDeliver", MakeCallback (&EndpointFlowProbe::LocalDeliver, this));
+    }
+
+    void Install (const NodeContainer& nodes)
+    {
+        for (uint32_t i = 0; i < nodes.GetN (); ++i)
+        {
+            Install (nodes.Get (i));
+        }
+    }
+
+    // Counts per-flow transmissions and queue drops at a point-to-point device.
+    void InstallBottleneck (Ptr<NetDevice> device)
+    {
+        Ptr<PointToPointNetDevice> p2p = DynamicCast<PointToPointNetDevice> (device);
+        NS_ABORT_MSG_IF (!p2p, "Bottleneck probes need a point-to-point device");
+        p2p->TraceConnectWithoutContext ("MacTx", MakeCallback (&EndpointFlowProbe::BottleneckTx, this));
+        p2p->GetQueue ()->TraceConnectWithoutContext ("Drop", MakeCallback (&EndpointFlowProbe::BottleneckDrop, this));
+        if (Ptr<TrafficControlLayer> tc = device->GetNode ()->GetObject<TrafficControlLayer> ())
+        {
+            if (Ptr<QueueDisc> qdisc = tc->GetRootQueueDiscOnDevice (device))
+            {
+                qdisc->TraceConnectWithoutContext ("Drop", MakeCallback (&EndpointFlowProbe::QueueDiscDrop, this));
+            }
+        }
+    }
+
+    // Records the RTT samples of a TCP sender whose socket exists from start on
+    // (absolute time), under the destination port of its flow.
+    void TraceRtt (Ptr<Application> sender, Time start, uint16_t port)
+    {
+        Simulator::Schedule (start - Simulator::Now () + NanoSeconds (1), [this, sender, port] () {
+            Ptr<Socket> socket = GetSenderSocket (sender);
+            NS_ABORT_MSG_IF (!socket, "No sender socket to sample RTTs from");
+            socket->TraceConnectWithoutContext ("RTT", MakeBoundCallback (&EndpointFlowProbe::Rtt, &m_rtt[port]));
+        });
+    }
+
+    const FlowProbeMap& GetFlows () const { return m_flows; }
+
+    // RTT samples of a traced sender, null when none was traced for the port.
+    const LogHistogram* GetRtt (uint16_t port) const
+    {
+        auto it = m_rtt.find (port);
+        return it == m_rtt.end () ? nullptr : &it->second;
+    }
+
+    uint64_t GetPacketsSeen () const { return m_packetsSeen; }
+
+    std::vector<uint8_t> Serialize () const
+    {
+        const size_t record = sizeof (FlowProbeKey) + sizeof (FlowProbeStats);
+        std::vector<uint8_t> out (m_flows.size () * record);
+        uint8_t* p = out.data ();
+        for (const auto& flow : m_flows)
+        {
+            std::memcpy (p, &flow.first, sizeof (FlowProbeKey));
+            std::memcpy (p + sizeof (FlowProbeKey), &flow.second, sizeof (FlowProbeStats));
+            p += record;
+        }
+        return out;
+    }
+
+    // Adds counters serialized by another probe; buffers come from identical builds.
+    static void Merge (FlowProbeMap& flows, const uint8_t* data, size_t size)
+    {
+        const size_t record = sizeof (FlowProbeKey) + sizeof (FlowProbeStats);
+        for (size_t off = 0; off + record <= size; off += record)
+        {
+            FlowProbeKey key {};
+            FlowProbeStats stats;
+            std::memcpy (&key, data + off, sizeof (FlowProbeKey));
+            std::memcpy (&stats, data + off + sizeof (FlowProbeKey), sizeof (FlowProbeStats));
+            flows[key].Merge (stats);
+        }
+    }
+
+private:
+    FlowProbeStats& Stats (const FlowProbeKey& key)
+    {
+        // Packets of one flow come in runs, so the last flow is checked before the map.
+        if (!m_last || !(key == m_lastKey))
+        {
+            m_last = &m_flows[key];
+            m_lastKey = key;
+        }
+        m_packetsSeen++;
+        return *m_last;
+    }
+
+    static bool MakeKey (const Ipv4Header& header, Ptr<const Packet> packet, FlowProbeKey& key)
+    {
+        uint8_t protocol = header.GetProtocol ();
+        if ((protocol != 6 && protocol != 17) || packet->GetSize () < 4)
+        {
+            return false;
+        }
+        uint8_t ports[4];
+        packet->CopyData (ports, 4);
+        std::memset (&key, 0, sizeof (key));
+        key.src = header.GetSource ().Get ();
+        key.dst = header.GetDestination ().Get ();
+        key.srcPort = (ports[0] << 8) | ports[1];
+        key.dstPort = (ports[2] << 8) | ports[3];
+        key.protocol = protocol;
+        return true;
+    }
+
+    void SendOutgoing (const Ipv4Header& header, Ptr<const Packet> packet, uint32_t interface)
+    {
+        FlowProbeKey key {};
+        if (!MakeKey (header, packet, key))
+        {
+            return;
+        }
+        FlowProbeTimestampTag tag;
+        tag.m_sendNs = Simulator::Now ().GetNanoSeconds ();
+        ConstCast<Packet> (packet)->ReplacePacketTag (tag);
+
+        FlowProbeStats& stats = Stats (key);
+        stats.txPackets++;
+        stats.txBytes += packet->GetSize () + header.GetSerializedSize ();
+    }
+
+    void LocalDeliver (const Ipv4Header& header, Ptr<const Packet> packet, uint32_t interface)
+    {
+        FlowProbeKey key {};
+        if (!MakeKey (header, packet, key))
+        {
+            return;
+        }
+        FlowProbeStats& stats = Stats (key);
+        stats.rxPackets++;
+        stats.rxBytes += packet->GetSize () + header.GetSerializedSize ();
+
+        FlowProbeTimestampTag tag;
+        if (ConstCast<Packet> (packet)->RemovePacketTag (tag))
+        {
+            int64_t delay = Simulator::Now ().GetNanoSeconds () - int64_t (tag.m_sendNs);
+            stats.delaySumNs += delay;
+            stats.delay.Record (delay);
+            if (stats.lastDelayNs >= 0)
+            {
+                stats.jitter.Record (std::abs (delay - stats.lastDelayNs));
+            }
+            stats.lastDelayNs = delay;
+            // Retransmissions are sent after what they repair, so only genuine
+            // reordering by the network arrives with an earlier send time.
+            if (tag.m_sendNs < stats.maxSendNs)
+            {
+                stats.reordered++;
+            }
+            stats.maxSendNs = std::max (stats.maxSendNs, tag.m_sendNs);
+        }
+    }
+
+    // Packets at a bottleneck start with their IPv4 header, after the PPP header
+    // once they are in the device queue.
+    void CountAtBottleneck (Ptr<const Packet> packet, bool hasPpp, bool dropped)
+    {
+        Ptr<Packet> copy = packet->Copy ();
+        if (hasPpp)
+        {
+            PppHeader ppp;
+            copy->RemoveHeader (ppp);
+        }
+        Ipv4Header header;
+        copy->RemoveHeader (header);
+        FlowProbeKey key {};
+        if (!MakeKey (header, copy, key))
+        {
+            return;
+        }
+        FlowProbeStats& stats = Stats (key);
+        (dropped ? stats.bottleneckDrops : stats.bottleneckTxPackets)++;
+    }
+
+    void BottleneckTx (Ptr<const Packet> packet) { CountAtBottleneck (packet, false, false); }
+    void BottleneckDrop (Ptr<const Packet> packet) { CountAtBottleneck (packet, true, true); }
+    void QueueDiscDrop (Ptr<const QueueDiscItem> item)
+    {
+        Ptr<const Ipv4QueueDiscItem> ip = DynamicCast<const Ipv4QueueDiscItem> (item);
+        FlowProbeKey key {};
+        if (ip && MakeKey (ip->GetHeader (), ip->GetPacket (), key))
+        {
+            Stats (key).bottleneckDrops++;
+        }
+    }
+
+    static void Rtt (LogHistogram* rtt, Time, Time sample) { rtt->Record (sample.GetNanoSeconds ()); }
+
+    FlowProbeMap m_flows;
+    std::map<uint16_t, LogHistogram> m_rtt;
+    FlowProbeStats* m_last = nullptr;
+    FlowProbeKey m_lastKey {};
+    uint64_t m_packetsSeen = 0;
+};
+
+// Fills the tail-latency columns of a result row from a flow's probe counters and,
+// when the sender was traced, its RTT samples.
+inline void SetTailLatency (ResultRecord& r, const FlowProbeStats& st, const LogHistogram* rtt)
+{
+    auto ms = [] (double ns) { return ns < 0 ? -1.0 : ns / 1e6; };
+    r.delayP50Ms = ms (st.delay.Percentile (0.5));
+    r.delayP90Ms = ms (st.delay.Percentile (0.9));
+    r.delayP99Ms = ms (st.delay.Percentile (0.99));
+    r.delayP999Ms = ms (st.delay.Percentile (0.999));
+    r.jitterP99Ms = ms (st.jitter.Percentile (0.99));
+    if (rtt)
+    {
+        r.rttP50Ms = ms (rtt->Percentile (0.5));
+        r.rttP99Ms = ms (rtt->Percentile (0.99));
+    }
+    r.bottleneckDrops = st.bottleneckDrops;
+    r.reorderRate = st.rxPackets > 0 ? double (st.reordered) / st.rxPackets : -1;
+}
+
+} // namespace ns3
+
+#endif // FLOW_PROBE_H
@@ -0,0 +1,213 @@
+#ifndef FLOW_TRACER_H
+#define FLOW_TRACER_H
+
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/internet-module.h"
+#include "ns3/applications-module.h"
+
+#include "flow_probe.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace ns3 {
+
+// One sample of a traced flow; 32 bytes, written to disk as is.
+struct FlowTraceSample
+{
+    uint64_t timeNs;
+    uint64_t rxBytes;      // cumulative bytes delivered to the sink
+    uint64_t pacingBps;
+    uint32_t cwndBytes;
+    uint32_t rttUs;
+};
+
+// Samples the congestion window, RTT, pacing rate and delivered bytes of a set of
+// TCP flows at a fixed interval. Trace sources only overwrite the latest values;
+// one periodic event copies them into preallocated per-flow rings that a background
+// thread drains to disk, so the simulation thread never formats or writes output.
+//
+// File layout (little endian): "FTRC", u32 version, u64 interval in ns, u32 flow
+// count, per flow a u16 name length and the name; then blocks of u32 flow index,
+// u32 sample count and that many FlowTraceSample records.
+class FlowTracer
+{
+public:
+    FlowTracer (const std::string& path, Time interval, uint32_t ringSamples = 4096)
+        : m_path (path),
+          m_interval (interval)
+    {
+        m_capacity = 2;
+        while (m_capacity < ringSamples)
+        {
+            m_capacity <<= 1;
+        }
+    }
+
+    ~FlowTracer ()
+    {
+        Finish ();
+    }
+
+    // Registers a flow whose sender socket is created when its application starts;
+    // start is an absolute simulation time.
+    void AddFlow (const std::string& name, Ptr<Application> sender, Ptr<Application> sink, Time start)
+    {
+        NS_ABORT_MSG_IF (m_writer.joinable (), "Flows must be added before the tracer starts");
+        m_flows.push_back (std::make_unique<Flow> ());
+        Flow* flow = m_flows.back ().get ();
+        flow->name = name;
+        flow->ring.resize (m_capacity);
+        sink->TraceConnectWithoutContext ("Rx", MakeBoundCallback (&FlowTracer::Rx, flow));
+        NS_ABORT_MSG_IF (start < Simulator::Now (), "Flow " << name << " started before tracing");
+        Simulator::Schedule (start - Simulator::Now () + NanoSeconds (1), &FlowTracer::ConnectSender, flow, sender);
+    }
+
+    void Start (Time at)
+    {
+        m_file = std::fopen (m_path.c_str (), "wb");
+        NS_ABORT_MSG_IF (!m_file, "Cannot open flow trace " << m_path);
+        WriteHeader ();
+        m_writer = std::thread (&FlowTracer::Drain, this);
+        Simulator::Schedule (at - Simulator::Now (), &FlowTracer::Sample, this);
+    }
+
+    void Finish ()
+    {
+        if (!m_writer.joinable ())
+        {
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock (m_mutex);
+            m_stop = true;
+        }
+        m_wake.notify_one ();
+        m_writer.join ();
+        std::fclose (m_file);
+        for (const auto& flow : m_flows)
+        {
+            if (flow->dropped > 0)
+            {
+                std::clog << "# flow trace " << flow->name << ": " << flow->dropped
+                          << " samples dropped, writer fell behind" << std::endl;
+            }
+        }
+    }
+
+private:
+    struct Flow
+    {
+        std::string name;
+        FlowTraceSample latest {};
+        std::vector<FlowTraceSample> ring;
+        std::atomic<uint64_t> head {0};  // written by the simulation thread
+        std::atomic<uint64_t> tail {0};  // written by the writer thread
+        uint64_t dropped = 0;
+    };
+
+    static void Cwnd (Flow* flow, uint32_t, uint32_t cwnd) { flow->latest.cwndBytes = cwnd; }
+    static void Rtt (Flow* flow, Time, Time rtt) { flow->latest.rttUs = rtt.GetMicroSeconds (); }
+    static void Pacing (Flow* flow, DataRate, DataRate rate) { flow->latest.pacingBps = rate.GetBitRate (); }
+    static void Rx (Flow* flow, Ptr<const Packet> p, const Address&) { flow->latest.rxBytes += p->GetSize (); }
+
+    static void ConnectSender (Flow* flow, Ptr<Application> sender)
+    {
+        Ptr<Socket> socket = GetSenderSocket (sender);
+        NS_ABORT_MSG_IF (!socket, "Flow " << flow->name << " has no sender socket to trace");
+        socket->TraceConnectWithoutContext ("CongestionWindow", MakeBoundCallback (&FlowTracer::Cwnd, flow));
+        socket->TraceConnectWithoutContext ("RTT", MakeBoundCallback (&FlowTracer::Rtt, flow));
+        socket->TraceConnectWithoutContext ("PacingRate", MakeBoundCallback (&FlowTracer::Pacing, flow));
+    }
+
+    void WriteHeader ()
+    {
+        uint32_t version = 1;
+        uint64_t intervalNs = m_interval.GetNanoSeconds ();
+        uint32_t flows = m_flows.size ();
+        std::fwrite ("FTRC", 1, 4, m_file);
+        std::fwrite (&version, sizeof (version), 1, m_file);
+        std::fwrite (&intervalNs, sizeof (intervalNs), 1, m_file);
+        std::fwrite (&flows, sizeof (flows), 1, m_file);
+        for (const auto& flow : m_flows)
+        {
+            uint16_t len = flow->name.size ();
+            std::fwrite (&len, sizeof (len), 1, m_file);
+            std::fwrite (flow->name.data (), 1, len, m_file);
+        }
+    }
+
+    void Sample ()
+    {
+        bool wake = false;
+        for (const auto& flow : m_flows)
+        {
+            uint64_t head = flow->head.load (std::memory_order_relaxed);
+            if (head - flow->tail.load (std::memory_order_acquire) >= m_capacity)
+            {
+                flow->dropped++;
+                continue;
+            }
+            flow->latest.timeNs = Simulator::Now ().GetNanoSeconds ();
+            flow->ring[head & (m_capacity - 1)] = flow->latest;
+            flow->head.store (head + 1, std::memory_order_release);
+            wake |= (head + 1) % (m_capacity / 2) == 0;
+        }
+        if (wake)
+        {
+            m_wake.notify_one ();
+        }
+        Simulator::Schedule (m_interval, &FlowTracer::Sample, this);
+    }
+
+    // Writer thread: copies whatever the rings hold into one block per flow.
+    void Drain ()
+    {
+        bool stop = false;
+        while (!stop)
+        {
+            {
+                std::unique_lock<std::mutex> lock (m_mutex);
+                m_wake.wait_for (lock, std::chrono::milliseconds (100));
+                stop = m_stop;
+            }
+            for (uint32_t i = 0; i < m_flows.size (); ++i)
+            {
+                Flow& flow = *m_flows[i];
+                uint64_t tail = flow.tail.load (std::memory_order_relaxed);
+                uint64_t head = flow.head.load (std::memory_order_acquire);
+                while (tail < head)
+                {
+                    uint64_t start = tail & (m_capacity - 1);
+                    uint32_t count = std::min<uint64_t> (head - tail, m_capacity - start);
+                    std::fwrite (&i, sizeof (i), 1, m_file);
+                    std::fwrite (&count, sizeof (count), 1, m_file);
+                    std::fwrite (&flow.ring[start], sizeof (FlowTraceSample), count, m_file);
+                    tail += count;
+                }
+                flow.tail.store (tail, std::memory_order_release);
+            }
+        }
+    }
+
+    std::string m_path;
+    Time m_interval;
+    uint64_t m_capacity;
+    std::vector<std::unique_ptr<Flow>> m_flows;
+    std::FILE* m_file = nullptr;
+    std::thread m_writer;
+    std::mutex m_mutex;
+    std::condition_variable m_wake;
+    bool m_stop = false;
+};
+
+} // namespace ns3
+
+#endif // FLOW_TRACER_H
@@ -0,0 +1,699 @@
+#ifndef FLUID_MODEL_H
+#define FLUID_MODEL_H
+
+#include "ns3/core-module.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <string>
+#include <vector>
+
+namespace ns3 {
+
+// Point-to-point link of a fluid network. aqm names the root queue disc like
+// BottleneckQueueOptions does, where Default is the FqCoDel queue disc ns-3 puts on
+// every device that gets an address, and None leaves the DropTail device queue on
+// its own. A queue disc sits on devicePackets of FIFO device queue, which is full
+// whenever the queue disc holds anything.
+struct FluidLink
+{
+    double capacityBps = 10e6;
+    double delaySec = 0.01;
+    std::string aqm = "Default";
+    double limitPackets = 10240;        // queue disc (None: device queue) capacity
+    double devicePackets = 100;
+    double markThreshold = 20;          // DctcpStep
+    bool ecn = false;                   // the queue disc marks ECN-capable flows instead of dropping
+};
+
+// A flow of a fluid network: a TCP variant, or CBR for an OnOff source.
+struct FluidFlow
+{
+    std::string variant;
+    std::vector<size_t> path;           // links from source to sink
+    double packetBytes = 536;           // TCP segment or UDP payload
+    double headerBytes = 40;            // IP and transport headers
+    double startSec = 1;
+    double stopSec = std::numeric_limits<double>::infinity ();
+    double cbrRateBps = 0;              // CBR: payload rate while on
+    double onSec = 0;                   // CBR: on/off cycle, 0 sends continuously
+    double offSec = 0;
+    double phaseSec = 0;
+    double maxWindowBytes = 131072;     // TCP: smaller of the send and receive buffers
+    bool ecn = false;                   // TCP: negotiates ECN
+};
+
+// Same definitions as a result row: IP bytes delivered over the flow's lifetime,
+// mean one-way delay of the delivered packets, lost over sent packets.
+struct FluidFlowResult
+{
+    double throughputMbps = 0;
+    double delayMs = -1;
+    double dropRate = 0;
+};
+
+// Fluid approximation of a packet network, integrated with a fixed step. Queues are
+// per-link (per-flow under fair queueing) bit contents fed by the rates the flows
+// leave their previous link with; drops and marks follow the queue disc's rule on
+// the fluid state, and a TCP sender reacts once per RTT to each whole packet of
+// loss or marking it accumulates, which keeps its sawtooth. Senders follow the
+// published window dynamics of their variant (AIMD with the Cubic, Veno, Westwood+
+// and DCTCP modifications, Vegas' delay target, BBR's bandwidth and RTT model);
+// ACKs are assumed not to queue. A scenario takes milliseconds instead of minutes.
+class FluidNetwork
+{
+public:
+    static bool Supports (const std::string& variant)
+    {
+        return variant == "CBR" || variant == "TcpNewReno" || variant == "TcpCubic" || variant == "TcpVeno" ||
+               variant == "TcpWestwoodPlus" || variant == "TcpVegas" || variant == "TcpBbr" || variant == "TcpDctcp";
+    }
+
+    size_t AddLink (const FluidLink& link)
+    {
+        m_links.push_back (link);
+        return m_links.size () - 1;
+    }
+
+    size_t AddFlow (const FluidFlow& flow)
+    {
+        NS_ABORT_MSG_IF (!Supports (flow.variant), "No fluid model of " << flow.variant);
+        m_flows.push_back (flow);
+        return m_flows.size () - 1;
+    }
+
+    std::vector<FluidFlowResult> Run (double stopSec, double stepSec = 1e-3)
+    {
+        Init ();
+        for (double t = 0; t < stopSec; t += stepSec)
+        {
+            Step (t, stepSec);
+        }
+        std::vector<FluidFlowResult> results (m_flows.size ());
+        for (size_t f = 0; f < m_flows.size (); ++f)
+        {
+            const FlowState& s = m_state[f];
+            double seconds = std::min (stopSec, m_flows[f].stopSec) - m_flows[f].startSec;
+            results[f].throughputMbps = seconds > 0 ? s.deliveredIpBits / seconds / 1e6 : 0;
+            results[f].delayMs = s.deliveredPackets > 0 ? 1000 * s.delaySum / s.deliveredPackets : -1;
+            results[f].dropRate = s.sentPackets > 0 ? s.lostPackets / s.sentPackets : 0;
+        }
+        return results;
+    }
+
+private:
+    static constexpr double kPppBytes = 2;
+    static constexpr double kInitialWindow = 10;
+
+    enum BbrMode { STARTUP, DRAIN, PROBE_BW, PROBE_RTT };
+
+    struct FlowState
+    {
+        double wireBits = 0;            // one packet on the wire
+        double baseRtt = 0;             // propagation and serialization, no queueing
+        std::vector<double> hopIn, hopOut, hopDelay;    // per link of the path
+        // TCP window in packets and its reaction to congestion
+        double w = kInitialWindow;
+        double ssthresh = std::numeric_limits<double>::infinity ();
+        double maxWindow = 0;
+        double lossCredit = 0;
+        double markCredit = 0;
+        double lastReduction = -1;
+        double minRtt = std::numeric_limits<double>::infinity ();
+        double wMax = 0;                // Cubic
+        double epoch = 0;
+        double bwe = 0;                 // Westwood+, packets/s
+        double alpha = 1;               // DCTCP
+        double windowStart = 0;
+        double windowMarked = 0;
+        double windowAcked = 0;
+        // BBR
+        BbrMode mode = STARTUP;
+        double btlBw = 0;               // wire bits/s
+        std::vector<double> roundMax;
+        double roundStart = 0;
+        double rtProp = 0;
+        double rtPropStamp = 0;
+        double fullBw = 0;
+        int fullBwRounds = 0;
+        int cycle = 0;
+        double cycleStart = 0;
+        double probeRttEnd = 0;
+        // statistics from the flow's start
+        double sentPackets = 0;
+        double lostPackets = 0;
+        double deliveredPackets = 0;
+        double deliveredIpBits = 0;
+        double delaySum = 0;            // seconds * packets
+    };
+
+    struct LinkState
+    {
+        std::vector<std::pair<size_t, size_t>> flows;   // (flow, hop)
+        std::vector<double> q;          // bits queued per entry of flows
+        std::vector<double> ctl;        // CoDel drop count, per entry under FqCoDel
+        std::vector<double> aboveSince;
+        double avg = 0;                 // RED average queue, packets
+        double p = 0;                   // RED/PIE probability
+        double pieOld = 0;
+        double pieNext = 0;
+    };
+
+    bool IsFq (const FluidLink& l) const { return l.aqm == "Default" || l.aqm == "FqCoDel"; }
+
+    bool Marks (const FluidLink& l) const { return l.aqm != "None" && l.aqm != "DropTail" && (l.ecn || l.aqm == "DctcpStep"); }
+
+    void Init ()
+    {
+        m_state.assign (m_flows.size (), FlowState ());
+        m_linkState.assign (m_links.size (), LinkState ());
+        for (size_t f = 0; f < m_flows.size (); ++f)
+        {
+            const FluidFlow& flow = m_flows[f];
+            FlowState& s = m_state[f];
+            s.wireBits = 8 * (flow.packetBytes + flow.headerBytes + kPppBytes);
+            size_t hops = flow.path.size ();
+            s.hopIn.assign (hops, 0);
+            s.hopOut.assign (hops, 0);
+            s.hopDelay.assign (hops, 0);
+            for (size_t h = 0; h < hops; ++h)
+            {
+                const FluidLink& l = m_links[flow.path[h]];
+                s.baseRtt += 2 * l.delaySec + s.wireBits / l.capacityBps;
+                LinkState& ls = m_linkState[flow.path[h]];
+                ls.flows.push_back ({f, h});
+            }
+            s.maxWindow = std::max (2.0, flow.maxWindowBytes / flow.packetBytes);
+            s.rtProp = s.baseRtt;
+            s.btlBw = kInitialWindow * s.wireBits / s.baseRtt;
+            s.roundMax.assign (10, 0);
+        }
+        for (auto& ls : m_linkState)
+        {
+            ls.q.assign (ls.flows.size (), 0);
+            ls.ctl.assign (ls.flows.size (), 0);
+            ls.aboveSince.assign (ls.flows.size (), -1);
+        }
+    }
+
+    bool Active (const FluidFlow& flow, double t) const { return t >= flow.startSec && t < flow.stopSec; }
+
+    // Wire rate the flow puts on its first link.
+    double SendRate (size_t f, double t)
+    {
+        const FluidFlow& flow = m_flows[f];
+        FlowState& s = m_state[f];
+        if (!Active (flow, t))
+        {
+            return 0;
+        }
+        if (flow.variant == "CBR")
+        {
+            double period = flow.onSec + flow.offSec;
+            bool on = flow.offSec <= 0 || std::fmod (t - flow.startSec + flow.phaseSec, period) < flow.onSec;
+            return on ? flow.cbrRateBps * s.wireBits / (8 * flow.packetBytes) : 0;
+        }
+        double rtt = Rtt (f);
+        double windowRate = std::min (s.w, s.maxWindow) * s.wireBits / rtt;
+        if (flow.variant != "TcpBbr")
+        {
+            return windowRate;
+        }
+        static const double gains[8] = {1.25, 0.75, 1, 1, 1, 1, 1, 1};
+        double gain = s.mode == STARTUP ? 2.885 : s.mode == DRAIN ? 1 / 2.885 : s.mode == PROBE_BW ? gains[s.cycle] : 1;
+        double cwndGain = s.mode == PROBE_RTT ? 0 : s.mode == PROBE_BW ? 2 : 2.885;
+        double inflight = s.mode == PROBE_RTT ? 4 * s.wireBits : cwndGain * s.btlBw * s.rtProp;
+        return std::min ({gain * s.btlBw, inflight / rtt, s.maxWindow * s.wireBits / rtt});
+    }
+
+    double Rtt (size_t f) const
+    {
+        const FlowState& s = m_state[f];
+        double rtt = s.baseRtt;
+        for (double d : s.hopDelay)
+        {
+            rtt += d;
+        }
+        return rtt;
+    }
+
+    void Step (double t, double dt)
+    {
+        for (size_t f = 0; f < m_flows.size (); ++f)
+        {
+            FlowState& s = m_state[f];
+            for (size_t h = s.hopIn.size (); h-- > 1;)
+            {
+                s.hopIn[h] = s.hopOut[h - 1];
+            }
+            s.hopIn[0] = SendRate (f, t);
+        }
+        for (size_t l = 0; l < m_links.size (); ++l)
+        {
+            StepLink (l, t, dt);
+        }
+        for (size_t f = 0; f < m_flows.size (); ++f)
+        {
+            StepFlow (f, t, dt);
+        }
+    }
+
+    void StepLink (size_t l, double t, double dt)
+    {
+        const FluidLink& link = m_links[l];
+        LinkState& ls = m_linkState[l];
+        size_t n = ls.flows.size ();
+        if (n == 0)
+        {
+            return;
+        }
+        double c = link.capacityBps;
+        bool fq = IsFq (link);
+        bool none = link.aqm == "None";
+
+        double queued = 0;
+        double arriving = 0;
+        double pktBits = 0;
+        for (size_t i = 0; i < n; ++i)
+        {
+            queued += ls.q[i];
+            const FlowState& s = m_state[ls.flows[i].first];
+            arriving += s.hopIn[ls.flows[i].second];
+            pktBits = std::max (pktBits, s.wireBits);
+        }
+        double queuedPackets = queued / pktBits;
+
+        // Drop (or mark) probability per entry, from the queue disc's state.
+        std::vector<double> p (n, 0);
+        if (link.aqm == "RED" || link.aqm == "DctcpStep")
+        {
+            double weight = link.aqm == "DctcpStep" ? 1 : 1 - std::pow (1 - 0.002, arriving * dt / pktBits);
+            ls.avg += weight * (queuedPackets - ls.avg);
+            double prob;
+            if (link.aqm == "DctcpStep")
+            {
+                prob = ls.avg > link.markThreshold ? 1 : 0;
+            }
+            else
+            {
+                // ns-3 defaults: MinTh 5, MaxTh 15, 1/LInterm = 0.02, gentle.
+                prob = ls.avg < 5 ? 0 : ls.avg < 15 ? 0.02 * (ls.avg - 5) / 10 : ls.avg < 30 ? 0.02 + 0.98 * (ls.avg - 15) / 15 : 1;
+            }
+            std::fill (p.begin (), p.end (), prob);
+        }
+        else if (link.aqm == "PIE")
+        {
+            if (t >= ls.pieNext)
+            {
+                double delay = queued / c;
+                double step = 0.125 * (delay - 0.015) + 1.25 * (delay - ls.pieOld);
+                // PIE scales its steps down while the probability is small (RFC 8033).
+                double scale = ls.p < 1e-6 ? 1.0 / 2048 : ls.p < 1e-5 ? 1.0 / 512 : ls.p < 1e-4 ? 1.0 / 128
+                               : ls.p < 1e-3 ? 1.0 / 32 : ls.p < 1e-2 ? 1.0 / 8 : ls.p < 0.1 ? 0.5 : 1;
+                ls.p = std::min (1.0, std::max (0.0, ls.p + scale * step));
+                ls.pieOld = delay;
+                ls.pieNext = t + 0.015;
+            }
+            std::fill (p.begin (), p.end (), ls.p);
+        }
+        else if (link.aqm == "CoDel" || fq)
+        {
+            // CoDel (target 5 ms, interval 100 ms) drops interval / sqrt(count) apart
+            // once the sojourn time has stayed above target for an interval.
+            for (size_t i = 0; i < (fq ? n : 1); ++i)
+            {
+                const FlowState& s = m_state[ls.flows[i].first];
+                double in = fq ? s.hopIn[ls.flows[i].second] : arriving;
+                double sojourn = fq ? ls.q[i] / std::max (c / n, 1.0) : queued / c;
+                double prob = 0;
+                if (sojourn > 0.005 && (fq ? ls.q[i] : queued) > pktBits)
+                {
+                    if (ls.aboveSince[i] < 0)
+                    {
+                        ls.aboveSince[i] = t;
+                    }
+                    if (t - ls.aboveSince[i] >= 0.1)
+                    {
+                        double dropsPerSec = std::sqrt (std::max (1.0, ls.ctl[i])) / 0.1;
+                        ls.ctl[i] += dropsPerSec * dt;
+                        prob = in > 0 ? std::min (1.0, dropsPerSec * pktBits / in) : 0;
+                    }
+                }
+                else
+                {
+                    ls.aboveSince[i] = -1;
+                    ls.ctl[i] = std::max (0.0, ls.ctl[i] - dt * ls.ctl[i] / 0.1);
+                }
+                if (fq)
+                {
+                    p[i] = prob;
+                }
+                else
+                {
+                    std::fill (p.begin (), p.end (), prob);
+                }
+            }
+        }
+
+        // Accepted arrivals; marks only signal, drops are lost.
+        std::vector<double> in (n);
+        double accepted = 0;
+        for (size_t i = 0; i < n; ++i)
+        {
+            size_t f = ls.flows[i].first;
+            FlowState& s = m_state[f];
+            double rate = s.hopIn[ls.flows[i].second];
+            double signalled = rate * p[i] * dt / s.wireBits;
+            if (Marks (link) && m_flows[f].ecn)
+            {
+                s.markCredit += signalled;
+                s.windowMarked += signalled;
+                in[i] = rate;
+            }
+            else
+            {
+                Lose (f, t, signalled);
+                in[i] = rate * (1 - p[i]);
+            }
+            accepted += in[i];
+        }
+
+        // Service: FIFO in proportion to the queue contents, fair queueing max-min.
+        std::vector<double> out (n, 0);
+        if (fq)
+        {
+            std::vector<bool> fixed (n, false);
+            double remaining = c;
+            size_t open = n;
+            bool changed = true;
+            while (changed && open > 0)
+            {
+                changed = false;
+                double share = remaining / open;
+                for (size_t i = 0; i < n; ++i)
+                {
+                    if (!fixed[i] && ls.q[i] <= 0 && in[i] <= share)
+                    {
+                        out[i] = in[i];
+                        remaining -= in[i];
+                        fixed[i] = true;
+                        --open;
+                        changed = true;
+                    }
+                }
+            }
+            for (size_t i = 0; i < n; ++i)
+            {
+                if (!fixed[i])
+                {
+                    out[i] = remaining / open;
+                }
+            }
+        }
+        else if (queued > 0)
+        {
+            for (size_t i = 0; i < n; ++i)
+            {
+                out[i] = c * ls.q[i] / queued;
+            }
+        }
+        else
+        {
+            double scale = accepted > c ? c / accepted : 1;
+            for (size_t i = 0; i < n; ++i)
+            {
+                out[i] = in[i] * scale;
+            }
+        }
+
+        double total = 0;
+        for (size_t i = 0; i < n; ++i)
+        {
+            double drained = std::min (out[i] * dt, ls.q[i] + in[i] * dt);
+            out[i] = drained / dt;
+            ls.q[i] += in[i] * dt - drained;
+            total += ls.q[i];
+        }
+        // Tail drop of what does not fit, spread over the arrivals of this step.
+        double limit = link.limitPackets * pktBits;
+        if (total > limit && accepted > 0)
+        {
+            double overflow = total - limit;
+            for (size_t i = 0; i < n; ++i)
+            {
+                double share = overflow * in[i] / accepted;
+                share = std::min (share, ls.q[i]);
+                ls.q[i] -= share;
+                Lose (ls.flows[i].first, t, share / m_state[ls.flows[i].first].wireBits);
+            }
+            total = limit;
+        }
+
+        double device = !none && total > pktBits ? link.devicePackets * pktBits / c : 0;
+        for (size_t i = 0; i < n; ++i)
+        {
+            FlowState& s = m_state[ls.flows[i].first];
+            size_t h = ls.flows[i].second;
+            s.hopOut[h] = out[i];
+            double wait = fq ? (ls.q[i] > 0 ? ls.q[i] / std::max (out[i], c / n) : 0) : total / c;
+            s.hopDelay[h] = wait + device;
+        }
+    }
+
+    void Lose (size_t f, double t, double packets)
+    {
+        FlowState& s = m_state[f];
+        s.lossCredit += packets;
+        if (Active (m_flows[f], t))
+        {
+            s.lostPackets += packets;
+        }
+    }
+
+    void StepFlow (size_t f, double t, double dt)
+    {
+        const FluidFlow& flow = m_flows[f];
+        FlowState& s = m_state[f];
+        if (!Active (flow, t))
+        {
+            return;
+        }
+        double delivered = s.hopOut.back ();
+        double oneWay = 0;
+        for (size_t h = 0; h < flow.path.size (); ++h)
+        {
+            const FluidLink& l = m_links[flow.path[h]];
+            oneWay += l.delaySec + s.wireBits / l.capacityBps + s.hopDelay[h];
+        }
+        s.sentPackets += s.hopIn[0] * dt / s.wireBits;
+        s.deliveredPackets += delivered * dt / s.wireBits;
+        s.deliveredIpBits += delivered * dt * (s.wireBits - 8 * kPppBytes) / s.wireBits;
+        s.delaySum += oneWay * delivered * dt / s.wireBits;
+        if (flow.variant == "CBR")
+        {
+            return;
+        }
+
+        double rtt = Rtt (f);
+        s.minRtt = std::min (s.minRtt, rtt);
+        double acked = delivered * dt / s.wireBits;
+        s.windowAcked += acked;
+        bool recovering = s.lastReduction >= 0 && t - s.lastReduction < rtt;
+        if (recovering)
+        {
+            s.lossCredit = 0;
+            s.markCredit = 0;
+        }
+
+        if (flow.variant == "TcpBbr")
+        {
+            StepBbr (s, t, rtt, delivered);
+            s.lossCredit = 0;
+            return;
+        }
+
+        if (s.lossCredit >= 1 || (flow.variant != "TcpDctcp" && s.markCredit >= 1))
+        {
+            Reduce (f, t, rtt);
+            s.lossCredit = 0;
+            s.markCredit = 0;
+            s.lastReduction = t;
+        }
+        else if (!recovering)
+        {
+            Grow (f, t, dt, rtt, delivered);
+        }
+
+        if (flow.variant == "TcpDctcp" && t - s.windowStart >= rtt)
+        {
+            double fraction = s.windowAcked > 0 ? std::min (1.0, s.windowMarked / s.windowAcked) : 0;
+            s.alpha += (fraction - s.alpha) / 16;
+            if (s.windowMarked >= 1)
+            {
+                s.w = std::max (2.0, s.w * (1 - s.alpha / 2));
+                s.ssthresh = s.w;
+            }
+            s.windowStart = t;
+            s.windowMarked = 0;
+            s.windowAcked = 0;
+        }
+        s.w = std::min (std::max (s.w, 1.0), s.maxWindow);
+    }
+
+    void Reduce (size_t f, double t, double rtt)
+    {
+        FlowState& s = m_state[f];
+        const std::string& v = m_flows[f].variant;
+        double queuedPackets = s.w * (rtt - s.minRtt) / rtt;
+        if (v == "TcpCubic")
+        {
+            // Fast convergence, beta 0.7.
+            s.wMax = s.w < s.wMax ? s.w * 1.7 / 2 : s.w;
+            s.w *= 0.7;
+            s.epoch = t;
+        }
+        else if (v == "TcpVeno")
+        {
+            s.w *= queuedPackets < 3 ? 0.8 : 0.5;
+        }
+        else if (v == "TcpWestwoodPlus")
+        {
+            s.w = std::max (2.0, s.bwe * s.minRtt);
+        }
+        else
+        {
+            s.w *= 0.5;
+        }
+        s.w = std::max (s.w, 2.0);
+        s.ssthresh = s.w;
+    }
+
+    void Grow (size_t f, double t, double dt, double rtt, double delivered)
+    {
+        FlowState& s = m_state[f];
+        const std::string& v = m_flows[f].variant;
+        s.bwe += (delivered / s.wireBits - s.bwe) * std::min (1.0, dt / rtt);
+        double queuedPackets = s.w * (rtt - s.minRtt) / rtt;
+        if (v == "TcpVegas")
+        {
+            // alpha 2, beta 4, gamma 1 packets queued in the network.
+            if (s.w < s.ssthresh)
+            {
+                if (queuedPackets > 1)
+                {
+                    s.ssthresh = s.w;
+                }
+                else
+                {
+                    s.w += s.w * dt / rtt;
+                }
+                return;
+            }
+            s.w += (queuedPackets < 2 ? 1 : queuedPackets > 4 ? -1 : 0) * dt / rtt;
+            return;
+        }
+        if (s.w < s.ssthresh)
+        {
+            s.w += s.w * dt / rtt;
+            if (v == "TcpCubic")
+            {
+                s.wMax = s.w;
+                s.epoch = t;
+            }
+            return;
+        }
+        if (v == "TcpCubic")
+        {
+            double elapsed = t - s.epoch;
+            double k = std::cbrt (s.wMax * 0.3 / 0.4);
+            double target = s.wMax + 0.4 * std::pow (elapsed + s.minRtt - k, 3);
+            double friendly = s.wMax * 0.7 + 3 * 0.3 / 1.7 * elapsed / rtt;
+            s.w += std::max (0.0, std::max (target, friendly) - s.w) * dt / rtt;
+        }
+        else if (v == "TcpVeno")
+        {
+            s.w += (queuedPackets < 3 ? 1 : 0.5) * dt / rtt;
+        }
+        else
+        {
+            s.w += dt / rtt;
+        }
+    }
+
+    void StepBbr (FlowState& s, double t, double rtt, double delivered)
+    {
+        // Rounds of one RTT; the bandwidth filter is the maximum over ten of them.
+        s.roundMax[0] = std::max (s.roundMax[0], delivered);
+        bool roundEnd = t - s.roundStart >= rtt;
+        if (roundEnd)
+        {
+            s.btlBw = *std::max_element (s.roundMax.begin (), s.roundMax.end ());
+            std::rotate (s.roundMax.rbegin (), s.roundMax.rbegin () + 1, s.roundMax.rend ());
+            s.roundMax[0] = 0;
+            s.roundStart = t;
+        }
+        if (rtt <= s.rtProp)
+        {
+            s.rtProp = rtt;
+            s.rtPropStamp = t;
+        }
+        else if (s.mode != PROBE_RTT && t - s.rtPropStamp > 10)
+        {
+            // The minimum RTT expired: drain to four packets for 200 ms to measure it anew.
+            s.mode = PROBE_RTT;
+            s.probeRttEnd = t + 0.2 + rtt;
+        }
+
+        switch (s.mode)
+        {
+        case STARTUP:
+            if (roundEnd)
+            {
+                if (s.btlBw >= 1.25 * s.fullBw)
+                {
+                    s.fullBw = s.btlBw;
+                    s.fullBwRounds = 0;
+                }
+                else if (++s.fullBwRounds >= 3)
+                {
+                    s.mode = DRAIN;
+                }
+            }
+            break;
+        case DRAIN:
+            if (rtt <= 1.05 * s.rtProp || roundEnd)
+            {
+                s.mode = PROBE_BW;
+                s.cycle = 2;
+                s.cycleStart = t;
+            }
+            break;
+        case PROBE_BW:
+            if (t - s.cycleStart >= s.rtProp)
+            {
+                s.cycle = (s.cycle + 1) % 8;
+                s.cycleStart = t;
+            }
+            break;
+        case PROBE_RTT:
+            if (t >= s.probeRttEnd)
+            {
+                s.rtProp = rtt;
+                s.rtPropStamp = t;
+                s.mode = PROBE_BW;
+                s.cycleStart = t;
+            }
+            break;
+        }
+    }
+
+    std::vector<FluidLink> m_links;
+    std::vector<FluidFlow> m_flows;
+    std::vector<FlowState> m_state;
+    std::vector<LinkState> m_linkState;
+};
+
+} // namespace ns3
+
+#endif // FLUID_MODEL_H
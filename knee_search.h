@@ -0,0 +1,191 @@
+#ifndef KNEE_SEARCH_H
+#define KNEE_SEARCH_H
+
+#include "results_store.h"
+#include "sweep_runner.h"
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace ns3 {
+
+struct KneeOptions
+{
+    double low = 1;                 // CBR rate range searched, in Mbps
+    double high = 10;
+    uint32_t initialPoints = 4;     // evenly spaced over the range, both ends included
+    double resolution = 0.25;       // width of the bracket at which the knee counts as found
+    uint32_t budget = 10;           // runs per configuration, the initial grid included
+    // DropRate: the knee is the lowest rate whose drop rate reaches dropRate.
+    // Throughput: the lowest rate whose throughput falls below throughputFraction
+    // of the best throughput seen.
+    std::string metric = "DropRate";
+    double dropRate = 0.01;
+    double throughputFraction = 0.8;
+};
+
+// One configuration whose knee is searched. run(rate) simulates it once at that CBR
+// rate and prints its result row for the measured flow first.
+struct KneeConfig
+{
+    std::string name;
+    std::function<double (double)> cost;
+    std::function<void (double)> run;
+    ResultKey key;                  // the rate is filled in per point
+    double low = NAN;               // range of this configuration, the options' when NaN
+    double high = NAN;
+};
+
+struct KneeSummary
+{
+    std::map<double, double> points;    // rate -> metric of the measured flow
+    uint32_t runs = 0;
+    double below = -1;                  // highest rate before the knee, -1 if it is below the range
+    double knee = -1;                   // lowest rate at or past it, -1 if it is above the range
+    bool done = false;
+};
+
+inline double KneeMetric (const KneeOptions& options, const ResultRecord& r)
+{
+    return options.metric == "Throughput" ? r.throughputMbps : r.dropRate;
+}
+
+inline void Summarize (KneeSummary& s, const KneeOptions& options)
+{
+    double best = 0;
+    for (const auto& p : s.points)
+    {
+        best = std::max (best, p.second);
+    }
+    auto past = [&] (double value) {
+        return options.metric == "Throughput" ? value < options.throughputFraction * best : value >= options.dropRate;
+    };
+
+    s.below = -1;
+    s.knee = -1;
+    for (const auto& p : s.points)
+    {
+        if (past (p.second))
+        {
+            s.knee = p.first;
+            break;
+        }
+        s.below = p.first;
+    }
+    bool bracketed = s.below >= 0 && s.knee >= 0;
+    s.done = s.runs >= options.budget || (s.runs > 0 && !bracketed) ||
+             (bracketed && s.knee - s.below <= options.resolution);
+}
+
+// Searches every configuration for the CBR rate at which the measured flow's metric
+// crosses the threshold. The first round runs the initial grid; every later round
+// splits the bracket around the first crossing into equal parts with as many new
+// points as its configuration's share of the workers, the remaining budget and the
+// resolution allow, so with one point per round it is a bisection. A configuration
+// whose grid shows no crossing stops there. Rows are printed as they come in; store
+// is consulted to resume stored points.
+inline std::vector<KneeSummary> RunKneeSearches (const std::vector<KneeConfig>& configs, const KneeOptions& options,
+                                                 const SweepOptions& sweep, ResultsStore& store,
+                                                 size_t& failures)
+{
+    std::vector<KneeSummary> summaries (configs.size ());
+    uint32_t initial = std::max (2u, std::min (options.initialPoints, options.budget));
+
+    while (true)
+    {
+        std::vector<double> rates;
+        std::vector<size_t> owner;
+        size_t active = 0;
+        for (const auto& s : summaries)
+        {
+            active += s.done ? 0 : 1;
+        }
+        uint32_t perConfig = std::max (1u, sweep.workers / unsigned (std::max<size_t> (1, active)));
+        for (size_t c = 0; c < configs.size (); ++c)
+        {
+            KneeSummary& s = summaries[c];
+            if (s.done)
+            {
+                continue;
+            }
+            double from = std::isnan (configs[c].low) ? options.low : configs[c].low;
+            double width = (std::isnan (configs[c].high) ? options.high : configs[c].high) - from;
+            uint32_t want = initial;
+            if (s.runs > 0)
+            {
+                from = s.below;
+                width = s.knee - s.below;
+                double splits = std::ceil (width / options.resolution) - 1;
+                want = std::min ({perConfig, options.budget - s.runs, uint32_t (std::max (1.0, splits))});
+            }
+            for (uint32_t i = 0; i < want; ++i)
+            {
+                double step = s.runs > 0 ? width / (want + 1) * (i + 1) : width / (want - 1) * i;
+                rates.push_back (from + step);
+                owner.push_back (c);
+            }
+            s.runs += want;
+        }
+        if (rates.empty ())
+        {
+            break;
+        }
+
+        std::vector<SweepJob> jobs;
+        for (size_t i = 0; i < rates.size (); ++i)
+        {
+            const KneeConfig& config = configs[owner[i]];
+            double rate = rates[i];
+            std::ostringstream name;
+            name << config.name << "/" << rate;
+            auto body = config.run;
+            SweepJob job {name.str (), config.cost (rate), [body, rate] () { body (rate); }};
+            ResultKey key = config.key;
+            key.cbrRateMbps = rate;
+            ResumeFromStore (job, store, key);
+            jobs.push_back (job);
+        }
+        failures += RunSweep (jobs, sweep, [&] (size_t i, const SweepOutcome& outcome) {
+            std::cout << outcome.output << std::flush;
+            std::istringstream lines (outcome.output);
+            std::string line;
+            ResultRecord r;
+            while (std::getline (lines, line))
+            {
+                if (ParseCsvRow (line, r))
+                {
+                    summaries[owner[i]].points[rates[i]] = KneeMetric (options, r);
+                    break;
+                }
+            }
+        });
+        for (auto& s : summaries)
+        {
+            Summarize (s, options);
+        }
+    }
+    return summaries;
+}
+
+inline void PrintKneeSummary (std::ostream& os, const std::vector<KneeConfig>& configs,
+                              const std::vector<KneeSummary>& summaries, const KneeOptions& options)
+{
+    os << "Scenario,Variant,Metric,Threshold,Runs,Below(Mbps),Knee(Mbps),Resolved\n";
+    for (size_t c = 0; c < configs.size (); ++c)
+    {
+        const KneeSummary& s = summaries[c];
+        bool resolved = s.below >= 0 && s.knee >= 0 && s.knee - s.below <= options.resolution;
+        os << configs[c].key.scenario << "," << configs[c].key.variant << "," << options.metric << ","
+           << (options.metric == "Throughput" ? options.throughputFraction : options.dropRate) << "," << s.runs
+           << "," << s.below << "," << s.knee << "," << (resolved ? 1 : 0) << "\n";
+    }
+}
+
+} // namespace ns3
+
+#endif // KNEE_SEARCH_H
@@ -0,0 +1,466 @@
+#ifndef PACKET_CAPTURE_H
+#define PACKET_CAPTURE_H
+
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/internet-module.h"
+#include "ns3/point-to-point-module.h"
+#include "ns3/traffic-control-module.h"
+
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace ns3 {
+
+struct PacketCaptureOptions
+{
+    // Comma-separated links to capture, each an alias the program defines (e.g.
+    // bottleneck) or <node>-<node> for what the first node sends to the second.
+    // Empty disables capture.
+    std::string links;
+    std::string prefix = "capture";
+    std::string ports;                  // comma-separated TCP/UDP ports, either end; empty keeps every packet
+    uint32_t snapLength = 96;           // bytes kept per packet, PPP header included
+    uint32_t sampleEvery = 1;           // keep 1 in N of the matching packets
+    Time windowStart = Seconds (0);
+    Time windowStop = Seconds (0);      // 0: until the end of the run
+    uint64_t fileBytes = 16 << 20;      // a file is closed before it would grow past this
+    uint32_t files = 4;                 // per link; older files are removed
+    // With a drop rate, packets are only written while some captured link has
+    // dropped at least that fraction of its packets within the last triggerInterval,
+    // and for triggerHold after; the preTriggerPackets before a spike are kept.
+    double triggerDropRate = 0;
+    Time triggerInterval = MilliSeconds (100);
+    Time triggerHold = Seconds (1);
+    uint32_t preTriggerPackets = 1000;
+};
+
+// Pcap files (DLT_PPP) of one link, <base>-<n>.pcap, rotated by size. Records are
+// collected into large buffers that a background thread writes out, so the
+// simulation only copies bytes; it waits for the thread only if the disk falls
+// far behind.
+class PcapRotatingWriter
+{
+public:
+    PcapRotatingWriter (const std::string& base, uint32_t snapLength, uint64_t fileBytes, uint32_t files)
+        : m_base (base),
+          m_snapLength (snapLength),
+          m_fileBytes (std::max<uint64_t> (fileBytes, 24 + 16 + snapLength)),
+          m_files (std::max (1u, files)),
+          m_thread (&PcapRotatingWriter::Loop, this)
+    {
+    }
+
+    ~PcapRotatingWriter () { Close (); }
+
+    void Write (Time t, const uint8_t* data, uint32_t captured, uint32_t original)
+    {
+        int64_t us = t.GetMicroSeconds ();
+        uint32_t header[4] = {uint32_t (us / 1000000), uint32_t (us % 1000000), captured, original};
+        const uint8_t* h = reinterpret_cast<const uint8_t*> (header);
+        m_buffer.insert (m_buffer.end (), h, h + sizeof (header));
+        m_buffer.insert (m_buffer.end (), data, data + captured);
+        if (m_buffer.size () >= kBufferBytes)
+        {
+            Flush ();
+        }
+    }
+
+    // Writes everything buffered and stops the thread; the files are complete after.
+    void Close ()
+    {
+        if (!m_thread.joinable ())
+        {
+            return;
+        }
+        Flush ();
+        {
+            std::lock_guard<std::mutex> lock (m_mutex);
+            m_closing = true;
+        }
+        m_ready.notify_one ();
+        m_thread.join ();
+    }
+
+private:
+    static constexpr size_t kBufferBytes = 256 << 10;
+    static constexpr size_t kMaxQueued = 64;
+
+    void Flush ()
+    {
+        if (m_buffer.empty ())
+        {
+            return;
+        }
+        std::unique_lock<std::mutex> lock (m_mutex);
+        m_drained.wait (lock, [this] () { return m_queue.size () < kMaxQueued; });
+        m_queue.push_back (std::move (m_buffer));
+        m_buffer.clear ();
+        m_buffer.reserve (kBufferBytes + 16 + m_snapLength);
+        lock.unlock ();
+        m_ready.notify_one ();
+    }
+
+    void Loop ()
+    {
+        while (true)
+        {
+            std::vector<uint8_t> buffer;
+            {
+                std::unique_lock<std::mutex> lock (m_mutex);
+                m_ready.wait (lock, [this] () { return m_closing || !m_queue.empty (); });
+                if (m_queue.empty ())
+                {
+                    break;
+                }
+                buffer = std::move (m_queue.front ());
+                m_queue.pop_front ();
+            }
+            m_drained.notify_one ();
+            WriteRecords (buffer);
+        }
+        if (m_file)
+        {
+            std::fclose (m_file);
+            m_file = nullptr;
+        }
+    }
+
+    // Splits at record boundaries so that no file grows past the limit.
+    void WriteRecords (const std::vector<uint8_t>& buffer)
+    {
+        size_t begin = 0;
+        while (begin < buffer.size ())
+        {
+            if (!m_file || m_written + 16 + m_snapLength > m_fileBytes)
+            {
+                Rotate ();
+            }
+            size_t end = begin;
+            while (end < buffer.size ())
+            {
+                uint32_t captured;
+                std::memcpy (&captured, &buffer[end + 8], sizeof (captured));
+                if (m_written + (end - begin) + 16 + captured > m_fileBytes && end > begin)
+                {
+                    break;
+                }
+                end += 16 + captured;
+            }
+            std::fwrite (&buffer[begin], 1, end - begin, m_file);
+            m_written += end - begin;
+            begin = end;
+        }
+    }
+
+    void Rotate ()
+    {
+        if (m_file)
+        {
+            std::fclose (m_file);
+        }
+        if (m_index >= m_files)
+        {
+            std::remove (Path (m_index - m_files).c_str ());
+        }
+        m_file = std::fopen (Path (m_index++).c_str (), "wb");
+        NS_ABORT_MSG_IF (!m_file, "Cannot open packet capture " << Path (m_index - 1));
+        struct
+        {
+            uint32_t magic = 0xa1b2c3d4;
+            uint16_t major = 2;
+            uint16_t minor = 4;
+            int32_t zone = 0;
+            uint32_t sigfigs = 0;
+            uint32_t snapLength;
+            uint32_t linkType = 9;  // DLT_PPP, as the point-to-point helper writes
+        } header;
+        header.snapLength = m_snapLength;
+        std::fwrite (&header, 1, 24, m_file);
+        m_written = 24;
+    }
+
+    std::string Path (uint32_t index) const { return m_base + "-" + std::to_string (index) + ".pcap"; }
+
+    std::string m_base;
+    uint32_t m_snapLength;
+    uint64_t m_fileBytes;
+    uint32_t m_files;
+    std::vector<uint8_t> m_buffer;
+
+    // shared with the writer thread
+    std::mutex m_mutex;
+    std::condition_variable m_ready;
+    std::condition_variable m_drained;
+    std::deque<std::vector<uint8_t>> m_queue;
+    bool m_closing = false;
+
+    // writer thread only
+    std::FILE* m_file = nullptr;
+    uint64_t m_written = 0;
+    uint32_t m_index = 0;
+
+    std::thread m_thread;   // last, so that it starts after everything above exists
+};
+
+// Device of node from towards node to, null if they share no point-to-point link.
+inline Ptr<NetDevice> FindLinkDevice (uint32_t from, uint32_t to)
+{
+    Ptr<Node> node = NodeList::GetNode (from);
+    for (uint32_t d = 0; d < node->GetNDevices (); ++d)
+    {
+        Ptr<PointToPointNetDevice> dev = DynamicCast<PointToPointNetDevice> (node->GetDevice (d));
+        if (!dev)
+        {
+            continue;
+        }
+        Ptr<Channel> channel = dev->GetChannel ();
+        for (size_t i = 0; i < channel->GetNDevices (); ++i)
+        {
+            if (channel->GetDevice (i) != dev && channel->GetDevice (i)->GetNode ()->GetId () == to)
+            {
+                return dev;
+            }
+        }
+    }
+    return nullptr;
+}
+
+// Capture of selected links instead of EnablePcapAll: only what the chosen devices
+// transmit, optionally only some ports, truncated, sampled, limited to a time window
+// or to the time around a drop-rate spike. Finish() must be called before the
+// process exits, since sweep workers leave without running destructors.
+class PacketCapture
+{
+public:
+    // base: file name prefix of this run; each link adds -<link>-<n>.pcap.
+    PacketCapture (const PacketCaptureOptions& options, const std::string& base)
+        : m_options (options),
+          m_base (base)
+    {
+        std::istringstream ports (options.ports);
+        std::string port;
+        while (std::getline (ports, port, ','))
+        {
+            if (!port.empty ())
+            {
+                m_ports.push_back (uint16_t (std::stoul (port)));
+            }
+        }
+        m_capturing = options.triggerDropRate <= 0;
+        if (!m_capturing)
+        {
+            Simulator::Schedule (options.triggerInterval, &PacketCapture::CheckTrigger, this);
+        }
+    }
+
+    ~PacketCapture () { Finish (); }
+
+    // Adds every link of the options; aliases resolve names such as "bottleneck".
+    void Install (const std::map<std::string, Ptr<NetDevice>>& aliases)
+    {
+        std::istringstream links (m_options.links);
+        std::string name;
+        while (std::getline (links, name, ','))
+        {
+            if (name.empty ())
+            {
+                continue;
+            }
+            auto alias = aliases.find (name);
+            Ptr<NetDevice> device;
+            if (alias != aliases.end ())
+            {
+                device = alias->second;
+            }
+            else
+            {
+                size_t dash = name.find ('-');
+                NS_ABORT_MSG_IF (dash == std::string::npos, "Unknown capture link: " << name);
+                uint32_t from = std::stoul (name.substr (0, dash));
+                uint32_t to = std::stoul (name.substr (dash + 1));
+                NS_ABORT_MSG_IF (std::max (from, to) >= NodeList::GetNNodes (), "No such node in capture link " << name);
+                device = FindLinkDevice (from, to);
+            }
+            NS_ABORT_MSG_IF (!device, "No point-to-point link " << name);
+            Add (device, name);
+        }
+    }
+
+    // Captures what device transmits onto its link.
+    void Add (Ptr<NetDevice> device, const std::string& name)
+    {
+        auto link = std::make_unique<Link> ();
+        link->name = name;
+        link->writer = std::make_unique<PcapRotatingWriter> (m_base + "-" + name, m_options.snapLength,
+                                                             m_options.fileBytes, m_options.files);
+        size_t index = m_links.size ();
+        device->TraceConnectWithoutContext ("PhyTxBegin", MakeBoundCallback (&PacketCapture::Tx, this, index));
+        device->TraceConnectWithoutContext ("MacTxDrop", MakeBoundCallback (&PacketCapture::Dropped, this, index));
+        Ptr<TrafficControlLayer> tc = device->GetNode ()->GetObject<TrafficControlLayer> ();
+        Ptr<QueueDisc> qdisc = tc ? tc->GetRootQueueDiscOnDevice (device) : nullptr;
+        if (qdisc)
+        {
+            qdisc->TraceConnectWithoutContext ("Drop", MakeBoundCallback (&PacketCapture::QueueDiscDropped, this, index));
+        }
+        m_links.push_back (std::move (link));
+    }
+
+    void Finish ()
+    {
+        for (auto& link : m_links)
+        {
+            link->writer->Close ();
+        }
+    }
+
+private:
+    struct Record
+    {
+        Time time;
+        uint32_t original;
+        std::vector<uint8_t> data;
+    };
+
+    struct Link
+    {
+        std::string name;
+        std::unique_ptr<PcapRotatingWriter> writer;
+        uint64_t matched = 0;
+        uint64_t tx = 0;
+        uint64_t drops = 0;
+        uint64_t lastTx = 0;
+        uint64_t lastDrops = 0;
+        std::deque<Record> preTrigger;
+    };
+
+    bool Matches (Ptr<const Packet> packet) const
+    {
+        if (m_ports.empty ())
+        {
+            return true;
+        }
+        Ptr<Packet> copy = packet->Copy ();
+        PppHeader ppp;
+        Ipv4Header ip;
+        copy->RemoveHeader (ppp);
+        if (ppp.GetProtocol () != 0x0021)
+        {
+            return false;
+        }
+        copy->RemoveHeader (ip);
+        uint16_t src = 0;
+        uint16_t dst = 0;
+        if (ip.GetProtocol () == TcpL4Protocol::PROT_NUMBER)
+        {
+            TcpHeader tcp;
+            copy->PeekHeader (tcp);
+            src = tcp.GetSourcePort ();
+            dst = tcp.GetDestinationPort ();
+        }
+        else if (ip.GetProtocol () == UdpL4Protocol::PROT_NUMBER)
+        {
+            UdpHeader udp;
+            copy->PeekHeader (udp);
+            src = udp.GetSourcePort ();
+            dst = udp.GetDestinationPort ();
+        }
+        for (uint16_t port : m_ports)
+        {
+            if (port == src || port == dst)
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    static void Tx (PacketCapture* self, size_t index, Ptr<const Packet> packet)
+    {
+        Link& link = *self->m_links[index];
+        link.tx++;
+        Time now = Simulator::Now ();
+        const PacketCaptureOptions& o = self->m_options;
+        if (now < o.windowStart || (o.windowStop > Time (0) && now >= o.windowStop) || !self->Matches (packet) ||
+            link.matched++ % o.sampleEvery != 0)
+        {
+            return;
+        }
+        Record r {now, packet->GetSize (), std::vector<uint8_t> (std::min (packet->GetSize (), o.snapLength))};
+        packet->CopyData (r.data.data (), r.data.size ());
+        if (self->m_capturing)
+        {
+            link.writer->Write (r.time, r.data.data (), r.data.size (), r.original);
+            return;
+        }
+        link.preTrigger.push_back (std::move (r));
+        if (link.preTrigger.size () > o.preTriggerPackets)
+        {
+            link.preTrigger.pop_front ();
+        }
+    }
+
+    static void Dropped (PacketCapture* self, size_t index, Ptr<const Packet>) { self->m_links[index]->drops++; }
+
+    static void QueueDiscDropped (PacketCapture* self, size_t index, Ptr<const QueueDiscItem>)
+    {
+        self->m_links[index]->drops++;
+    }
+
+    void CheckTrigger ()
+    {
+        Time now = Simulator::Now ();
+        for (auto& link : m_links)
+        {
+            uint64_t drops = link->drops - link->lastDrops;
+            uint64_t offered = drops + link->tx - link->lastTx;
+            link->lastDrops = link->drops;
+            link->lastTx = link->tx;
+            if (drops > 0 && drops >= m_options.triggerDropRate * offered)
+            {
+                if (!m_capturing)
+                {
+                    std::clog << "# capture triggered at " << now.GetSeconds () << "s on " << link->name
+                              << " (drop rate " << double (drops) / offered << ")" << std::endl;
+                }
+                m_capturing = true;
+                m_until = now + m_options.triggerHold;
+            }
+        }
+        if (m_capturing && now >= m_until)
+        {
+            m_capturing = false;
+        }
+        for (auto& link : m_links)
+        {
+            // Context before the spike, then everything until the hold time ends.
+            while (m_capturing && !link->preTrigger.empty ())
+            {
+                const Record& r = link->preTrigger.front ();
+                link->writer->Write (r.time, r.data.data (), r.data.size (), r.original);
+                link->preTrigger.pop_front ();
+            }
+        }
+        Simulator::Schedule (m_options.triggerInterval, &PacketCapture::CheckTrigger, this);
+    }
+
+    PacketCaptureOptions m_options;
+    std::string m_base;
+    std::vector<uint16_t> m_ports;
+    std::vector<std::unique_ptr<Link>> m_links;
+    bool m_capturing = true;
+    Time m_until;
+};
+
+} // namespace ns3
+
+#endif // PACKET_CAPTURE_H
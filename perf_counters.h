@@ -0,0 +1,349 @@
+#ifndef PERF_COUNTERS_H
+#define PERF_COUNTERS_H
+
+#include "csv_log.h"
+
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/point-to-point-module.h"
+#include "ns3/flow-monitor-module.h"
+
+#include <chrono>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace ns3 {
+
+// Pass-through scheduler that tracks how many events are pending. It wraps the
+// scheduler named by its Inner attribute, so the event order is unchanged.
+class CountingScheduler : public Scheduler
+{
+public:
+    static TypeId GetTypeId ()
+    {
+        static TypeId tid = TypeId ("ns3::CountingScheduler")
+                                .SetParent<Scheduler> ()
+                                .SetGroupName ("Core")
+                                .AddConstructor<CountingScheduler> ()
+                                .AddAttribute ("Inner", "Scheduler that holds the events",
+                                               TypeIdValue (MapScheduler::GetTypeId ()),
+                                               MakeTypeIdAccessor (&CountingScheduler::m_innerType),
+                                               MakeTypeIdChecker ());
+        return tid;
+    }
+
+    CountingScheduler ()
+    {
+        Pending () = 0;
+        Peak () = 0;
+    }
+
+    void Insert (const Event& ev) override
+    {
+        Inner ()->Insert (ev);
+        Peak () = std::max (Peak (), ++Pending ());
+    }
+    bool IsEmpty () const override { return Inner ()->IsEmpty (); }
+    Event PeekNext () const override { return Inner ()->PeekNext (); }
+    Event RemoveNext () override
+    {
+        --Pending ();
+        return Inner ()->RemoveNext ();
+    }
+    void Remove (const Event& ev) override
+    {
+        --Pending ();
+        Inner ()->Remove (ev);
+    }
+
+    // One simulator exists per process, so the counters are process-wide.
+    static uint64_t& Pending ()
+    {
+        static uint64_t pending = 0;
+        return pending;
+    }
+    static uint64_t& Peak ()
+    {
+        static uint64_t peak = 0;
+        return peak;
+    }
+
+private:
+    Ptr<Scheduler> Inner () const
+    {
+        if (!m_inner)
+        {
+            ObjectFactory factory;
+            factory.SetTypeId (m_innerType);
+            m_inner = factory.Create<Scheduler> ();
+        }
+        return m_inner;
+    }
+
+    TypeId m_innerType;
+    mutable Ptr<Scheduler> m_inner;
+};
+
+NS_OBJECT_ENSURE_REGISTERED (CountingScheduler);
+
+// Makes every simulator of this process use the named scheduler: Map, Heap, List,
+// Calendar or PriorityQueue (or a full TypeId name). Event order, and with it every
+// result, is the same under all of them; only the cost differs.
+inline void SelectScheduler (const std::string& name)
+{
+    std::string full = name.find ("::") == std::string::npos ? "ns3::" + name + "Scheduler" : name;
+    TypeId tid;
+    NS_ABORT_MSG_IF (!TypeId::LookupByNameFailSafe (full, &tid) || !tid.IsChildOf (Scheduler::GetTypeId ()),
+                     "Unknown scheduler: " << name);
+    Config::SetDefault ("ns3::CountingScheduler::Inner", TypeIdValue (tid));
+    TypeIdValue current;
+    GlobalValue::GetValueByName ("SchedulerType", current);
+    if (current.Get () != CountingScheduler::GetTypeId ())
+    {
+        GlobalValue::Bind ("SchedulerType", TypeIdValue (tid));
+    }
+}
+
+struct PerfRecord
+{
+    double setupSec = 0;
+    double routingSec = 0;
+    double runSec = 0;
+    uint64_t events = 0;
+    uint64_t maxPendingEvents = 0;
+    uint64_t peakRssKb = 0;
+    uint64_t linkPackets = 0;           // packets put on the wire, summed over links
+    uint64_t measuredPackets = 0;       // packets seen by the flow probes or FlowMonitor
+    std::string busiestLink;
+    uint64_t busiestLinkPackets = 0;
+    std::vector<std::pair<std::string, uint64_t>> links;   // packets per link, by channel id
+};
+
+// Cost of one run: wall time per phase, events executed and queued, peak memory and
+// packets handled per point-to-point link. Begin() starts the setup phase; all
+// timers use the wall clock of this process.
+class PerfCounters
+{
+public:
+    void Begin ()
+    {
+        m_begin = Clock::now ();
+        m_routingSec = 0;
+        m_setupDone = false;
+        ResetPeaks ();
+    }
+
+    void BeginRouting () { m_routingStart = Clock::now (); }
+    void EndRouting () { m_routingSec += Elapsed (m_routingStart); }
+
+    // Counts transmissions on every point-to-point device built so far.
+    void CountLinks ()
+    {
+        for (uint32_t n = 0; n < NodeList::GetNNodes (); ++n)
+        {
+            Ptr<Node> node = NodeList::GetNode (n);
+            for (uint32_t d = 0; d < node->GetNDevices (); ++d)
+            {
+                Ptr<PointToPointNetDevice> dev = DynamicCast<PointToPointNetDevice> (node->GetDevice (d));
+                if (!dev)
+                {
+                    continue;
+                }
+                Link& link = m_links[dev->GetChannel ()->GetId ()];
+                if (link.name.empty ())
+                {
+                    Ptr<Channel> channel = dev->GetChannel ();
+                    link.name = std::to_string (channel->GetDevice (0)->GetNode ()->GetId ()) + "-" +
+                                std::to_string (channel->GetDevice (1)->GetNode ()->GetId ());
+                }
+                dev->TraceConnectWithoutContext ("PhyTxEnd", MakeBoundCallback (&PerfCounters::Tx, &link.packets));
+            }
+        }
+    }
+
+    // Clears everything but the setup timings, e.g. when a forked warm-up snapshot
+    // starts its own measured part.
+    void ResetPeaks ()
+    {
+        CountingScheduler::Peak () = CountingScheduler::Pending ();
+        for (auto& link : m_links)
+        {
+            link.second.packets = 0;
+        }
+        // Resets VmHWM to the current RSS (Linux 4.0+); without it the peak is since fork.
+        int fd = open ("/proc/self/clear_refs", O_WRONLY);
+        if (fd >= 0)
+        {
+            ssize_t ignored = write (fd, "5", 1);
+            (void) ignored;
+            close (fd);
+        }
+    }
+
+    // Timed Simulator::Run. Setup ends at the first call, so the children of a warm-up
+    // snapshot report the setup of the network they inherited.
+    void Run ()
+    {
+        if (!m_setupDone)
+        {
+            m_setupSec = Elapsed (m_begin) - m_routingSec;
+            m_setupDone = true;
+        }
+        uint64_t before = Simulator::GetEventCount ();
+        auto start = Clock::now ();
+        Simulator::Run ();
+        m_runSec = Elapsed (start);
+        m_events = Simulator::GetEventCount () - before;
+    }
+
+    double RunSeconds () const { return m_runSec; }
+
+    // measuredPackets: packet events seen by whatever measured the flows.
+    PerfRecord Finish (uint64_t measuredPackets) const
+    {
+        PerfRecord r;
+        r.setupSec = m_setupSec;
+        r.routingSec = m_routingSec;
+        r.runSec = m_runSec;
+        r.events = m_events;
+        r.maxPendingEvents = CountingScheduler::Peak ();
+        r.peakRssKb = PeakRssKb ();
+        for (const auto& link : m_links)
+        {
+            r.links.emplace_back (link.second.name, link.second.packets);
+            r.linkPackets += link.second.packets;
+            if (link.second.packets > r.busiestLinkPackets)
+            {
+                r.busiestLinkPackets = link.second.packets;
+                r.busiestLink = link.second.name;
+            }
+        }
+        r.measuredPackets = measuredPackets;
+        return r;
+    }
+
+    static uint64_t FlowMonitorPackets (Ptr<FlowMonitor> monitor)
+    {
+        uint64_t packets = 0;
+        for (const auto& probe : monitor->GetAllProbes ())
+        {
+            for (const auto& flow : probe->GetStats ())
+            {
+                packets += flow.second.packets;
+            }
+        }
+        return packets;
+    }
+
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    struct Link
+    {
+        std::string name;   // node ids of both ends
+        uint64_t packets = 0;
+    };
+
+    static double Elapsed (Clock::time_point since)
+    {
+        return std::chrono::duration<double> (Clock::now () - since).count ();
+    }
+
+    static void Tx (uint64_t* packets, Ptr<const Packet>) { ++*packets; }
+
+    static uint64_t PeakRssKb ()
+    {
+        std::ifstream status ("/proc/self/status");
+        std::string line;
+        while (std::getline (status, line))
+        {
+            if (line.compare (0, 6, "VmHWM:") == 0)
+            {
+                return std::stoull (line.substr (6));
+            }
+        }
+        return 0;
+    }
+
+    Clock::time_point m_begin;
+    Clock::time_point m_routingStart;
+    bool m_setupDone = false;
+    double m_setupSec = 0;
+    double m_routingSec = 0;
+    double m_runSec = 0;
+    uint64_t m_events = 0;
+    std::map<uint32_t, Link> m_links;
+};
+
+// CSV log of performance records, one line per run. An optional second log gets
+// the packets of every link of each run.
+class PerfLog
+{
+public:
+    bool IsOpen () const { return m_log.IsOpen (); }
+
+    // Needs Open first, since links are only counted while the log is open.
+    void OpenLinks (const std::string& path)
+    {
+        NS_ABORT_MSG_IF (!IsOpen (), "The per-link performance log needs the performance log");
+        m_links.Open (path, "Scenario,Variant,CBR(Mbps),Run,Link,Packets\n", "per-link performance log");
+    }
+
+    // Also makes every simulator of this process count its pending events.
+    void Open (const std::string& path)
+    {
+        m_log.Open (path,
+                    "Scenario,Variant,CBR(Mbps),Run,SetupSec,RoutingSec,RunSec,Events,EventsPerSec,"
+                    "MaxPendingEvents,PeakRssKB,LinkPackets,MeasuredPackets,BusiestLink,BusiestLinkPackets\n",
+                    "performance log");
+        // Keep whatever scheduler was selected as the one the counter wraps.
+        TypeIdValue current;
+        GlobalValue::GetValueByName ("SchedulerType", current);
+        if (current.Get () != CountingScheduler::GetTypeId ())
+        {
+            Config::SetDefault ("ns3::CountingScheduler::Inner", current);
+        }
+        GlobalValue::Bind ("SchedulerType", TypeIdValue (CountingScheduler::GetTypeId ()));
+    }
+
+    void Append (const std::string& scenario, const std::string& variant, double cbrRateMbps, const PerfRecord& r)
+    {
+        if (!IsOpen ())
+        {
+            return;
+        }
+        std::ostringstream line;
+        line << scenario << "," << variant << "," << cbrRateMbps << "," << RngSeedManager::GetRun () << ","
+             << r.setupSec << "," << r.routingSec << "," << r.runSec << "," << r.events << ","
+             << (r.runSec > 0 ? r.events / r.runSec : 0) << "," << r.maxPendingEvents << "," << r.peakRssKb << ","
+             << r.linkPackets << "," << r.measuredPackets << "," << r.busiestLink << ","
+             << r.busiestLinkPackets << "\n";
+        m_log.Write (line.str ());
+
+        if (m_links.IsOpen ())
+        {
+            std::ostringstream links;
+            for (const auto& link : r.links)
+            {
+                links << scenario << "," << variant << "," << cbrRateMbps << "," << RngSeedManager::GetRun () << ","
+                      << link.first << "," << link.second << "\n";
+            }
+            m_links.Write (links.str ());
+        }
+    }
+
+private:
+    CsvLog m_log;
+    CsvLog m_links;
+};
+
+} // namespace ns3
+
+#endif // PERF_COUNTERS_H
@@ -0,0 +1,227 @@
+#ifndef REGRESSION_H
+#define REGRESSION_H
+
+#include "results_store.h"
+
+#include "ns3/core-module.h"
+
+#include <cmath>
+#include <ctime>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace ns3 {
+
+struct RegressionOptions
+{
+    std::string golden;                 // result rows to compare with; regression mode is off when empty
+    std::string baseline;               // performance log to compare with; timings are not checked when empty
+    bool update = false;                // rewrite golden and baseline from this run instead of comparing
+    std::string summary;                // the comparison table is appended here (default: stderr)
+    std::string codeVersion;            // first column of the table, to tell runs apart over time
+    double throughputTolerance = 0.05;  // relative
+    double rttTolerance = 0.05;         // relative
+    double dropTolerance = 0.01;        // absolute
+    double slowdown = 1.5;              // wall time, 1 / event rate or peak RSS over the baseline that fails
+    Time length = Seconds (10);         // measured time of each short run
+};
+
+// One run of a performance log (see PerfLog).
+struct PerfRow
+{
+    double wallSec = 0;                 // setup, routing and run
+    double eventsPerSec = 0;
+    double peakRssKb = 0;
+};
+
+inline std::string RegressionKey (const std::string& scenario, const std::string& variant, double cbrRateMbps)
+{
+    std::ostringstream key;
+    key << scenario << "," << variant << "," << cbrRateMbps;
+    return key.str ();
+}
+
+inline std::vector<ResultRecord> ReadResultRows (const std::string& path)
+{
+    std::ifstream in (path);
+    NS_ABORT_MSG_IF (!in, "Cannot open golden results " << path);
+    std::vector<ResultRecord> rows;
+    std::string line;
+    ResultRecord r;
+    while (std::getline (in, line))
+    {
+        if (ParseCsvRow (line, r))
+        {
+            rows.push_back (r);
+        }
+    }
+    return rows;
+}
+
+// Runs of a performance log by configuration; a repeated configuration keeps its last run.
+inline std::map<std::string, PerfRow> ReadPerfLog (const std::string& path)
+{
+    std::ifstream in (path);
+    NS_ABORT_MSG_IF (!in, "Cannot open performance log " << path);
+    std::map<std::string, PerfRow> rows;
+    std::string line;
+    std::getline (in, line);
+    while (std::getline (in, line))
+    {
+        std::vector<std::string> f;
+        std::istringstream fields (line);
+        for (std::string field; std::getline (fields, field, ',');)
+        {
+            f.push_back (field);
+        }
+        if (f.size () < 11)
+        {
+            continue;
+        }
+        PerfRow p;
+        p.wallSec = std::stod (f[4]) + std::stod (f[5]) + std::stod (f[6]);
+        p.eventsPerSec = std::stod (f[8]);
+        p.peakRssKb = std::stod (f[10]);
+        rows[RegressionKey (f[0], f[1], std::stod (f[2]))] = p;
+    }
+    return rows;
+}
+
+// Compares the rows and performance log of a short fixed-seed sweep with the golden
+// results and the performance baseline, or replaces both with them in update mode.
+// Every compared value becomes a line of the summary table. Result metrics fail
+// beyond their tolerance in either direction, performance only when it got worse.
+class RegressionCheck
+{
+public:
+    explicit RegressionCheck (const RegressionOptions& options)
+        : m_options (options)
+    {
+    }
+
+    // Returns how many values regressed.
+    size_t Finish (const std::vector<ResultRecord>& rows, const std::string& perfLog)
+    {
+        if (m_options.update)
+        {
+            Update (rows, perfLog);
+            return 0;
+        }
+        if (m_options.summary.empty ())
+        {
+            return Compare (rows, perfLog, std::clog, true);
+        }
+        bool fresh = !std::ifstream (m_options.summary).good ();
+        std::ofstream out (m_options.summary, std::ios::app);
+        NS_ABORT_MSG_IF (!out, "Cannot append to " << m_options.summary);
+        return Compare (rows, perfLog, out, fresh);
+    }
+
+private:
+    size_t Compare (const std::vector<ResultRecord>& rows, const std::string& perfLog, std::ostream& os, bool header)
+    {
+        char date[32];
+        std::time_t now = std::time (nullptr);
+        std::strftime (date, sizeof (date), "%Y-%m-%dT%H:%M:%S", std::localtime (&now));
+        m_prefix = std::string (date) + "," + m_options.codeVersion + ",";
+        m_os = &os;
+        m_failures = 0;
+        if (header)
+        {
+            os << "Date,CodeVersion,Scenario,Variant,CBR(Mbps),Row,Metric,Baseline,Measured,Change,Status\n";
+        }
+
+        // CSV rows carry no flow label, so the rows of one configuration are matched in
+        // the order it reported them.
+        std::map<std::string, std::vector<ResultRecord>> measured;
+        for (const auto& r : rows)
+        {
+            measured[RegressionKey (r.key.scenario, r.key.variant, r.key.cbrRateMbps)].push_back (r);
+        }
+        std::map<std::string, size_t> seen;
+        for (const auto& golden : ReadResultRows (m_options.golden))
+        {
+            std::string key = RegressionKey (golden.key.scenario, golden.key.variant, golden.key.cbrRateMbps);
+            size_t n = seen[key]++;
+            std::string flow = std::to_string (n);
+            auto it = measured.find (key);
+            if (it == measured.end () || it->second.size () <= n)
+            {
+                Line (key, flow, "Row", 0, 0, true, "MISSING");
+                continue;
+            }
+            const ResultRecord& r = it->second[n];
+            Relative (key, flow, "Throughput(Mbps)", golden.throughputMbps, r.throughputMbps,
+                      m_options.throughputTolerance);
+            Relative (key, flow, "AvgRtt(ms)", golden.avgRttMs, r.avgRttMs, m_options.rttTolerance);
+            Line (key, flow, "DropRate", golden.dropRate, r.dropRate,
+                  std::fabs (r.dropRate - golden.dropRate) > m_options.dropTolerance);
+        }
+
+        if (!m_options.baseline.empty ())
+        {
+            std::map<std::string, PerfRow> current = ReadPerfLog (perfLog);
+            for (const auto& base : ReadPerfLog (m_options.baseline))
+            {
+                auto it = current.find (base.first);
+                if (it == current.end ())
+                {
+                    Line (base.first, "", "Perf", 0, 0, true, "MISSING");
+                    continue;
+                }
+                const PerfRow& b = base.second;
+                const PerfRow& p = it->second;
+                Line (base.first, "", "WallSec", b.wallSec, p.wallSec, p.wallSec > m_options.slowdown * b.wallSec);
+                Line (base.first, "", "EventsPerSec", b.eventsPerSec, p.eventsPerSec,
+                      p.eventsPerSec * m_options.slowdown < b.eventsPerSec);
+                Line (base.first, "", "PeakRssKB", b.peakRssKb, p.peakRssKb, p.peakRssKb > m_options.slowdown * b.peakRssKb);
+            }
+        }
+        return m_failures;
+    }
+
+    void Update (const std::vector<ResultRecord>& rows, const std::string& perfLog) const
+    {
+        std::ofstream golden (m_options.golden);
+        NS_ABORT_MSG_IF (!golden, "Cannot write golden results " << m_options.golden);
+        PrintCsvHeader (golden);
+        for (const auto& r : rows)
+        {
+            PrintCsvRow (golden, r);
+        }
+        if (!m_options.baseline.empty ())
+        {
+            std::ifstream in (perfLog);
+            std::ofstream out (m_options.baseline);
+            NS_ABORT_MSG_IF (!in || !out, "Cannot copy " << perfLog << " to " << m_options.baseline);
+            out << in.rdbuf ();
+        }
+    }
+
+    void Relative (const std::string& key, const std::string& flow, const std::string& metric, double baseline,
+                   double value, double tolerance)
+    {
+        Line (key, flow, metric, baseline, value, std::fabs (value - baseline) > tolerance * std::fabs (baseline));
+    }
+
+    void Line (const std::string& key, const std::string& flow, const std::string& metric, double baseline,
+               double value, bool failed, const std::string& status = "")
+    {
+        double change = baseline != 0 ? (value - baseline) / std::fabs (baseline) : 0;
+        *m_os << m_prefix << key << "," << flow << "," << metric << "," << baseline << "," << value << "," << change
+              << "," << (!status.empty () ? status : failed ? "FAIL" : "ok") << "\n";
+        m_failures += failed ? 1 : 0;
+    }
+
+    RegressionOptions m_options;
+    std::ostream* m_os = nullptr;
+    std::string m_prefix;
+    size_t m_failures = 0;
+};
+
+} // namespace ns3
+
+#endif // REGRESSION_H
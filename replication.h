@@ -0,0 +1,202 @@
+#ifndef REPLICATION_H
+#define REPLICATION_H
+
+#include "convergence_monitor.h"
+#include "results_store.h"
+#include "sweep_runner.h"
+
+#include "ns3/core-module.h"
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace ns3 {
+
+struct ReplicationOptions
+{
+    double precision = 0.05;    // target 95% CI half-width relative to the mean
+    uint32_t minRuns = 3;
+    uint32_t maxRuns = 50;
+    uint32_t firstRun = 1;      // RngRun of the first replicate; replicate i uses firstRun + i
+};
+
+// One configuration to replicate. run() simulates it once with the RNG run already
+// set and prints its result row for the measured flow.
+struct ReplicatedConfig
+{
+    std::string name;
+    double cost;
+    std::function<void ()> run;
+    ResultKey key;              // key of the first replicate, run is filled in per replicate
+};
+
+struct ReplicationSummary
+{
+    std::vector<ResultRecord> replicates;
+    std::vector<double> mean;       // per kReplicatedMetrics entry
+    std::vector<double> halfWidth;  // 95% CI half-width, infinite below two replicates
+    bool converged = false;
+};
+
+// Metrics whose confidence intervals decide when a configuration has enough
+// replicates, each with an absolute half-width that is always precise enough so
+// that means near zero (drop rates) do not demand unbounded replicates.
+struct ReplicatedMetric
+{
+    const char* name;
+    double ResultRecord::*field;
+    double absTolerance;
+};
+
+const std::vector<ReplicatedMetric> kReplicatedMetrics = {
+    {"Throughput(Mbps)", &ResultRecord::throughputMbps, 0.01},
+    {"AvgRTT(ms)", &ResultRecord::avgRttMs, 0.1},
+    {"DropRate", &ResultRecord::dropRate, 1e-4},
+};
+
+inline void Summarize (ReplicationSummary& s, double precision)
+{
+    size_t n = s.replicates.size ();
+    s.mean.assign (kReplicatedMetrics.size (), 0);
+    s.halfWidth.assign (kReplicatedMetrics.size (), INFINITY);
+    s.converged = n >= 2;
+    for (size_t m = 0; m < kReplicatedMetrics.size (); ++m)
+    {
+        double sum = 0;
+        for (const auto& r : s.replicates)
+        {
+            sum += r.*kReplicatedMetrics[m].field;
+        }
+        s.mean[m] = n > 0 ? sum / n : 0;
+        if (n < 2)
+        {
+            continue;
+        }
+        double var = 0;
+        for (const auto& r : s.replicates)
+        {
+            double d = r.*kReplicatedMetrics[m].field - s.mean[m];
+            var += d * d;
+        }
+        s.halfWidth[m] = StudentT975 (n - 1) * std::sqrt (var / (n - 1) / n);
+        s.converged = s.converged && s.halfWidth[m] <= precision * std::fabs (s.mean[m]) +
+                                                          kReplicatedMetrics[m].absTolerance;
+    }
+}
+
+// Replicates every configuration with independent RngRun values until the 95%
+// confidence intervals of its metrics are within the target or maxRuns is reached.
+// Rounds run through RunSweep: the first gives every configuration minRuns
+// replicates, later ones add as many as the current CI suggests are missing
+// (half-widths shrink with the square root of the count). Replicate rows are
+// printed as they come in; store is consulted to resume stored replicates.
+inline std::vector<ReplicationSummary> RunReplications (const std::vector<ReplicatedConfig>& configs,
+                                                        const ReplicationOptions& options,
+                                                        const SweepOptions& sweep, ResultsStore& store,
+                                                        size_t& failures)
+{
+    std::vector<ReplicationSummary> summaries (configs.size ());
+    std::vector<uint32_t> started (configs.size (), 0);
+    uint32_t minRuns = std::max (2u, options.minRuns);
+    for (auto& s : summaries)
+    {
+        Summarize (s, options.precision);
+    }
+
+    while (true)
+    {
+        std::vector<SweepJob> jobs;
+        std::vector<size_t> owner;
+        for (size_t c = 0; c < configs.size (); ++c)
+        {
+            ReplicationSummary& s = summaries[c];
+            if (s.converged || started[c] >= options.maxRuns)
+            {
+                continue;
+            }
+            uint32_t want = minRuns;
+            if (started[c] > 0)
+            {
+                // Replicates the worst metric needs, from n * (halfWidth / target)^2.
+                double n = s.replicates.size ();
+                double needed = 0;
+                for (size_t m = 0; m < kReplicatedMetrics.size (); ++m)
+                {
+                    double target = options.precision * std::fabs (s.mean[m]) + kReplicatedMetrics[m].absTolerance;
+                    double ratio = s.halfWidth[m] / target;
+                    needed = std::max (needed, std::isfinite (ratio) ? n * ratio * ratio : 2 * n);
+                }
+                want = uint32_t (std::max ({1.0, std::ceil (needed) - n, std::ceil (n / 4)}));
+            }
+            want = std::min (want, options.maxRuns - started[c]);
+            for (uint32_t i = 0; i < want; ++i)
+            {
+                uint32_t run = options.firstRun + started[c]++;
+                ResultKey key = configs[c].key;
+                key.run = run;
+                auto body = configs[c].run;
+                SweepJob job {configs[c].name + "/run" + std::to_string (run), configs[c].cost, [body, run] () {
+                                  RngSeedManager::SetRun (run);
+                                  body ();
+                              }};
+                ResumeFromStore (job, store, key);
+                jobs.push_back (job);
+                owner.push_back (c);
+            }
+        }
+        if (jobs.empty ())
+        {
+            break;
+        }
+
+        failures += RunSweep (jobs, sweep, [&] (size_t i, const SweepOutcome& outcome) {
+            std::cout << outcome.output << std::flush;
+            std::istringstream lines (outcome.output);
+            std::string line;
+            ResultRecord r;
+            while (std::getline (lines, line))
+            {
+                if (ParseCsvRow (line, r))
+                {
+                    summaries[owner[i]].replicates.push_back (r);
+                    break;
+                }
+            }
+        });
+        for (auto& s : summaries)
+        {
+            Summarize (s, options.precision);
+        }
+    }
+    return summaries;
+}
+
+inline void PrintReplicationSummary (std::ostream& os, const std::vector<ReplicatedConfig>& configs,
+                                     const std::vector<ReplicationSummary>& summaries)
+{
+    os << "Scenario,Variant,CBR(Mbps),Runs,Converged";
+    for (const auto& m : kReplicatedMetrics)
+    {
+        os << "," << m.name << "," << m.name << "CI95";
+    }
+    os << "\n";
+    for (size_t c = 0; c < configs.size (); ++c)
+    {
+        const ReplicationSummary& s = summaries[c];
+        os << configs[c].key.scenario << "," << configs[c].key.variant << "," << configs[c].key.cbrRateMbps << ","
+           << s.replicates.size () << "," << (s.converged ? 1 : 0);
+        for (size_t m = 0; m < kReplicatedMetrics.size (); ++m)
+        {
+            os << "," << s.mean[m] << "," << s.halfWidth[m];
+        }
+        os << "\n";
+    }
+}
+
+} // namespace ns3
+
+#endif // REPLICATION_H
@@ -0,0 +1,593 @@
+#ifndef RESULTS_STORE_H
+#define RESULTS_STORE_H
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifndef SIM_CODE_VERSION
+#define SIM_CODE_VERSION "dev"
+#endif
+
+// Identifies one simulated configuration; every result row it produces shares it.
+struct ResultKey
+{
+    std::string scenario;
+    std::string variant;
+    double cbrRateMbps = 0;
+    uint32_t seed = 1;
+    uint32_t run = 1;
+};
+
+struct ResultRecord
+{
+    ResultKey key;
+    std::string flow;           // measured flow within the configuration, e.g. its port
+    double throughputMbps = 0;
+    double avgRttMs = 0;
+    double dropRate = 0;
+    double stopTimeSec = 0;     // simulated time the run ended, earlier than planned once converged
+    double delayP50Ms = -1;     // one-way delay percentiles, -1 when not measured
+    double delayP90Ms = -1;
+    double delayP99Ms = -1;
+    double delayP999Ms = -1;
+    double jitterP99Ms = -1;
+    double rttP50Ms = -1;       // RTT samples of the sender's TCP socket
+    double rttP99Ms = -1;
+    double bottleneckDrops = -1;
+    double queueDrops = -1;     // whole bottleneck queue, all flows
+    double queueMarks = -1;
+    double queueMeanPackets = -1;
+    double sojournP50Ms = -1;
+    double sojournP99Ms = -1;
+    double jainIndex = -1;      // summary row of a fairness mix
+    double utilization = -1;
+    double reorderRate = -1;    // delivered packets sent before an already delivered one, per delivered packet
+    double uplinkImbalance = -1;    // fat tree: busiest over mean uplink bytes per switch
+    double hops = -1;           // bottleneck links the flow crosses; of the topology in a summary row
+    double baseRttMs = -1;      // propagation RTT of the flow's path
+};
+
+// Metric columns in CSV and store order.
+const std::vector<std::pair<const char*, double ResultRecord::*>> kResultMetrics = {
+    {"Throughput(Mbps)", &ResultRecord::throughputMbps},
+    {"AvgRTT(ms)", &ResultRecord::avgRttMs},
+    {"DropRate", &ResultRecord::dropRate},
+    {"StopTime(s)", &ResultRecord::stopTimeSec},
+    {"DelayP50(ms)", &ResultRecord::delayP50Ms},
+    {"DelayP90(ms)", &ResultRecord::delayP90Ms},
+    {"DelayP99(ms)", &ResultRecord::delayP99Ms},
+    {"DelayP99.9(ms)", &ResultRecord::delayP999Ms},
+    {"JitterP99(ms)", &ResultRecord::jitterP99Ms},
+    {"RttP50(ms)", &ResultRecord::rttP50Ms},
+    {"RttP99(ms)", &ResultRecord::rttP99Ms},
+    {"BottleneckDrops", &ResultRecord::bottleneckDrops},
+    {"QueueDrops", &ResultRecord::queueDrops},
+    {"QueueMarks", &ResultRecord::queueMarks},
+    {"QueueMean(pkts)", &ResultRecord::queueMeanPackets},
+    {"SojournP50(ms)", &ResultRecord::sojournP50Ms},
+    {"SojournP99(ms)", &ResultRecord::sojournP99Ms},
+    {"JainIndex", &ResultRecord::jainIndex},
+    {"Utilization", &ResultRecord::utilization},
+    {"ReorderRate", &ResultRecord::reorderRate},
+    {"UplinkImbalance", &ResultRecord::uplinkImbalance},
+    {"Hops", &ResultRecord::hops},
+    {"BaseRTT(ms)", &ResultRecord::baseRttMs},
+};
+
+inline void PrintCsvHeader (std::ostream& os)
+{
+    os << "Scenario,Variant,CBR(Mbps)";
+    for (const auto& m : kResultMetrics)
+    {
+        os << "," << m.first;
+    }
+    os << "\n";
+}
+
+inline void PrintCsvRow (std::ostream& os, const ResultRecord& r)
+{
+    os << r.key.scenario << "," << r.key.variant << "," << r.key.cbrRateMbps;
+    for (const auto& m : kResultMetrics)
+    {
+        os << "," << r.*m.second;
+    }
+    os << "\n";
+}
+
+// Parses a row written by PrintCsvRow; the flow and RNG key fields are not part of it.
+inline bool ParseCsvRow (const std::string& line, ResultRecord& r)
+{
+    std::vector<std::string> fields;
+    std::stringstream ss (line);
+    std::string field;
+    while (std::getline (ss, field, ','))
+    {
+        fields.push_back (field);
+    }
+    if (fields.size () != 3 + kResultMetrics.size ())
+    {
+        return false;
+    }
+    char* end = nullptr;
+    r.key.scenario = fields[0];
+    r.key.variant = fields[1];
+    r.key.cbrRateMbps = std::strtod (fields[2].c_str (), &end);
+    if (*end != '\0')
+    {
+        return false;
+    }
+    for (size_t i = 0; i < kResultMetrics.size (); ++i)
+    {
+        r.*kResultMetrics[i].second = std::strtod (fields[3 + i].c_str (), &end);
+        if (*end != '\0')
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Append-only file of fixed-size typed records, keyed by (scenario, variant, rate,
+// seed, run, code version). The index is rebuilt by one sequential scan on open;
+// a torn record at the tail (a worker killed mid-write) is cut off. Forked workers
+// share the O_APPEND descriptor and write each record with a single write(), so
+// concurrent appends never interleave. A configuration's rows are bracketed by
+// Begin and Complete marker records; only the rows of its last completed attempt
+// are indexed, so a job killed or timed out half way is simulated again.
+//
+// Layout: "SRES", u32 version, u32 metric count, per metric a u16 name length and
+// the name; then records (see RecordSize) ending in an FNV-1a checksum.
+class ResultsStore
+{
+public:
+    ~ResultsStore ()
+    {
+        if (m_fd >= 0)
+        {
+            close (m_fd);
+        }
+    }
+
+    bool IsOpen () const { return m_fd >= 0; }
+
+    void Open (const std::string& path, const std::string& codeVersion)
+    {
+        m_path = path;
+        m_codeVersion = codeVersion;
+        m_fd = open (path.c_str (), O_RDWR | O_CREAT | O_APPEND, 0644);
+        if (m_fd < 0)
+        {
+            Fail ("cannot open");
+        }
+
+        std::string header = Header ();
+        struct stat st;
+        if (fstat (m_fd, &st) != 0)
+        {
+            Fail ("cannot stat");
+        }
+        if (st.st_size == 0)
+        {
+            WriteAll (header.data (), header.size ());
+            CheckName (m_codeVersion);
+            return;
+        }
+
+        std::vector<char> existing (header.size ());
+        if (pread (m_fd, existing.data (), existing.size (), 0) != ssize_t (existing.size ()) ||
+            std::memcmp (existing.data (), header.data (), header.size ()) != 0)
+        {
+            Fail ("was written with different result columns, use a new file");
+        }
+
+        CheckName (m_codeVersion);
+        std::map<std::string, Index> completed;
+        off_t good = Scan (completed);
+        m_index = completed[m_codeVersion];
+        if (good != st.st_size)
+        {
+            std::clog << "# results store " << path << ": dropping " << st.st_size - good
+                      << " bytes of incomplete records" << std::endl;
+            if (ftruncate (m_fd, good) != 0)
+            {
+                Fail ("cannot truncate");
+            }
+        }
+    }
+
+    bool Contains (const ResultKey& key) const
+    {
+        return m_index.count (KeyString (key)) > 0;
+    }
+
+    void Append (const ResultRecord& r)
+    {
+        std::vector<char> buf = Encode (r);
+        WriteAll (buf.data (), buf.size ());
+    }
+
+    // Mark the start and the successful end of a job's rows for key.
+    void Begin (const ResultKey& key) { Mark (key, kBegin); }
+    void Complete (const ResultKey& key) { Mark (key, kComplete); }
+
+    // Records stored for a configuration by this code version, in append order.
+    std::vector<ResultRecord> Lookup (const ResultKey& key) const
+    {
+        std::vector<ResultRecord> out;
+        auto it = m_index.find (KeyString (key));
+        if (it == m_index.end ())
+        {
+            return out;
+        }
+        std::vector<char> buf (RecordSize ());
+        for (off_t off : it->second)
+        {
+            ResultRecord r;
+            std::string version;
+            Read (off, buf);
+            Decode (buf, r, version);
+            out.push_back (r);
+        }
+        return out;
+    }
+
+    // Calls f (record, codeVersion) for the rows of the last completed attempt of every
+    // configuration, any code version, in file order; like Open, it skips the rows of
+    // killed or superseded attempts and stops at the first damaged record.
+    template <typename F>
+    void ForEach (F f) const
+    {
+        std::map<std::string, Index> completed;
+        Scan (completed);
+        std::vector<off_t> offsets;
+        for (const auto& version : completed)
+        {
+            for (const auto& key : version.second)
+            {
+                offsets.insert (offsets.end (), key.second.begin (), key.second.end ());
+            }
+        }
+        std::sort (offsets.begin (), offsets.end ());
+        std::vector<char> buf (RecordSize ());
+        for (off_t off : offsets)
+        {
+            ResultRecord r;
+            std::string version;
+            Read (off, buf);
+            Decode (buf, r, version);
+            f (r, version);
+        }
+    }
+
+    void ExportCsv (const std::string& path) const
+    {
+        std::ofstream out (path);
+        out << "Scenario,Variant,CBR(Mbps),Flow,Seed,Run,CodeVersion";
+        for (const auto& m : kResultMetrics)
+        {
+            out << "," << m.first;
+        }
+        out << "\n";
+        ForEach ([&] (const ResultRecord& r, const std::string& version) {
+            out << r.key.scenario << "," << r.key.variant << "," << r.key.cbrRateMbps << "," << r.flow << ","
+                << r.key.seed << "," << r.key.run << "," << version;
+            for (const auto& m : kResultMetrics)
+            {
+                out << "," << r.*m.second;
+            }
+            out << "\n";
+        });
+    }
+
+    // One NumPy .npy file per column in dir, which numpy.load (mmap_mode="r") maps
+    // without copying; Analysis/results_store.py assembles them into a DataFrame.
+    void ExportColumns (const std::string& dir) const
+    {
+        mkdir (dir.c_str (), 0755);
+        std::vector<std::string> scenario, variant, flow, version;
+        std::vector<double> rate;
+        std::vector<uint32_t> seed, run;
+        std::vector<std::vector<double>> metrics (kResultMetrics.size ());
+        ForEach ([&] (const ResultRecord& r, const std::string& v) {
+            scenario.push_back (r.key.scenario);
+            variant.push_back (r.key.variant);
+            flow.push_back (r.flow);
+            version.push_back (v);
+            rate.push_back (r.key.cbrRateMbps);
+            seed.push_back (r.key.seed);
+            run.push_back (r.key.run);
+            for (size_t i = 0; i < kResultMetrics.size (); ++i)
+            {
+                metrics[i].push_back (r.*kResultMetrics[i].second);
+            }
+        });
+
+        std::ofstream columns (dir + "/columns.txt");
+        auto strings = [&] (const std::string& name, const std::vector<std::string>& v) {
+            std::vector<char> data (v.size () * kNameLen, 0);
+            for (size_t i = 0; i < v.size (); ++i)
+            {
+                std::memcpy (&data[i * kNameLen], v[i].data (), std::min (v[i].size (), kNameLen));
+            }
+            WriteNpy (dir, name, "|S" + std::to_string (kNameLen), v.size (), data.data (), data.size ());
+            columns << name << "\n";
+        };
+        auto numbers = [&] (const std::string& name, const char* descr, const void* data, size_t n, size_t width) {
+            WriteNpy (dir, name, descr, n, data, n * width);
+            columns << name << "\n";
+        };
+        strings ("Scenario", scenario);
+        strings ("Variant", variant);
+        numbers ("CBR(Mbps)", "<f8", rate.data (), rate.size (), 8);
+        strings ("Flow", flow);
+        numbers ("Seed", "<u4", seed.data (), seed.size (), 4);
+        numbers ("Run", "<u4", run.data (), run.size (), 4);
+        strings ("CodeVersion", version);
+        for (size_t i = 0; i < kResultMetrics.size (); ++i)
+        {
+            numbers (kResultMetrics[i].first, "<f8", metrics[i].data (), metrics[i].size (), 8);
+        }
+    }
+
+private:
+    // Names are stored whole, so the index built from a stored record matches the
+    // key of the run that wrote it; longer names are rejected rather than cut.
+    static constexpr size_t kNameLen = 128;
+    // Flow names of the marker records; flow labels never start with '#'.
+    static constexpr const char* kBegin = "#begin";
+    static constexpr const char* kComplete = "#complete";
+
+    // Offsets of a configuration's rows, by KeyString.
+    typedef std::unordered_map<std::string, std::vector<off_t>> Index;
+
+    // Indexes the rows of the last completed attempt of every configuration by code
+    // version, up to the first torn or damaged record, and returns where that is.
+    off_t Scan (std::map<std::string, Index>& completed) const
+    {
+        off_t good = Header ().size ();
+        std::vector<char> buf (RecordSize ());
+        std::map<std::string, Index> attempt;
+        while (pread (m_fd, buf.data (), buf.size (), good) == ssize_t (buf.size ()) && ChecksumOk (buf))
+        {
+            ResultRecord r;
+            std::string version;
+            Decode (buf, r, version);
+            std::string key = KeyString (r.key);
+            if (r.flow == kBegin)
+            {
+                attempt[version][key].clear ();
+            }
+            else if (r.flow == kComplete)
+            {
+                completed[version][key] = attempt[version][key];
+            }
+            else
+            {
+                attempt[version][key].push_back (good);
+            }
+            good += buf.size ();
+        }
+        return good;
+    }
+
+    void Read (off_t off, std::vector<char>& buf) const
+    {
+        if (pread (m_fd, buf.data (), buf.size (), off) != ssize_t (buf.size ()) || !ChecksumOk (buf))
+        {
+            Fail ("cannot read a stored record");
+        }
+    }
+
+    void Mark (const ResultKey& key, const char* marker)
+    {
+        ResultRecord r;
+        r.key = key;
+        r.flow = marker;
+        Append (r);
+    }
+
+    size_t RecordSize () const
+    {
+        // scenario, variant, flow, code version, rate, seed, run, metrics, checksum + pad
+        return 4 * kNameLen + 8 + 4 + 4 + 8 * kResultMetrics.size () + 8;
+    }
+
+    static std::string Header ()
+    {
+        std::string h ("SRES", 4);
+        uint32_t version = 2;
+        uint32_t n = kResultMetrics.size ();
+        h.append (reinterpret_cast<const char*> (&version), 4);
+        h.append (reinterpret_cast<const char*> (&n), 4);
+        for (const auto& m : kResultMetrics)
+        {
+            uint16_t len = std::strlen (m.first);
+            h.append (reinterpret_cast<const char*> (&len), 2);
+            h.append (m.first, len);
+        }
+        return h;
+    }
+
+    std::string KeyString (const ResultKey& k) const
+    {
+        char rate[32];
+        std::snprintf (rate, sizeof (rate), "%.17g", k.cbrRateMbps);
+        return k.scenario + "|" + k.variant + "|" + rate + "|" + std::to_string (k.seed) + "|" +
+               std::to_string (k.run);
+    }
+
+    static uint32_t Fnv (const char* p, size_t n)
+    {
+        uint32_t h = 2166136261u;
+        for (size_t i = 0; i < n; ++i)
+        {
+            h = (h ^ uint8_t (p[i])) * 16777619u;
+        }
+        return h;
+    }
+
+    bool ChecksumOk (const std::vector<char>& buf) const
+    {
+        uint32_t stored;
+        std::memcpy (&stored, &buf[buf.size () - 8], 4);
+        return stored == Fnv (buf.data (), buf.size () - 8);
+    }
+
+    std::vector<char> Encode (const ResultRecord& r) const
+    {
+        std::vector<char> buf (RecordSize (), 0);
+        char* p = buf.data ();
+        auto name = [&] (const std::string& s) {
+            CheckName (s);
+            std::memcpy (p, s.data (), s.size ());
+            p += kNameLen;
+        };
+        name (r.key.scenario);
+        name (r.key.variant);
+        name (r.flow);
+        name (m_codeVersion);
+        std::memcpy (p, &r.key.cbrRateMbps, 8);
+        std::memcpy (p + 8, &r.key.seed, 4);
+        std::memcpy (p + 12, &r.key.run, 4);
+        p += 16;
+        for (const auto& m : kResultMetrics)
+        {
+            std::memcpy (p, &(r.*m.second), 8);
+            p += 8;
+        }
+        uint32_t sum = Fnv (buf.data (), buf.size () - 8);
+        std::memcpy (p, &sum, 4);
+        return buf;
+    }
+
+    void Decode (const std::vector<char>& buf, ResultRecord& r, std::string& version) const
+    {
+        const char* p = buf.data ();
+        auto name = [&] () {
+            std::string s (p, strnlen (p, kNameLen));
+            p += kNameLen;
+            return s;
+        };
+        r.key.scenario = name ();
+        r.key.variant = name ();
+        r.flow = name ();
+        version = name ();
+        std::memcpy (&r.key.cbrRateMbps, p, 8);
+        std::memcpy (&r.key.seed, p + 8, 4);
+        std::memcpy (&r.key.run, p + 12, 4);
+        p += 16;
+        for (const auto& m : kResultMetrics)
+        {
+            std::memcpy (&(r.*m.second), p, 8);
+            p += 8;
+        }
+    }
+
+    static void WriteNpy (const std::string& dir, const std::string& name, const std::string& descr, size_t n,
+                          const void* data, size_t bytes)
+    {
+        std::string file;
+        for (char c : name)
+        {
+            file += (std::isalnum (uint8_t (c)) || c == '_') ? c : '_';
+        }
+        std::string dict = "{'descr': '" + descr + "', 'fortran_order': False, 'shape': (" + std::to_string (n) + ",), }";
+        size_t total = 10 + dict.size () + 1;
+        dict.append ((64 - total % 64) % 64, ' ');
+        dict += "\n";
+        uint16_t len = dict.size ();
+
+        std::ofstream out (dir + "/" + file + ".npy", std::ios::binary);
+        out.write ("\x93NUMPY\x01\x00", 8);
+        out.write (reinterpret_cast<const char*> (&len), 2);
+        out << dict;
+        out.write (static_cast<const char*> (data), bytes);
+    }
+
+    void WriteAll (const char* data, size_t size)
+    {
+        if (write (m_fd, data, size) != ssize_t (size))
+        {
+            Fail ("short write");
+        }
+    }
+
+    void CheckName (const std::string& s) const
+    {
+        if (s.size () > kNameLen)
+        {
+            std::cerr << "results store " << m_path << ": name \"" << s << "\" is longer than " << kNameLen
+                      << " characters" << std::endl;
+            std::abort ();
+        }
+    }
+
+    void Fail (const char* what) const
+    {
+        std::cerr << "results store " << m_path << ": " << what << " (errno " << errno << ")" << std::endl;
+        std::abort ();
+    }
+
+    std::string m_path;
+    std::string m_codeVersion;
+    int m_fd = -1;
+    Index m_index;
+};
+
+// Prints a result row and, when a store is open, appends it there as well.
+inline void EmitResult (ResultsStore& store, const ResultRecord& r)
+{
+    PrintCsvRow (std::cout, r);
+    if (store.IsOpen ())
+    {
+        store.Append (r);
+    }
+}
+
+// Turns a job whose configuration is already stored into one that just reprints
+// the stored rows, so a resumed sweep only simulates the missing points. Any other
+// job brackets its rows with markers, so it only counts as stored once it finished.
+template <typename Job>
+void ResumeFromStore (Job& job, ResultsStore& store, const ResultKey& key)
+{
+    if (!store.IsOpen ())
+    {
+        return;
+    }
+    if (!store.Contains (key))
+    {
+        auto run = job.run;
+        job.run = [&store, key, run] () {
+            store.Begin (key);
+            run ();
+            store.Complete (key);
+        };
+        return;
+    }
+    job.cost = 0;
+    job.run = [&store, key] () {
+        for (const auto& r : store.Lookup (key))
+        {
+            PrintCsvRow (std::cout, r);
+        }
+    };
+}
+
+#endif // RESULTS_STORE_H
@@ -0,0 +1,341 @@
+#ifndef SCENARIO_BUILDER_H
+#define SCENARIO_BUILDER_H
+
+#include "bottleneck_aqm.h"
+#include "flow_probe.h"
+#include "perf_counters.h"
+#include "tcp_variants.h"
+
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/internet-module.h"
+#include "ns3/applications-module.h"
+#include "ns3/point-to-point-module.h"
+#include "ns3/nix-vector-routing-module.h"
+
+#include <fstream>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace ns3 {
+
+struct LinkSpec
+{
+    std::string a, b;
+    std::string rate;
+    std::string delay;
+    std::string queue;          // <aqm>[:<limit>] of a's device, the stack's default when empty
+    uint32_t mtu = 1500;
+    bool bottleneck = false;    // probed and reported with the measured flow; exactly one link is
+};
+
+struct FlowSpec
+{
+    std::string protocol;       // tcp or udp
+    std::string src, dst;
+    Time start = Seconds (1);
+    Time stop;                  // zero: the end of the run
+    std::string variant;        // tcp; the swept variant when empty
+    std::string rate;           // udp
+    std::string on = "ns3::ConstantRandomVariable[Constant=1]";    // udp on/off periods
+    std::string off = "ns3::ConstantRandomVariable[Constant=0]";
+    uint32_t size = 1000;       // bytes per tcp send call or udp packet
+    uint16_t port = 0;          // 5000 + its index when zero
+    bool measure = false;       // the flow result rows are reported for
+};
+
+// A topology and its traffic read from a scenario file, plus its sweep axes. In
+// flow and link values, $variant and $rate stand for the swept variant and CBR rate
+// (in Mbps).
+struct ScenarioSpec
+{
+    std::string name = "File";
+    Time duration = Seconds (30);
+    std::string routing = "global";     // global: Ipv4GlobalRouting tables; nix: Nix-vector routes on demand
+    uint32_t segmentSize = 1000;
+    uint32_t socketBuffer = 1 << 20;    // send and receive buffer of every TCP socket
+    std::vector<std::string> nodes;
+    std::vector<LinkSpec> links;
+    std::vector<FlowSpec> flows;
+    std::vector<std::string> variants;
+    std::vector<double> rates;
+};
+
+// Reads a scenario file: one directive per line, # starts a comment.
+//   scenario <name>
+//   duration <time>
+//   routing global|nix
+//   tcp segment=<bytes> buffer=<bytes>
+//   node <name>...
+//   link <a> <b> <rate> <delay> [queue=<aqm>[:<limit>]] [mtu=<bytes>] [bottleneck]
+//   flow tcp <src> <dst> [variant=<variant>] [start=<time>] [stop=<time>] [size=<bytes>] [port=<n>] [measure]
+//   flow udp <src> <dst> rate=<rate> [on=<random variable>] [off=<random variable>] [start=..] [stop=..] [size=..] [port=..]
+//   sweep variant <v>,<v>...
+//   sweep rate <Mbps>,<Mbps>...
+inline ScenarioSpec LoadScenario (const std::string& path)
+{
+    std::ifstream in (path);
+    NS_ABORT_MSG_IF (!in, "Cannot open scenario file " << path);
+    ScenarioSpec spec;
+    std::map<std::string, bool> declared;
+    std::string line;
+    int number = 0;
+    while (std::getline (in, line))
+    {
+        number++;
+        line = line.substr (0, line.find ('#'));
+        std::istringstream words (line);
+        std::vector<std::string> w;
+        for (std::string word; words >> word;)
+        {
+            w.push_back (word);
+        }
+        if (w.empty ())
+        {
+            continue;
+        }
+        std::string where = path + ":" + std::to_string (number) + ": ";
+        auto known = [&] (const std::string& node) {
+            NS_ABORT_MSG_IF (!declared.count (node), where << "undeclared node " << node);
+            return node;
+        };
+        // key=value options and flags after the positional words
+        auto options = [&] (size_t from, std::map<std::string, std::string>& values) {
+            for (size_t i = from; i < w.size (); ++i)
+            {
+                size_t equals = w[i].find ('=');
+                values[w[i].substr (0, equals)] = equals == std::string::npos ? "" : w[i].substr (equals + 1);
+            }
+        };
+
+        if (w[0] == "scenario" && w.size () == 2)
+        {
+            spec.name = w[1];
+        }
+        else if (w[0] == "duration" && w.size () == 2)
+        {
+            spec.duration = Time (w[1]);
+        }
+        else if (w[0] == "routing" && w.size () == 2 && (w[1] == "global" || w[1] == "nix"))
+        {
+            spec.routing = w[1];
+        }
+        else if (w[0] == "tcp" && w.size () >= 2)
+        {
+            std::map<std::string, std::string> values;
+            options (1, values);
+            for (const auto& v : values)
+            {
+                if (v.first == "segment") spec.segmentSize = std::stoul (v.second);
+                else if (v.first == "buffer") spec.socketBuffer = std::stoul (v.second);
+                else NS_ABORT_MSG (where << "unknown tcp option " << v.first);
+            }
+        }
+        else if (w[0] == "node" && w.size () >= 2)
+        {
+            for (size_t i = 1; i < w.size (); ++i)
+            {
+                NS_ABORT_MSG_IF (declared[w[i]], where << "node " << w[i] << " declared twice");
+                declared[w[i]] = true;
+                spec.nodes.push_back (w[i]);
+            }
+        }
+        else if (w[0] == "link" && w.size () >= 5)
+        {
+            LinkSpec link {known (w[1]), known (w[2]), w[3], w[4]};
+            std::map<std::string, std::string> values;
+            options (5, values);
+            link.queue = values.count ("queue") ? values["queue"] : "";
+            link.mtu = values.count ("mtu") ? std::stoul (values["mtu"]) : link.mtu;
+            link.bottleneck = values.count ("bottleneck") > 0;
+            spec.links.push_back (link);
+        }
+        else if (w[0] == "flow" && w.size () >= 4 && (w[1] == "tcp" || w[1] == "udp"))
+        {
+            FlowSpec flow;
+            flow.protocol = w[1];
+            flow.src = known (w[2]);
+            flow.dst = known (w[3]);
+            std::map<std::string, std::string> values;
+            options (4, values);
+            for (const auto& v : values)
+            {
+                if (v.first == "variant") flow.variant = v.second;
+                else if (v.first == "rate") flow.rate = v.second;
+                else if (v.first == "on") flow.on = v.second;
+                else if (v.first == "off") flow.off = v.second;
+                else if (v.first == "start") flow.start = Time (v.second);
+                else if (v.first == "stop") flow.stop = Time (v.second);
+                else if (v.first == "size") flow.size = std::stoul (v.second);
+                else if (v.first == "port") flow.port = std::stoul (v.second);
+                else if (v.first == "measure") flow.measure = true;
+                else NS_ABORT_MSG (where << "unknown flow option " << v.first);
+            }
+            NS_ABORT_MSG_IF (flow.protocol == "udp" && flow.rate.empty (), where << "udp flows need a rate");
+            NS_ABORT_MSG_IF (flow.measure && flow.protocol != "tcp", where << "only tcp flows can be measured");
+            spec.flows.push_back (flow);
+        }
+        else if (w[0] == "sweep" && w.size () == 3 && (w[1] == "variant" || w[1] == "rate"))
+        {
+            std::istringstream items (w[2]);
+            for (std::string item; std::getline (items, item, ',');)
+            {
+                if (w[1] == "variant")
+                {
+                    spec.variants.push_back (item);
+                }
+                else
+                {
+                    spec.rates.push_back (std::stod (item));
+                }
+            }
+        }
+        else
+        {
+            NS_ABORT_MSG (where << "cannot parse: " << line);
+        }
+    }
+    size_t measured = 0;
+    size_t bottlenecks = 0;
+    for (const auto& link : spec.links)
+    {
+        bottlenecks += link.bottleneck ? 1 : 0;
+    }
+    NS_ABORT_MSG_IF (bottlenecks != 1, path << ": exactly one link has to be the bottleneck");
+    for (size_t i = 0; i < spec.flows.size (); ++i)
+    {
+        FlowSpec& flow = spec.flows[i];
+        flow.port = flow.port ? flow.port : uint16_t (5000 + i);
+        measured += flow.measure ? 1 : 0;
+    }
+    NS_ABORT_MSG_IF (measured != 1, path << ": exactly one flow has to be measured");
+    return spec;
+}
+
+// What the rest of a run needs from a built scenario.
+struct BuiltScenario
+{
+    std::map<std::string, Ptr<Node>> nodes;
+    Ptr<NetDevice> bottleneck;
+    BottleneckQueue bottleneckQueue;
+    std::vector<std::unique_ptr<BottleneckQueue>> queues;   // of the other links with a queue
+    Ptr<Application> sender, sink;          // of the measured flow
+    uint16_t port = 0;
+    Time start;
+};
+
+// Instantiates spec for one sweep point. Every link gets its own /30; with Nix-vector
+// routing no node holds a routing table, and routes are computed per destination
+// when first used.
+inline void BuildScenario (const ScenarioSpec& spec, const std::string& variant, double rateMbps, BuiltScenario& s,
+                           PerfCounters& perf)
+{
+    auto expand = [&] (std::string value) {
+        std::ostringstream rate;
+        rate << rateMbps << "Mbps";
+        for (const auto& var : {std::make_pair (std::string ("$variant"), variant),
+                                std::make_pair (std::string ("$rate"), rate.str ())})
+        {
+            for (size_t at; (at = value.find (var.first)) != std::string::npos;)
+            {
+                value.replace (at, var.first.size (), var.second);
+            }
+        }
+        return value;
+    };
+
+    NodeContainer all;
+    for (const auto& name : spec.nodes)
+    {
+        s.nodes[name] = CreateObject<Node> ();
+        all.Add (s.nodes[name]);
+    }
+
+    Config::SetDefault ("ns3::TcpL4Protocol::SocketType", TypeIdValue (GetTcpVariant (variant)));
+    Config::SetDefault ("ns3::TcpSocket::SegmentSize", UintegerValue (spec.segmentSize));
+    Config::SetDefault ("ns3::TcpSocket::SndBufSize", UintegerValue (spec.socketBuffer));
+    Config::SetDefault ("ns3::TcpSocket::RcvBufSize", UintegerValue (spec.socketBuffer));
+    InternetStackHelper stack;
+    if (spec.routing == "nix")
+    {
+        stack.SetRoutingHelper (Ipv4NixVectorHelper ());
+    }
+    stack.Install (all);
+
+    Ipv4AddressHelper address ("10.0.0.0", "255.255.255.252");
+    for (const auto& link : spec.links)
+    {
+        PointToPointHelper p2p;
+        p2p.SetDeviceAttribute ("DataRate", StringValue (expand (link.rate)));
+        p2p.SetDeviceAttribute ("Mtu", UintegerValue (link.mtu));
+        p2p.SetChannelAttribute ("Delay", StringValue (expand (link.delay)));
+        NetDeviceContainer devices = p2p.Install (s.nodes[link.a], s.nodes[link.b]);
+        address.Assign (devices);
+        address.NewNetwork ();
+
+        BottleneckQueueOptions queue;
+        size_t colon = link.queue.find (':');
+        queue.aqm = link.queue.substr (0, colon);
+        queue.limit = colon == std::string::npos ? queue.limit : link.queue.substr (colon + 1);
+        if (link.bottleneck)
+        {
+            s.bottleneck = devices.Get (0);
+            s.bottleneckQueue.Install (s.bottleneck, queue);
+        }
+        else if (!IsDefaultAqm (queue.aqm))
+        {
+            s.queues.push_back (std::make_unique<BottleneckQueue> ());
+            s.queues.back ()->Install (devices.Get (0), queue);
+        }
+    }
+    perf.BeginRouting ();
+    if (spec.routing == "global")
+    {
+        Ipv4GlobalRoutingHelper::PopulateRoutingTables ();
+    }
+    perf.EndRouting ();
+
+    for (const auto& flow : spec.flows)
+    {
+        Ptr<Node> src = s.nodes.at (flow.src);
+        Ptr<Node> dst = s.nodes.at (flow.dst);
+        Ipv4Address remote = dst->GetObject<Ipv4> ()->GetAddress (1, 0).GetLocal ();
+        Time stop = flow.stop.IsZero () ? spec.duration : flow.stop;
+        if (flow.protocol == "tcp")
+        {
+            std::string v = flow.variant.empty () ? variant : expand (flow.variant);
+            Ptr<Application> sender = InstallFlowSender (src, InetSocketAddress (remote, flow.port), v, flow.size);
+            sender->SetStartTime (flow.start);
+            sender->SetStopTime (stop);
+            PacketSinkHelper sink ("ns3::TcpSocketFactory", InetSocketAddress (Ipv4Address::GetAny (), flow.port));
+            Ptr<Application> sinkApp = sink.Install (dst).Get (0);
+            if (flow.measure)
+            {
+                s.sender = sender;
+                s.sink = sinkApp;
+                s.port = flow.port;
+                s.start = flow.start;
+            }
+        }
+        else
+        {
+            OnOffHelper udp ("ns3::UdpSocketFactory", InetSocketAddress (remote, flow.port));
+            udp.SetAttribute ("DataRate", StringValue (expand (flow.rate)));
+            udp.SetAttribute ("PacketSize", UintegerValue (flow.size));
+            udp.SetAttribute ("OnTime", StringValue (flow.on));
+            udp.SetAttribute ("OffTime", StringValue (flow.off));
+            udp.SetAttribute ("StartTime", TimeValue (flow.start));
+            udp.SetAttribute ("StopTime", TimeValue (stop));
+            udp.Install (src);
+            PacketSinkHelper sink ("ns3::UdpSocketFactory", InetSocketAddress (Ipv4Address::GetAny (), flow.port));
+            sink.Install (dst);
+        }
+    }
+}
+
+} // namespace ns3
+
+#endif // SCENARIO_BUILDER_H
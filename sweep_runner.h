@@ -0,0 +1,250 @@
+#ifndef SWEEP_RUNNER_H
+#define SWEEP_RUNNER_H
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <functional>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <poll.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+// One simulation configuration of a sweep. The Simulator is a process-wide
+// singleton, so every job runs in a freshly forked worker that starts from the
+// parent's state (Config defaults, RNG stream counters) and writes its result
+// rows to std::cout.
+struct SweepJob
+{
+    std::string name;
+    double cost;                // relative cost estimate, costly jobs are dispatched first
+    std::function<void ()> run;
+    double timeoutSec = -1;     // overrides SweepOptions::timeoutSec when >= 0
+};
+
+struct SweepOptions
+{
+    unsigned workers = 1;       // 0 runs every job inline in this process
+    double timeoutSec = 0;      // per-job wall-clock limit, 0 disables it
+};
+
+struct SweepOutcome
+{
+    bool ok = false;
+    bool timedOut = false;
+    int status = 0;
+    double wallSec = 0;
+    std::string output;
+};
+
+// Called once per job, always in job order, whatever order the workers finish in.
+typedef std::function<void (size_t, const SweepOutcome&)> SweepCallback;
+
+inline void PrintSweepOutcome (size_t, const SweepOutcome& outcome)
+{
+    std::cout << outcome.output << std::flush;
+}
+
+inline double SweepElapsed (std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double> (std::chrono::steady_clock::now () - start).count ();
+}
+
+inline void ReportSweepFailure (const SweepJob& job, const SweepOutcome& outcome)
+{
+    if (outcome.timedOut)
+    {
+        std::cerr << "sweep: " << job.name << " timed out after " << outcome.wallSec << "s" << std::endl;
+    }
+    else if (WIFSIGNALED (outcome.status))
+    {
+        std::cerr << "sweep: " << job.name << " killed by signal " << WTERMSIG (outcome.status) << std::endl;
+    }
+    else
+    {
+        std::cerr << "sweep: " << job.name << " exited with status " << WEXITSTATUS (outcome.status) << std::endl;
+    }
+}
+
+// Runs the jobs through a bounded pool of worker processes and returns the number
+// of jobs that failed or timed out. Output of failed jobs is discarded so a partial
+// row never reaches the CSV.
+inline size_t RunSweep (const std::vector<SweepJob>& jobs, const SweepOptions& options,
+                        const SweepCallback& onDone = PrintSweepOutcome)
+{
+    std::vector<SweepOutcome> outcomes (jobs.size ());
+    std::vector<bool> done (jobs.size (), false);
+    size_t nextEmit = 0;
+    size_t failures = 0;
+
+    auto emitReady = [&] () {
+        while (nextEmit < jobs.size () && done[nextEmit])
+        {
+            if (!outcomes[nextEmit].ok)
+            {
+                ReportSweepFailure (jobs[nextEmit], outcomes[nextEmit]);
+                outcomes[nextEmit].output.clear ();
+                ++failures;
+            }
+            onDone (nextEmit, outcomes[nextEmit]);
+            outcomes[nextEmit].output.clear ();
+            outcomes[nextEmit].output.shrink_to_fit ();
+            ++nextEmit;
+        }
+    };
+
+    if (options.workers == 0)
+    {
+        for (size_t i = 0; i < jobs.size (); ++i)
+        {
+            std::ostringstream captured;
+            std::streambuf* saved = std::cout.rdbuf (captured.rdbuf ());
+            auto start = std::chrono::steady_clock::now ();
+            jobs[i].run ();
+            std::cout.rdbuf (saved);
+            outcomes[i].ok = true;
+            outcomes[i].wallSec = SweepElapsed (start);
+            outcomes[i].output = captured.str ();
+            done[i] = true;
+            emitReady ();
+        }
+        return failures;
+    }
+
+    // Longest jobs first so the tail of the sweep is made of short ones.
+    std::vector<size_t> order (jobs.size ());
+    for (size_t i = 0; i < order.size (); ++i)
+    {
+        order[i] = i;
+    }
+    std::stable_sort (order.begin (), order.end (),
+                      [&] (size_t a, size_t b) { return jobs[a].cost > jobs[b].cost; });
+
+    struct Worker
+    {
+        pid_t pid;
+        int fd;
+        size_t job;
+        double timeoutSec;
+        std::chrono::steady_clock::time_point start;
+    };
+    std::vector<Worker> active;
+    size_t next = 0;
+
+    auto launch = [&] (size_t job) {
+        int fds[2];
+        if (pipe (fds) != 0)
+        {
+            std::cerr << "sweep: pipe failed, errno " << errno << std::endl;
+            std::abort ();
+        }
+        std::cout.flush ();
+        std::cerr.flush ();
+        pid_t pid = fork ();
+        if (pid < 0)
+        {
+            std::cerr << "sweep: fork failed, errno " << errno << std::endl;
+            std::abort ();
+        }
+        if (pid == 0)
+        {
+            close (fds[0]);
+            for (const auto& w : active)
+            {
+                close (w.fd);
+            }
+            dup2 (fds[1], STDOUT_FILENO);
+            close (fds[1]);
+            jobs[job].run ();
+            std::cout.flush ();
+            _exit (0);
+        }
+        close (fds[1]);
+        double timeoutSec = jobs[job].timeoutSec >= 0 ? jobs[job].timeoutSec : options.timeoutSec;
+        active.push_back (Worker {pid, fds[0], job, timeoutSec, std::chrono::steady_clock::now ()});
+    };
+
+    auto reap = [&] (size_t slot, bool timedOut) {
+        Worker w = active[slot];
+        if (timedOut)
+        {
+            kill (w.pid, SIGKILL);
+        }
+        close (w.fd);
+        int status = 0;
+        while (waitpid (w.pid, &status, 0) < 0 && errno == EINTR)
+        {
+        }
+        SweepOutcome& outcome = outcomes[w.job];
+        outcome.timedOut = timedOut;
+        outcome.status = status;
+        outcome.ok = !timedOut && WIFEXITED (status) && WEXITSTATUS (status) == 0;
+        outcome.wallSec = SweepElapsed (w.start);
+        done[w.job] = true;
+        active.erase (active.begin () + slot);
+    };
+
+    char buf[1 << 16];
+    while (next < order.size () || !active.empty ())
+    {
+        while (next < order.size () && active.size () < options.workers)
+        {
+            launch (order[next++]);
+        }
+
+        int waitMs = -1;
+        for (const auto& w : active)
+        {
+            if (w.timeoutSec > 0)
+            {
+                int left = std::max (0, int ((w.timeoutSec - SweepElapsed (w.start)) * 1000.0) + 1);
+                waitMs = waitMs < 0 ? left : std::min (waitMs, left);
+            }
+        }
+
+        std::vector<pollfd> fds;
+        for (const auto& w : active)
+        {
+            fds.push_back (pollfd {w.fd, POLLIN, 0});
+        }
+        if (poll (fds.data (), fds.size (), waitMs) < 0 && errno != EINTR)
+        {
+            std::cerr << "sweep: poll failed, errno " << errno << std::endl;
+            std::abort ();
+        }
+
+        // Walk backwards so reaping a slot does not shift the ones still to visit. The
+        // deadline is checked first, so a worker that keeps writing still times out.
+        for (size_t i = active.size (); i-- > 0;)
+        {
+            if (active[i].timeoutSec > 0 && SweepElapsed (active[i].start) >= active[i].timeoutSec)
+            {
+                reap (i, true);
+            }
+            else if (fds[i].revents & (POLLIN | POLLHUP | POLLERR))
+            {
+                ssize_t n = read (active[i].fd, buf, sizeof (buf));
+                if (n > 0)
+                {
+                    outcomes[active[i].job].output.append (buf, n);
+                    continue;
+                }
+                if (n < 0 && errno == EINTR)
+                {
+                    continue;
+                }
+                reap (i, false);
+            }
+        }
+        emitReady ();
+    }
+    return failures;
+}
+
+#endif // SWEEP_RUNNER_H
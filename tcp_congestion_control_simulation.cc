@@ -3,28 +3,242 @@
 #include "ns3/internet-module.h"
 #include "ns3/point-to-point-module.h"
 #include "ns3/applications-module.h"
-#include "ns3/flow-monitor-module.h"
-#include "ns3/tcp-vegas.h"
-#include "ns3/tcp-westwood-plus.h"
-#include "ns3/tcp-bbr.h"
-#include "ns3/tcp-cubic.h"
-#include "ns3/tcp-veno.h"
 #include "ns3/ping-helper.h"
 
+#include "bottleneck_aqm.h"
+#include "convergence_monitor.h"
+#include "dc_workload.h"
+#include "event_timeline.h"
+#include "knee_search.h"
+#include "flow_tracer.h"
+#include "fluid_model.h"
+#include "packet_capture.h"
+#include "perf_counters.h"
+#include "regression.h"
+#include "replication.h"
+#include "results_store.h"
+#include "scenario_builder.h"
+#include "sweep_runner.h"
+#include "tcp_variants.h"
+
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <map>
+#include <thread>
+#include <tuple>
+
 using namespace ns3;
 
-TypeId GetTcpVariant (const std::string& variant)
+// HighBandwidth scenario: a dumbbell at data-center rates whose bottleneck buffer is
+// swept in multiples of the bandwidth-delay product.
+struct HighBandwidthOptions
+{
+    std::string rate = "10Gbps";            // every link
+    Time baseRtt = MicroSeconds (100);
+    uint32_t mtu = 9000;                    // segments fill the frames
+    uint32_t sendSize = 65536;              // bytes a sender hands to its socket at once
+    uint32_t flows = 4;
+    Time duration = MilliSeconds (500);     // after the flows started
+};
+
+// ParkingLot scenario: a chain of bottleneck hops that long flows cross end to end,
+// while cross flows enter before each hop and leave after it.
+struct ParkingLotOptions
+{
+    std::string rate = "10Mbps";            // every hop; access links run ten times as fast
+    Time hopDelay = MilliSeconds (5);
+    Time accessDelay = MilliSeconds (2);    // receivers, and senders without an --accessDelays entry
+    uint32_t longFlows = 1;
+    uint32_t crossFlows = 1;                // per hop
+    Time duration = Seconds (60);           // after the flows started
+};
+
+// Options shared by every scenario, set from the command line before the sweep forks.
+struct ScenarioOptions
+{
+    std::string tracePrefix;                // per-flow time series files, disabled when empty
+    Time traceInterval = MilliSeconds (10);
+    ConvergenceOptions convergence;         // stop runs early once the measured flow is in steady state
+    BottleneckQueueOptions queue;           // dumbbell bottleneck; the AQM itself is chosen per point
+    WorkloadOptions workload;               // Workload scenario; the load is chosen per point
+    uint32_t workloadPairs = 8;             // sender/receiver hosts on each side of its dumbbell
+    PacketCaptureOptions capture;           // links are "bottleneck" or <node>-<node>
+    std::vector<NetworkEvent> events;       // timeline applied to every run of Scenarios 1-4
+    TransientOptions transient;
+    HighBandwidthOptions highBandwidth;
+    ParkingLotOptions parkingLot;
+    std::vector<Time> accessDelays;         // per sender, cycled; Scenario 3/4, Fairness and ParkingLot senders
+    std::string accessLabel;                // suffix of the labels of runs with accessDelays, e.g. -Access2ms+50ms
+};
+
+ScenarioOptions g_options;
+ResultsStore g_results;
+PerfLog g_perfLog;
+FctLog g_fctLog;
+TransientLog g_eventLog;
+
+// Trace file of one run: <prefix>-<scenario>-<variant>-<rate>-run<n><suffix>.
+std::string TracePath (const std::string& scenario, const std::string& tcpVariant, double cbrRateMbps,
+                       const std::string& suffix, const std::string& prefix = g_options.tracePrefix)
+{
+    std::ostringstream path;
+    path << prefix << "-" << scenario << "-" << tcpVariant << "-" << cbrRateMbps
+         << "-run" << RngSeedManager::GetRun () << suffix;
+    return path.str ();
+}
+
+std::unique_ptr<FlowTracer> MakeFlowTracer (const std::string& scenario, const std::string& tcpVariant, double cbrRateMbps)
+{
+    if (g_options.tracePrefix.empty ())
+    {
+        return nullptr;
+    }
+    return std::make_unique<FlowTracer> (TracePath (scenario, tcpVariant, cbrRateMbps, ".ftrc"), g_options.traceInterval);
+}
+
+// Capture of the links chosen with --capture, null when there are none. bottleneck
+// is what the "bottleneck" link stands for.
+std::unique_ptr<PacketCapture> MakePacketCapture (const std::string& scenario, const std::string& tcpVariant,
+                                                  double cbrRateMbps, Ptr<NetDevice> bottleneck)
+{
+    if (g_options.capture.links.empty ())
+    {
+        return nullptr;
+    }
+    auto capture = std::make_unique<PacketCapture> (
+        g_options.capture, TracePath (scenario, tcpVariant, cbrRateMbps, "", g_options.capture.prefix));
+    capture->Install ({{"bottleneck", bottleneck}});
+    return capture;
+}
+
+// The --events timeline of one run and the measured flow's response to it.
+struct Timeline
+{
+    EventTimeline events;
+    std::unique_ptr<TransientMonitor> monitor;
+};
+
+// Schedules the timeline on a built scenario whose measured flow starts at start;
+// null without events. The bottleneck carries cbrMbps of constant-rate traffic and
+// tcpFlows TCP flows, which sets the measured flow's fair share.
+std::unique_ptr<Timeline> MakeTimeline (const TimelineHooks& hooks, Ptr<Application> tcpSender,
+                                        Ptr<Application> tcpSink, Time start, double cbrMbps, uint32_t tcpFlows)
+{
+    if (g_options.events.empty ())
+    {
+        return nullptr;
+    }
+    auto timeline = std::make_unique<Timeline> ();
+    timeline->events.Schedule (g_options.events, hooks);
+    timeline->monitor = std::make_unique<TransientMonitor> (g_options.transient, start);
+    timeline->monitor->SetFairShare (hooks.bottleneck, cbrMbps, tcpFlows);
+    timeline->monitor->Install (tcpSender, tcpSink);
+    return timeline;
+}
+
+void ReportTimeline (const Timeline* timeline, const std::string& scenario, const std::string& tcpVariant,
+                     double cbrRateMbps)
+{
+    if (timeline)
+    {
+        g_eventLog.Append (scenario, tcpVariant, cbrRateMbps, timeline->monitor->Finish (g_options.events));
+    }
+}
+
+// Hooks of a scenario routed by Ipv4GlobalRouting whose added flows run from sender
+// to receiver, each to its own port from 8100 up.
+TimelineHooks GlobalRoutingHooks (Ptr<NetDevice> bottleneck, Ptr<Node> sender, Ptr<Node> receiver,
+                                  const std::string& tcpVariant)
+{
+    TimelineHooks hooks;
+    hooks.bottleneck = bottleneck;
+    hooks.addFlow = [sender, receiver, tcpVariant] (uint32_t n, const std::string& variant) {
+        uint16_t port = 8100 + n;
+        PacketSinkHelper sink ("ns3::TcpSocketFactory", InetSocketAddress (Ipv4Address::GetAny (), port));
+        sink.Install (receiver);
+        Ipv4Address remote = receiver->GetObject<Ipv4> ()->GetAddress (1, 0).GetLocal ();
+        InstallFlowSender (sender, InetSocketAddress (remote, port), variant.empty () ? tcpVariant : variant, 1000);
+    };
+    hooks.rerouted = [] () { Ipv4GlobalRoutingHelper::RecomputeRoutingTables (); };
+    return hooks;
+}
+
+// Measures the TCP flow to port at its two end hosts only, plus the bottleneck
+// device it crosses, instead of probing every node with FlowMonitor.
+void InstallFlowProbe (EndpointFlowProbe& probe, Ptr<Application> tcpSender, Ptr<Application> tcpSink,
+                       Ptr<NetDevice> bottleneck, uint16_t port, Time start)
+{
+    probe.Install (tcpSender->GetNode ());
+    probe.Install (tcpSink->GetNode ());
+    probe.InstallBottleneck (bottleneck);
+    probe.TraceRtt (tcpSender, start, port);
+}
+
+// Watches the flow to port 8080 from its start; null unless convergence detection is enabled.
+std::unique_ptr<ConvergenceMonitor> MakeConvergenceMonitor (const EndpointFlowProbe& probe, Time start)
 {
-    if (variant == "TcpVegas") return TcpVegas::GetTypeId();
-    if (variant == "TcpWestwoodPlus") return TcpWestwoodPlus::GetTypeId();
-    if (variant == "TcpBbr") return TcpBbr::GetTypeId();
-    if (variant == "TcpCubic") return TcpCubic::GetTypeId();
-    if (variant == "TcpVeno") return TcpVeno::GetTypeId();
-    NS_ABORT_MSG ("Unknown TCP variant: " << variant);
+    if (!g_options.convergence.enabled)
+    {
+        return nullptr;
+    }
+    auto convergence = std::make_unique<ConvergenceMonitor> (g_options.convergence, EndpointProbeSampler (probe, 8080));
+    convergence->Start (start);
+    return convergence;
+}
+
+// Key of the configuration this process simulates; the RNG run tells benchmark repeats apart.
+ResultKey ConfigKey (const std::string& scenario, const std::string& tcpVariant, double cbrRateMbps)
+{
+    return ResultKey {scenario, tcpVariant, cbrRateMbps, RngSeedManager::GetSeed (), uint32_t (RngSeedManager::GetRun ())};
+}
+
+// Propagation RTT of a reported flow's path and the bottleneck links it crosses, where
+// the scenario knows them.
+struct FlowPath
+{
+    double baseRttMs = -1;
+    double hops = -1;
+};
+
+// Reports the TCP flow to port. Throughput is averaged over the time since the flow
+// started, which ends early once a convergence monitor stopped the run. queue adds
+// the counters of the bottleneck queue, where the scenario has one.
+void ReportFlow (const std::string& scenario, const std::string& tcpVariant, double cbrRateMbps,
+                 const EndpointFlowProbe& probe, uint16_t port, Time start, const BottleneckQueue* queue = nullptr,
+                 const FlowPath& path = FlowPath ())
+{
+    double stopSec = Simulator::Now ().GetSeconds ();
+    for (const auto& flow : probe.GetFlows ())
+    {
+        if (flow.first.protocol != 6 || flow.first.dstPort != port)
+        {
+            continue;
+        }
+        const FlowProbeStats& st = flow.second;
+        ResultRecord r;
+        r.key = ConfigKey (scenario, tcpVariant, cbrRateMbps);
+        r.flow = std::to_string (port);
+        r.throughputMbps = st.rxBytes * 8.0 / ((stopSec - start.GetSeconds ()) * 1e6);
+        r.avgRttMs = st.rxPackets > 0 ? st.delaySumNs / 1e6 / st.rxPackets : -1.0;
+        r.dropRate = DropRate (st.txPackets, st.rxPackets);
+        r.stopTimeSec = stopSec;
+        SetTailLatency (r, st, probe.GetRtt (port));
+        if (queue)
+        {
+            queue->Fill (r);
+        }
+        r.baseRttMs = path.baseRttMs;
+        r.hops = path.hops;
+        EmitResult (g_results, r);
+    }
 }
 
 void RunScenario1 (const std::string& tcpVariant, double cbrRateMbps)
 {
+    PerfCounters perf;
+    perf.Begin ();
+
     NodeContainer nodes;
     nodes.Create (5);
 
@@ -37,6 +251,10 @@ void RunScenario1 (const std::string& tcpVariant, double cbrRateMbps)
     NetDeviceContainer d2 = p2p.Install (NodeContainer (nodes.Get (2), nodes.Get (3)));
     NetDeviceContainer d3 = p2p.Install (NodeContainer (nodes.Get (3), nodes.Get (4)));
 
+    // TcpL4Protocol reads SocketType when the stack is installed, so the variant
+    // has to be set first or the run inherits whatever the previous run left behind.
+    Config::SetDefault ("ns3::TcpL4Protocol::SocketType", TypeIdValue (GetTcpVariant (tcpVariant)));
+
     InternetStackHelper stack;
     stack.Install (nodes);
 
@@ -47,58 +265,73 @@ void RunScenario1 (const std::string& tcpVariant, double cbrRateMbps)
     address.SetBase ("10.1.3.0", "255.255.255.0"); i2 = address.Assign (d2);
     address.SetBase ("10.1.4.0", "255.255.255.0"); i3 = address.Assign (d3);
 
+    perf.BeginRouting ();
     Ipv4GlobalRoutingHelper::PopulateRoutingTables ();
-
-    Config::SetDefault ("ns3::TcpL4Protocol::SocketType", TypeIdValue (GetTcpVariant (tcpVariant)));
+    perf.EndRouting ();
 
     BulkSendHelper tcpSource ("ns3::TcpSocketFactory",
         InetSocketAddress (i3.GetAddress (1), 8080));
     tcpSource.SetAttribute ("MaxBytes", UintegerValue (0));
-    tcpSource.Install (nodes.Get (0)).Start (Seconds (1.0));
+    ApplicationContainer tcpApp = tcpSource.Install (nodes.Get (0));
+    tcpApp.Start (Seconds (1.0));
 
     PacketSinkHelper tcpSink ("ns3::TcpSocketFactory",
         InetSocketAddress (Ipv4Address::GetAny (), 8080));
-    tcpSink.Install (nodes.Get (4)).Start (Seconds (0.0));
+    ApplicationContainer sinkApp = tcpSink.Install (nodes.Get (4));
+    sinkApp.Start (Seconds (0.0));
 
     OnOffHelper udpApp ("ns3::UdpSocketFactory",
         InetSocketAddress (i3.GetAddress (1), 9000));
-    udpApp.SetAttribute ("DataRate", DataRateValue (DataRate (std::to_string (int (cbrRateMbps)) + "Mbps")));
+    udpApp.SetAttribute ("DataRate", DataRateValue (DataRate (uint64_t (cbrRateMbps * 1e6))));
     udpApp.SetAttribute ("PacketSize", UintegerValue (950));
     udpApp.SetAttribute ("StartTime", TimeValue (Seconds (1.0)));
     udpApp.SetAttribute ("StopTime", TimeValue (Seconds (50.0)));
     udpApp.Install (nodes.Get (1));
 
-    FlowMonitorHelper flowmon;
-    Ptr<FlowMonitor> monitor = flowmon.InstallAll ();
+    EndpointFlowProbe probe;
+    InstallFlowProbe (probe, tcpApp.Get (0), sinkApp.Get (0), d2.Get (0), 8080, Seconds (1.0));
 
-    Simulator::Stop (Seconds (50.0));
-    Simulator::Run ();
+    std::unique_ptr<FlowTracer> tracer = MakeFlowTracer ("Scenario1", tcpVariant, cbrRateMbps);
+    if (tracer)
+    {
+        tracer->AddFlow ("8080", tcpApp.Get (0), sinkApp.Get (0), Seconds (1.0));
+        tracer->Start (Seconds (1.0));
+    }
+    std::unique_ptr<PacketCapture> capture = MakePacketCapture ("Scenario1", tcpVariant, cbrRateMbps, d2.Get (0));
+    std::unique_ptr<Timeline> timeline = MakeTimeline (
+        GlobalRoutingHooks (d2.Get (0), nodes.Get (0), nodes.Get (4), tcpVariant), tcpApp.Get (0), sinkApp.Get (0),
+        Seconds (1.0), cbrRateMbps, 1);
 
-    Ptr<Ipv4FlowClassifier> classifier = DynamicCast<Ipv4FlowClassifier> (flowmon.GetClassifier());
-    auto stats = monitor->GetFlowStats();
+    std::unique_ptr<ConvergenceMonitor> convergence = MakeConvergenceMonitor (probe, Seconds (1.0));
 
-    for (auto& entry : stats)
+    if (g_perfLog.IsOpen ())
     {
-        auto fiveTuple = classifier->FindFlow (entry.first);
-        if (fiveTuple.destinationPort == 8080)
-        {
-            double throughput = entry.second.rxBytes * 8.0 / (49.0 * 1e6);
-            double avgRttMs = entry.second.delaySum.GetSeconds () * 1000.0 / entry.second.rxPackets;
-            double dropRate = (entry.second.txPackets - entry.second.rxPackets) / (double)entry.second.txPackets;
+        perf.CountLinks ();
+    }
 
-            std::cout << "Scenario1," << tcpVariant
-                      << ", " << cbrRateMbps
-                      << ", " << throughput
-                      << ", " << avgRttMs
-                      << ", " << dropRate << std::endl;
-        }
+    Simulator::Stop (Seconds (50.0));
+    perf.Run ();
+    if (tracer)
+    {
+        tracer->Finish ();
+    }
+    if (capture)
+    {
+        capture->Finish ();
     }
 
+    ReportFlow ("Scenario1", tcpVariant, cbrRateMbps, probe, 8080, Seconds (1.0));
+    ReportTimeline (timeline.get (), "Scenario1", tcpVariant, cbrRateMbps);
+    g_perfLog.Append ("Scenario1", tcpVariant, cbrRateMbps, perf.Finish (probe.GetPacketsSeen ()));
+
     Simulator::Destroy ();
 }
 
 void RunScenario2 (const std::string& tcpVariant, double cbrRateMbps)
 {
+    PerfCounters perf;
+    perf.Begin ();
+
     NodeContainer nodes;
     nodes.Create (9);
 
@@ -116,6 +349,8 @@ void RunScenario2 (const std::string& tcpVariant, double cbrRateMbps)
     link(0,2); link(1,2); link(2,3); link(2,4); link(2,5);
     link(3,6); link(4,6); link(5,6); link(6,7); link(6,8);
 
+    Config::SetDefault ("ns3::TcpL4Protocol::SocketType", TypeIdValue (GetTcpVariant (tcpVariant)));
+
     InternetStackHelper stack;
     stack.Install (nodes);
 
@@ -129,309 +364,1880 @@ void RunScenario2 (const std::string& tcpVariant, double cbrRateMbps)
         interfaces.push_back (address.Assign (d));
     }
 
+    perf.BeginRouting ();
     Ipv4GlobalRoutingHelper::PopulateRoutingTables ();
+    perf.EndRouting ();
 
-    Config::SetDefault ("ns3::TcpL4Protocol::SocketType", TypeIdValue (GetTcpVariant (tcpVariant)));
-
-    BulkSendHelper tcp1 ("ns3::TcpSocketFactory",
-        InetSocketAddress (nodes.Get (7)->GetObject<Ipv4>()->GetAddress (1,0).GetLocal (), 8080));
-    tcp1.SetAttribute ("MaxBytes", UintegerValue (0));
-    tcp1.Install (nodes.Get (0)).Start (Seconds (1.0));
+    // Flow 1 runs the swept variant, flow 2 Vegas; each sender socket gets its own
+    // congestion control, and so does the receiving node.
+    ApplicationContainer tcpApp1 (InstallFlowSender (nodes.Get (0),
+        InetSocketAddress (nodes.Get (7)->GetObject<Ipv4>()->GetAddress (1,0).GetLocal (), 8080), tcpVariant));
+    tcpApp1.Start (Seconds (1.0));
 
     PacketSinkHelper sink1 ("ns3::TcpSocketFactory",
         InetSocketAddress (Ipv4Address::GetAny (), 8080));
-    sink1.Install (nodes.Get (7)).Start (Seconds (0.0));
-
-    // Now override TCP variant for Flow 2 to Vegas
-    Config::SetDefault ("ns3::TcpL4Protocol::SocketType", TypeIdValue (TcpVegas::GetTypeId()));
+    ApplicationContainer sinkApp1 = sink1.Install (nodes.Get (7));
+    sinkApp1.Start (Seconds (0.0));
 
-    BulkSendHelper tcp2 ("ns3::TcpSocketFactory",
-        InetSocketAddress (nodes.Get (8)->GetObject<Ipv4>()->GetAddress (1,0).GetLocal (), 8081));
-    tcp2.SetAttribute ("MaxBytes", UintegerValue (0));
-    tcp2.Install (nodes.Get (1)).Start (Seconds (1.0));
+    ApplicationContainer tcpApp2 (InstallFlowSender (nodes.Get (1),
+        InetSocketAddress (nodes.Get (8)->GetObject<Ipv4>()->GetAddress (1,0).GetLocal (), 8081), "TcpVegas"));
+    tcpApp2.Start (Seconds (1.0));
+    SetNodeTcpVariant (nodes.Get (8), "TcpVegas");
 
     PacketSinkHelper sink2 ("ns3::TcpSocketFactory",
         InetSocketAddress (Ipv4Address::GetAny (), 8081));
-    sink2.Install (nodes.Get (8)).Start (Seconds (0.0));
-
-    // Restore global socket type if needed
-    Config::SetDefault ("ns3::TcpL4Protocol::SocketType", TypeIdValue (GetTcpVariant (tcpVariant)));
+    ApplicationContainer sinkApp2 = sink2.Install (nodes.Get (8));
+    sinkApp2.Start (Seconds (0.0));
 
     OnOffHelper udp ("ns3::UdpSocketFactory",
         InetSocketAddress (nodes.Get (7)->GetObject<Ipv4>()->GetAddress (1,0).GetLocal (), 9000));
-    udp.SetAttribute ("DataRate", DataRateValue (DataRate (std::to_string (int(cbrRateMbps)) + "Mbps")));
+    udp.SetAttribute ("DataRate", DataRateValue (DataRate (uint64_t (cbrRateMbps * 1e6))));
     udp.SetAttribute ("PacketSize", UintegerValue (950));
     udp.SetAttribute ("StartTime", TimeValue (Seconds (1.0)));
     udp.SetAttribute ("StopTime", TimeValue (Seconds (100.0)));
     udp.Install (nodes.Get (1));
 
-    FlowMonitorHelper flowmon;
-    Ptr<FlowMonitor> monitor = flowmon.InstallAll ();
+    EndpointFlowProbe probe;
+    InstallFlowProbe (probe, tcpApp1.Get (0), sinkApp1.Get (0), devs[8].Get (0), 8080, Seconds (1.0));
 
-    Simulator::Stop (Seconds (100.0));
-    Simulator::Run ();
+    std::unique_ptr<FlowTracer> tracer = MakeFlowTracer ("Scenario2", tcpVariant, cbrRateMbps);
+    if (tracer)
+    {
+        tracer->AddFlow ("8080", tcpApp1.Get (0), sinkApp1.Get (0), Seconds (1.0));
+        tracer->AddFlow ("8081", tcpApp2.Get (0), sinkApp2.Get (0), Seconds (1.0));
+        tracer->Start (Seconds (1.0));
+    }
+    std::unique_ptr<PacketCapture> capture = MakePacketCapture ("Scenario2", tcpVariant, cbrRateMbps, devs[8].Get (0));
+    std::unique_ptr<Timeline> timeline = MakeTimeline (
+        GlobalRoutingHooks (devs[8].Get (0), nodes.Get (0), nodes.Get (7), tcpVariant), tcpApp1.Get (0),
+        sinkApp1.Get (0), Seconds (1.0), cbrRateMbps, 2);
 
-    Ptr<Ipv4FlowClassifier> classifier = DynamicCast<Ipv4FlowClassifier> (flowmon.GetClassifier());
-    auto stats = monitor->GetFlowStats();
+    std::unique_ptr<ConvergenceMonitor> convergence = MakeConvergenceMonitor (probe, Seconds (1.0));
 
-    for (auto& entry : stats)
+    if (g_perfLog.IsOpen ())
     {
-        auto fiveTuple = classifier->FindFlow (entry.first);
-        if (fiveTuple.destinationPort == 8080)
-        {
-            double throughput = entry.second.rxBytes * 8.0 / (99.0 * 1e6);
-            double avgRttMs = entry.second.delaySum.GetSeconds () * 1000.0 / entry.second.rxPackets;
-            double dropRate = (entry.second.txPackets - entry.second.rxPackets) / (double)entry.second.txPackets;
+        perf.CountLinks ();
+    }
 
-            std::cout << "Scenario2," << tcpVariant
-                      << ", " << cbrRateMbps
-                      << ", " << throughput
-                      << ", " << avgRttMs
-                      << ", " << dropRate << std::endl;
-        }
+    Simulator::Stop (Seconds (100.0));
+    perf.Run ();
+    if (tracer)
+    {
+        tracer->Finish ();
     }
+    if (capture)
+    {
+        capture->Finish ();
+    }
+
+    ReportFlow ("Scenario2", tcpVariant, cbrRateMbps, probe, 8080, Seconds (1.0));
+    ReportTimeline (timeline.get (), "Scenario2", tcpVariant, cbrRateMbps);
+    g_perfLog.Append ("Scenario2", tcpVariant, cbrRateMbps, perf.Finish (probe.GetPacketsSeen ()));
 
     Simulator::Destroy ();
 }
 
-void RunScenario3(const std::string& tcpVariant, double cbrRateMbps)
+// Everything a dumbbell run needs after setup, so a warm-up snapshot can retarget
+// the network it already built.
+struct Dumbbell
 {
     NodeContainer senders, receivers, routers;
-    senders.Create(4);
-    receivers.Create(4);
-    routers.Create(2); // RouterLeft, RouterRight
+    ApplicationContainer cbrApps;
+    bool bursty = false;            // the CBR senders are on half of the time
+    Ptr<Application> tcpSender, tcpSink;
+    Ptr<NetDevice> bottleneck;
+    EndpointFlowProbe probe;
+    BottleneckQueue queue;
+    std::unique_ptr<FlowTracer> tracer;
+    std::unique_ptr<PacketCapture> capture;
+    std::unique_ptr<Timeline> timeline;
+    std::unique_ptr<ConvergenceMonitor> convergence;
+    PerfCounters perf;
+};
+
+const double kDumbbellTcpStart = 1.0;
+const double kDumbbellStop = 100.0;
+
+void SetCbrRate(ApplicationContainer apps, double cbrRateMbps)
+{
+    for (auto it = apps.Begin(); it != apps.End(); ++it)
+    {
+        (*it)->SetAttribute("DataRate", DataRateValue(DataRate(uint64_t(cbrRateMbps * 1e6))));
+    }
+}
+
+// Access link delay of sender i: the --accessDelays entries in turn, or fallback
+// without them.
+Time SenderAccessDelay(uint32_t i, Time fallback)
+{
+    const std::vector<Time>& delays = g_options.accessDelays;
+    return delays.empty() ? fallback : delays[i % delays.size()];
+}
+
+// Label of a dumbbell scenario run with the given bottleneck AQM.
+std::string DumbbellLabel(const std::string& scenario, const std::string& aqm)
+{
+    return IsDefaultAqm(aqm) ? scenario : scenario + "-" + aqm;
+}
+
+// The CBR sources start at 1 s, or at the warm-up time if that is later, so that
+// the traffic before a warm-up point does not depend on the point's rate.
+void BuildDumbbell(Dumbbell& d, const std::string& tcpVariant, double cbrRateMbps, bool bursty,
+                   const std::string& aqm, double warmupSec = 0.0)
+{
+    d.perf.Begin();
+    d.bursty = bursty;
+
+    d.senders.Create(4);
+    d.receivers.Create(4);
+    d.routers.Create(2); // RouterLeft, RouterRight
 
     PointToPointHelper accessLink;
     accessLink.SetDeviceAttribute("DataRate", StringValue("100Mbps"));
-    accessLink.SetChannelAttribute("Delay", StringValue("2ms"));
 
     PointToPointHelper bottleneck;
     bottleneck.SetDeviceAttribute("DataRate", StringValue("10Mbps"));
     bottleneck.SetChannelAttribute("Delay", StringValue("10ms"));
 
+    Config::SetDefault("ns3::TcpL4Protocol::SocketType", TypeIdValue(GetTcpVariant(tcpVariant)));
+
     InternetStackHelper stack;
     stack.InstallAll();
 
     Ipv4AddressHelper address;
     int subnet = 1;
 
-    auto connect = [&](Ptr<Node> a, Ptr<Node> b) {
-        NetDeviceContainer d = accessLink.Install(NodeContainer(a, b));
+    auto connect = [&](Ptr<Node> a, Ptr<Node> b, Time delay) {
+        accessLink.SetChannelAttribute("Delay", TimeValue(delay));
+        NetDeviceContainer dev = accessLink.Install(NodeContainer(a, b));
         std::ostringstream subnetStr;
         subnetStr << "10.5." << subnet++ << ".0";
         address.SetBase(subnetStr.str().c_str(), "255.255.255.0");
-        return address.Assign(d);
+        return address.Assign(dev);
     };
 
     for (int i = 0; i < 4; ++i)
     {
-        connect(senders.Get(i), routers.Get(0));
-        connect(receivers.Get(i), routers.Get(1));
+        connect(d.senders.Get(i), d.routers.Get(0), SenderAccessDelay(i, MilliSeconds(2)));
+        connect(d.receivers.Get(i), d.routers.Get(1), MilliSeconds(2));
     }
 
-    NetDeviceContainer bottleneckDev = bottleneck.Install(NodeContainer(routers.Get(0), routers.Get(1)));
+    NetDeviceContainer bottleneckDev = bottleneck.Install(NodeContainer(d.routers.Get(0), d.routers.Get(1)));
     address.SetBase("10.5.100.0", "255.255.255.0");
     address.Assign(bottleneckDev);
+    d.bottleneck = bottleneckDev.Get(0);
+    BottleneckQueueOptions queue = g_options.queue;
+    queue.aqm = aqm;
+    d.queue.Install(d.bottleneck, queue);
 
+    d.perf.BeginRouting();
     Ipv4GlobalRoutingHelper::PopulateRoutingTables();
+    d.perf.EndRouting();
 
-    Config::SetDefault("ns3::TcpL4Protocol::SocketType", TypeIdValue(GetTcpVariant(tcpVariant)));
     Config::SetDefault("ns3::TcpSocket::SegmentSize", UintegerValue(1000));
     Config::SetDefault("ns3::TcpSocket::SndBufSize", UintegerValue(1 << 20));
     Config::SetDefault("ns3::TcpSocket::RcvBufSize", UintegerValue(1 << 20));
 
     // TCP: Sender 0 -> Receiver 0
     BulkSendHelper tcp("ns3::TcpSocketFactory",
-        InetSocketAddress(receivers.Get(0)->GetObject<Ipv4>()->GetAddress(1, 0).GetLocal(), 8080));
+        InetSocketAddress(d.receivers.Get(0)->GetObject<Ipv4>()->GetAddress(1, 0).GetLocal(), 8080));
     tcp.SetAttribute("MaxBytes", UintegerValue(0));
     tcp.SetAttribute("SendSize", UintegerValue(1000));
-    tcp.Install(senders.Get(0)).Start(Seconds(1.0));
+    d.tcpSender = tcp.Install(d.senders.Get(0)).Get(0);
+    d.tcpSender->SetStartTime(Seconds(kDumbbellTcpStart));
 
     PacketSinkHelper sink("ns3::TcpSocketFactory",
         InetSocketAddress(Ipv4Address::GetAny(), 8080));
-    sink.Install(receivers.Get(0)).Start(Seconds(0.0));
+    d.tcpSink = sink.Install(d.receivers.Get(0)).Get(0);
+    d.tcpSink->SetStartTime(Seconds(0.0));
 
-    // Background UDP: Sender 1 → Receiver 1, 2, 3
+    // Background UDP: Sender 1–3 → Receiver 1–3, constant or bursty on/off
     for (int i = 1; i < 4; ++i)
     {
         OnOffHelper udp("ns3::UdpSocketFactory",
-            InetSocketAddress(receivers.Get(i)->GetObject<Ipv4>()->GetAddress(1, 0).GetLocal(), 9000 + i));
-        udp.SetAttribute("DataRate", DataRateValue(DataRate(std::to_string(int(cbrRateMbps)) + "Mbps")));
+            InetSocketAddress(d.receivers.Get(i)->GetObject<Ipv4>()->GetAddress(1, 0).GetLocal(), 9000 + i));
         udp.SetAttribute("PacketSize", UintegerValue(950));
-        udp.SetAttribute("StartTime", TimeValue(Seconds(1.0)));
-        udp.SetAttribute("StopTime", TimeValue(Seconds(100.0)));
-        udp.Install(senders.Get(i));
+        if (bursty)
+        {
+            udp.SetAttribute("OnTime", StringValue("ns3::UniformRandomVariable[Min=0.5|Max=1.5]"));
+            udp.SetAttribute("OffTime", StringValue("ns3::UniformRandomVariable[Min=0.5|Max=1.5]"));
+        }
+        udp.SetAttribute("StartTime", TimeValue(Seconds(std::max(1.0, warmupSec))));
+        udp.SetAttribute("StopTime", TimeValue(Seconds(kDumbbellStop)));
+        d.cbrApps.Add(udp.Install(d.senders.Get(i)));
+    }
+    SetCbrRate(d.cbrApps, cbrRateMbps);
+
+    InstallFlowProbe(d.probe, d.tcpSender, d.tcpSink, d.bottleneck, 8080, Seconds(kDumbbellTcpStart));
+    if (g_perfLog.IsOpen())
+    {
+        d.perf.CountLinks();
+    }
+}
+
+// Retargets a dumbbell at its warm-up time. The variant can only change while no
+// TCP socket exists yet; later warm-ups keep the variant the topology was built with.
+void ApplyWarmPoint(Dumbbell& d, const std::string& tcpVariant, double cbrRateMbps, double warmupSec)
+{
+    if (warmupSec <= kDumbbellTcpStart)
+    {
+        Config::Set("/NodeList/*/$ns3::TcpL4Protocol/SocketType", TypeIdValue(GetTcpVariant(tcpVariant)));
+    }
+    SetCbrRate(d.cbrApps, cbrRateMbps);
+}
+
+// Attaches the per-point tracer, capture and convergence monitor, after any warm-up
+// snapshot, and schedules the event timeline, which has to lie after the warm-up.
+// Tracing only observes the run, so it can start in a warm-up child as long as the
+// traced flow has not started yet.
+void StartDumbbellObservers(Dumbbell& d, const std::string& scenario, const std::string& tcpVariant, double cbrRateMbps)
+{
+    d.convergence = MakeConvergenceMonitor(d.probe, Seconds(kDumbbellTcpStart));
+    d.tracer = MakeFlowTracer(scenario, tcpVariant, cbrRateMbps);
+    if (d.tracer)
+    {
+        NS_ABORT_MSG_IF(Simulator::Now() > Seconds(kDumbbellTcpStart), "Tracing needs a warm-up before the TCP start");
+        d.tracer->AddFlow("8080", d.tcpSender, d.tcpSink, Seconds(kDumbbellTcpStart));
+        d.tracer->Start(Seconds(kDumbbellTcpStart));
+        d.queue.Trace(TracePath(scenario, tcpVariant, cbrRateMbps, "-queue.csv"), g_options.traceInterval,
+                      Seconds(kDumbbellTcpStart));
+    }
+    d.capture = MakePacketCapture(scenario, tcpVariant, cbrRateMbps, d.bottleneck);
+    // Three CBR senders, on half of the time when bursty.
+    double cbrMbps = (d.bursty ? 1.5 : 3.0) * cbrRateMbps;
+    d.timeline = MakeTimeline(GlobalRoutingHooks(d.bottleneck, d.senders.Get(0), d.receivers.Get(0), tcpVariant),
+                              d.tcpSender, d.tcpSink, Seconds(kDumbbellTcpStart), cbrMbps, 1);
+}
+
+// Completes the trace and capture files once the run is over.
+void FinishDumbbellObservers(Dumbbell& d)
+{
+    if (d.tracer)
+    {
+        d.tracer->Finish();
+    }
+    if (d.capture)
+    {
+        d.capture->Finish();
     }
+}
+
+void ReportDumbbell(Dumbbell& d, const std::string& scenario, const std::string& tcpVariant, double cbrRateMbps)
+{
+    FlowPath path;
+    path.baseRttMs = 2 * (SenderAccessDelay(0, MilliSeconds(2)) + MilliSeconds(12)).GetSeconds() * 1000;
+    path.hops = 1;
+    ReportFlow(scenario, tcpVariant, cbrRateMbps, d.probe, 8080, Seconds(kDumbbellTcpStart), &d.queue, path);
+    g_perfLog.Append(scenario, tcpVariant, cbrRateMbps, d.perf.Finish(d.probe.GetPacketsSeen()));
+    ReportTimeline(d.timeline.get(), scenario, tcpVariant, cbrRateMbps);
+}
+
+// Cold run of one dumbbell point. With a warm-up time the variant and rate are
+// applied by an event at that time, scheduled exactly where the warm-up snapshot
+// schedules its stop. The CBR sources only start at the warm-up time, after that
+// event, so both paths process identical event sequences.
+void RunDumbbell(const std::string& scenario, const std::string& tcpVariant, double cbrRateMbps,
+                 bool bursty, double warmupSec, const std::string& aqm = "Default")
+{
+    Dumbbell d;
+    BuildDumbbell(d, tcpVariant, cbrRateMbps, bursty, aqm, warmupSec);
+    StartDumbbellObservers(d, scenario, tcpVariant, cbrRateMbps);
+
+    if (warmupSec > 0)
+    {
+        Simulator::Schedule(Seconds(warmupSec), [&d, tcpVariant, cbrRateMbps, warmupSec]() {
+            ApplyWarmPoint(d, tcpVariant, cbrRateMbps, warmupSec);
+        });
+    }
+    Simulator::Stop(Seconds(kDumbbellStop));
+    d.perf.Run();
+    FinishDumbbellObservers(d);
+
+    ReportDumbbell(d, scenario, tcpVariant, cbrRateMbps);
+
+    Simulator::Destroy();
+}
+
+void RunScenario3(const std::string& tcpVariant, double cbrRateMbps, double warmupSec = 0.0)
+{
+    RunDumbbell("Scenario3" + g_options.accessLabel, tcpVariant, cbrRateMbps, false, warmupSec);
+}
 
-    FlowMonitorHelper flowmon;
-    Ptr<FlowMonitor> monitor = flowmon.InstallAll();
+void RunScenario4(const std::string& tcpVariant, double cbrRateMbps, double warmupSec = 0.0)
+{
+    RunDumbbell("Scenario4" + g_options.accessLabel, tcpVariant, cbrRateMbps, true, warmupSec);
+}
+
+// Builds the dumbbell once, simulates it up to the warm-up time and then forks one
+// copy-on-write child per (variant, rate) point that only simulates the remainder.
+// Points already in the results store are reprinted instead. Returns the number of
+// points that failed.
+size_t RunDumbbellWarmSweep(const std::string& scenario, bool bursty, const std::vector<std::string>& variants,
+                          const std::vector<int>& rates, double warmupSec, const SweepOptions& sweep,
+                          const std::string& aqm)
+{
+    NS_ABORT_MSG_IF(warmupSec <= 0 || warmupSec >= kDumbbellStop, "Warm-up must lie inside the run: " << warmupSec);
+    NS_ABORT_MSG_IF(warmupSec > kDumbbellTcpStart && variants.size() > 1,
+                    "Warm-ups past the TCP start can only share one variant");
 
-    Simulator::Stop(Seconds(100.0));
-    Simulator::Run();
+    bool allStored = g_results.IsOpen();
+    for (const auto& variant : variants)
+    {
+        for (int rate : rates)
+        {
+            allStored = allStored && g_results.Contains(ConfigKey(scenario, variant, rate));
+        }
+    }
+    if (allStored)
+    {
+        for (const auto& variant : variants)
+        {
+            for (int rate : rates)
+            {
+                for (const auto& r : g_results.Lookup(ConfigKey(scenario, variant, rate)))
+                {
+                    PrintCsvRow(std::cout, r);
+                }
+            }
+        }
+        return 0;
+    }
 
-    Ptr<Ipv4FlowClassifier> classifier = DynamicCast<Ipv4FlowClassifier>(flowmon.GetClassifier());
-    auto stats = monitor->GetFlowStats();
+    Dumbbell d;
+    BuildDumbbell(d, variants.front(), rates.front(), bursty, aqm, warmupSec);
 
-    for (auto& entry : stats) {
-        auto fiveTuple = classifier->FindFlow(entry.first);
-        if (fiveTuple.destinationPort == 8080) {
-            double throughput = entry.second.rxBytes * 8.0 / (99.0 * 1e6);
-            double avgRttMs = (entry.second.rxPackets > 0) ? entry.second.delaySum.GetSeconds() * 1000.0 / entry.second.rxPackets : -1.0;
-            double dropRate = (entry.second.txPackets > 0) ? (entry.second.txPackets - entry.second.rxPackets) / (double)entry.second.txPackets : 1.0;
+    Simulator::Stop(Seconds(warmupSec));
+    Simulator::Stop(Seconds(kDumbbellStop));
+    d.perf.Run();
 
-            std::cout << "Scenario3," << tcpVariant
-                      << ", " << cbrRateMbps
-                      << ", " << throughput
-                      << ", " << avgRttMs
-                      << ", " << dropRate << std::endl;
+    std::vector<SweepJob> points;
+    for (const auto& variant : variants)
+    {
+        for (int rate : rates)
+        {
+            SweepJob point {scenario + "/" + variant + "/" + std::to_string(rate), double(rate),
+                              [&d, scenario, variant, rate, warmupSec]() {
+                                  StartDumbbellObservers(d, scenario, variant, rate);
+                                  ApplyWarmPoint(d, variant, rate, warmupSec);
+                                  d.perf.ResetPeaks();
+                                  d.perf.Run();
+                                  FinishDumbbellObservers(d);
+                                  ReportDumbbell(d, scenario, variant, rate);
+                                  Simulator::Destroy();
+                              }};
+            ResumeFromStore(point, g_results, ConfigKey(scenario, variant, rate));
+            points.push_back(point);
         }
     }
 
+    SweepOptions forked = sweep;
+    forked.workers = std::max(1u, sweep.workers);
+    size_t failed = RunSweep(points, forked);
+
     Simulator::Destroy();
+    return failed;
+}
+
+
+// Items of a comma-separated list.
+std::vector<std::string> SplitList (const std::string& list)
+{
+    std::vector<std::string> items;
+    std::istringstream ss (list);
+    std::string item;
+    while (std::getline (ss, item, ','))
+    {
+        if (!item.empty ())
+        {
+            items.push_back (item);
+        }
+    }
+    return items;
+}
+
+// Rough relative cost of one run: simulated seconds scaled by the offered cross traffic.
+double EstimateCost (double simSeconds, int udpFlows, double cbrRateMbps)
+{
+    return simSeconds * (1.0 + udpFlows * cbrRateMbps / 10.0);
+}
+
+// Fluid counterparts of Scenarios 1-4: the same links, routes, queues and traffic,
+// evaluated with the fluid model instead of packets. Every link keeps the FqCoDel
+// queue disc the address helper installs, except a non-default dumbbell bottleneck.
+FluidLink FluidP2p (double capacityMbps, double delayMs)
+{
+    FluidLink link;
+    link.capacityBps = capacityMbps * 1e6;
+    link.delaySec = delayMs / 1000;
+    link.ecn = g_options.queue.ecn;
+    return link;
+}
+
+FluidFlow FluidTcp (const std::string& tcpVariant, std::vector<size_t> path, double segmentBytes, double bufferBytes)
+{
+    FluidFlow flow;
+    flow.variant = tcpVariant;
+    flow.path = path;
+    flow.packetBytes = segmentBytes;
+    flow.maxWindowBytes = bufferBytes;
+    flow.ecn = g_options.queue.ecn || tcpVariant == "TcpDctcp";
+    return flow;
+}
+
+FluidFlow FluidCbr (std::vector<size_t> path, double cbrRateMbps, double stopSec)
+{
+    FluidFlow flow;
+    flow.variant = "CBR";
+    flow.path = path;
+    flow.packetBytes = 950;
+    flow.headerBytes = 28;
+    flow.cbrRateBps = cbrRateMbps * 1e6;
+    flow.stopSec = stopSec;
+    return flow;
+}
+
+// Prediction for the measured flow of a Scenario 1-4 point; label is the scenario
+// with its AQM suffix, as in the result rows.
+ResultRecord PredictScenario (const std::string& label, const std::string& tcpVariant, double cbrRateMbps)
+{
+    std::string scenario = label.substr (0, label.find ('-'));
+    std::string aqm = label.find ('-') == std::string::npos ? "Default" : label.substr (label.find ('-') + 1);
+    FluidNetwork net;
+    double stopSec;
+    if (scenario == "Scenario1")
+    {
+        // 0 -> 2 -> 3 -> 4 with the CBR source on 1 -> 2.
+        size_t l02 = net.AddLink (FluidP2p (10, 10));
+        size_t l12 = net.AddLink (FluidP2p (10, 10));
+        size_t l23 = net.AddLink (FluidP2p (10, 10));
+        size_t l34 = net.AddLink (FluidP2p (10, 10));
+        net.AddFlow (FluidTcp (tcpVariant, {l02, l23, l34}, 536, 131072));
+        net.AddFlow (FluidCbr ({l12, l23, l34}, cbrRateMbps, 50));
+        stopSec = 50;
+    }
+    else if (scenario == "Scenario2")
+    {
+        // Global routing puts every flow through node 3, the first of the equal-cost
+        // paths from 2 to 6.
+        size_t l02 = net.AddLink (FluidP2p (10, 10));
+        size_t l12 = net.AddLink (FluidP2p (10, 10));
+        size_t l23 = net.AddLink (FluidP2p (10, 10));
+        size_t l36 = net.AddLink (FluidP2p (10, 10));
+        size_t l67 = net.AddLink (FluidP2p (10, 10));
+        size_t l68 = net.AddLink (FluidP2p (10, 10));
+        net.AddFlow (FluidTcp (tcpVariant, {l02, l23, l36, l67}, 536, 131072));
+        net.AddFlow (FluidTcp ("TcpVegas", {l12, l23, l36, l68}, 536, 131072));
+        net.AddFlow (FluidCbr ({l12, l23, l36, l67}, cbrRateMbps, 100));
+        stopSec = 100;
+    }
+    else
+    {
+        NS_ABORT_MSG_IF (scenario != "Scenario3" && scenario != "Scenario4", "No fluid model of " << label);
+        FluidLink bottleneck = FluidP2p (10, 10);
+        if (!IsDefaultAqm (aqm))
+        {
+            // BottleneckQueue's queue disc on a one-packet device queue.
+            bottleneck.aqm = aqm;
+            bottleneck.devicePackets = 1;
+            bottleneck.limitPackets = std::stod (g_options.queue.limit);
+            bottleneck.markThreshold = g_options.queue.markThreshold;
+        }
+        size_t core = net.AddLink (bottleneck);
+        for (int i = 0; i < 4; ++i)
+        {
+            size_t up = net.AddLink (FluidP2p (100, 2));
+            size_t down = net.AddLink (FluidP2p (100, 2));
+            if (i == 0)
+            {
+                net.AddFlow (FluidTcp (tcpVariant, {up, core, down}, 1000, 1 << 20));
+                continue;
+            }
+            FluidFlow cbr = FluidCbr ({up, core, down}, cbrRateMbps, kDumbbellStop);
+            if (scenario == "Scenario4")
+            {
+                // On and off for 1 s on average, staggered instead of random.
+                cbr.onSec = 1;
+                cbr.offSec = 1;
+                cbr.phaseSec = (i - 1) * 2.0 / 3;
+            }
+            net.AddFlow (cbr);
+        }
+        stopSec = kDumbbellStop;
+    }
+
+    FluidFlowResult flow = net.Run (stopSec).front ();
+    ResultRecord r;
+    r.key = ConfigKey ("Fluid-" + label, tcpVariant, cbrRateMbps);
+    r.flow = "fluid";
+    r.throughputMbps = flow.throughputMbps;
+    r.avgRttMs = flow.delayMs;
+    r.dropRate = flow.dropRate;
+    r.stopTimeSec = stopSec;
+    return r;
+}
+
+// Relative error, or the absolute one where the measured value is near zero.
+double FluidError (double fluid, double measured, double floor)
+{
+    return std::fabs (fluid - measured) / std::max (std::fabs (measured), floor);
+}
+
+// Compares the fluid prediction of every measured Scenario 1-4 row, one line per
+// point and the mean errors per scenario.
+void PrintFluidValidation (std::ostream& os, const std::vector<ResultRecord>& measured)
+{
+    os << "Scenario,Variant,CBR(Mbps),Throughput(Mbps),FluidThroughput(Mbps),AvgRTT(ms),FluidAvgRTT(ms),DropRate,"
+          "FluidDropRate,FluidMs\n";
+    std::map<std::string, std::vector<double>> errors;   // scenario -> throughput, delay, drop sums and count
+    for (const auto& m : measured)
+    {
+        auto start = std::chrono::steady_clock::now ();
+        ResultRecord f = PredictScenario (m.key.scenario, m.key.variant, m.key.cbrRateMbps);
+        double ms = std::chrono::duration<double, std::milli> (std::chrono::steady_clock::now () - start).count ();
+        os << m.key.scenario << "," << m.key.variant << "," << m.key.cbrRateMbps << "," << m.throughputMbps << ","
+           << f.throughputMbps << "," << m.avgRttMs << "," << f.avgRttMs << "," << m.dropRate << "," << f.dropRate
+           << "," << ms << "\n";
+        std::vector<double>& e = errors[m.key.scenario];
+        e.resize (4, 0);
+        e[0] += FluidError (f.throughputMbps, m.throughputMbps, 0.1);
+        e[1] += FluidError (f.avgRttMs, m.avgRttMs, 1);
+        e[2] += std::fabs (f.dropRate - m.dropRate);
+        e[3] += 1;
+    }
+    for (const auto& e : errors)
+    {
+        os << "# fluid " << e.first << ": points=" << e.second[3] << " throughputError=" << e.second[0] / e.second[3]
+           << " delayError=" << e.second[1] / e.second[3] << " dropRateAbsError=" << e.second[2] / e.second[3] << "\n";
+    }
 }
 
-void RunScenario4(const std::string& tcpVariant, double cbrRateMbps)
+// Dumbbell of sender and receiver hosts around a 10 Mbps bottleneck, like the one of
+// Scenarios 3/4 but without applications, for scenarios that bring their own traffic.
+struct DumbbellFabric
 {
     NodeContainer senders, receivers, routers;
-    senders.Create(4);
-    receivers.Create(4);
-    routers.Create(2); // RouterLeft, RouterRight
+    Ptr<NetDevice> bottleneck;      // router 0 towards router 1
+    BottleneckQueue queue;
+};
+
+const double kFabricBottleneckMbps = 10.0;
+// Two access links of 2 ms and the 10 ms bottleneck, both ways.
+const double kFabricBaseRttMs = 28.0;
+
+// Links, frames and socket buffers of a dumbbell fabric; the defaults are those of
+// the fairness and workload runs.
+struct FabricProfile
+{
+    DataRate access = DataRate("100Mbps");
+    Time accessDelay = MilliSeconds(2);
+    DataRate bottleneck = DataRate(uint64_t(kFabricBottleneckMbps * 1e6));
+    Time bottleneckDelay = MilliSeconds(10);
+    uint32_t mtu = 1500;
+    uint32_t segmentSize = 1000;
+    uint32_t socketBuffer = 1 << 20;
+    std::string queueLimit;         // of a non-default bottleneck queue disc, --aqmLimit when empty
+    bool senderDelays = false;      // senders get --accessDelays instead of accessDelay
+};
+
+void BuildDumbbellFabric(DumbbellFabric& f, uint32_t pairs, const std::string& aqm, PerfCounters& perf,
+                         const FabricProfile& profile = FabricProfile())
+{
+    f.senders.Create(pairs);
+    f.receivers.Create(pairs);
+    f.routers.Create(2);
 
     PointToPointHelper accessLink;
-    accessLink.SetDeviceAttribute("DataRate", StringValue("100Mbps"));
-    accessLink.SetChannelAttribute("Delay", StringValue("2ms"));
+    accessLink.SetDeviceAttribute("DataRate", DataRateValue(profile.access));
+    accessLink.SetDeviceAttribute("Mtu", UintegerValue(profile.mtu));
+    accessLink.SetChannelAttribute("Delay", TimeValue(profile.accessDelay));
 
     PointToPointHelper bottleneck;
-    bottleneck.SetDeviceAttribute("DataRate", StringValue("10Mbps"));
-    bottleneck.SetChannelAttribute("Delay", StringValue("10ms"));
+    bottleneck.SetDeviceAttribute("DataRate", DataRateValue(profile.bottleneck));
+    bottleneck.SetDeviceAttribute("Mtu", UintegerValue(profile.mtu));
+    bottleneck.SetChannelAttribute("Delay", TimeValue(profile.bottleneckDelay));
 
     InternetStackHelper stack;
     stack.InstallAll();
 
     Ipv4AddressHelper address;
-    int subnet = 1;
+    for (uint32_t i = 0; i < pairs; ++i)
+    {
+        address.SetBase(("10.6." + std::to_string(2 * i + 1) + ".0").c_str(), "255.255.255.0");
+        accessLink.SetChannelAttribute("Delay", TimeValue(profile.senderDelays ? SenderAccessDelay(i, profile.accessDelay)
+                                                                               : profile.accessDelay));
+        address.Assign(accessLink.Install(f.senders.Get(i), f.routers.Get(0)));
+        accessLink.SetChannelAttribute("Delay", TimeValue(profile.accessDelay));
+        address.SetBase(("10.6." + std::to_string(2 * i + 2) + ".0").c_str(), "255.255.255.0");
+        address.Assign(accessLink.Install(f.receivers.Get(i), f.routers.Get(1)));
+    }
+    NetDeviceContainer bottleneckDev = bottleneck.Install(f.routers.Get(0), f.routers.Get(1));
+    address.SetBase("10.6.254.0", "255.255.255.0");
+    address.Assign(bottleneckDev);
+    f.bottleneck = bottleneckDev.Get(0);
+    BottleneckQueueOptions queue = g_options.queue;
+    queue.aqm = aqm;
+    queue.limit = profile.queueLimit.empty() ? queue.limit : profile.queueLimit;
+    f.queue.Install(f.bottleneck, queue);
 
-    auto connect = [&](Ptr<Node> a, Ptr<Node> b) {
-        NetDeviceContainer d = accessLink.Install(NodeContainer(a, b));
-        std::ostringstream subnetStr;
-        subnetStr << "10.5." << subnet++ << ".0";
-        address.SetBase(subnetStr.str().c_str(), "255.255.255.0");
-        return address.Assign(d);
-    };
+    perf.BeginRouting();
+    Ipv4GlobalRoutingHelper::PopulateRoutingTables();
+    perf.EndRouting();
 
-    for (int i = 0; i < 4; ++i)
+    Config::SetDefault("ns3::TcpSocket::SegmentSize", UintegerValue(profile.segmentSize));
+    Config::SetDefault("ns3::TcpSocket::SndBufSize", UintegerValue(profile.socketBuffer));
+    Config::SetDefault("ns3::TcpSocket::RcvBufSize", UintegerValue(profile.socketBuffer));
+}
+
+// Label of a fairness mix: its variants in flow order, e.g. TcpCubic+TcpBbr.
+std::string MixLabel(const std::vector<std::string>& mix)
+{
+    std::string label;
+    for (const auto& variant : mix)
     {
-        connect(senders.Get(i), routers.Get(0));
-        connect(receivers.Get(i), routers.Get(1));
+        label += (label.empty() ? "" : "+") + variant;
     }
+    return label;
+}
 
-    NetDeviceContainer bottleneckDev = bottleneck.Install(NodeContainer(routers.Get(0), routers.Get(1)));
-    address.SetBase("10.5.100.0", "255.255.255.0");
-    address.Assign(bottleneckDev);
+// One long-lived flow per entry of mix, each with its own congestion control, from
+// its own sender to its own receiver across the dumbbell bottleneck, without cross
+// traffic. Rows: every flow in mix order (flow = port), then a summary row with the
+// aggregate throughput, Jain's fairness index and the bottleneck utilisation.
+void RunFairnessMix(const std::string& scenario, const std::vector<std::string>& mix, const std::string& aqm)
+{
+    PerfCounters perf;
+    perf.Begin();
+    DumbbellFabric f;
+    FabricProfile profile;
+    profile.senderDelays = true;
+    BuildDumbbellFabric(f, mix.size(), aqm, perf, profile);
+
+    std::string label = MixLabel(mix);
+    EndpointFlowProbe probe;
+    probe.InstallBottleneck(f.bottleneck);
+    std::unique_ptr<FlowTracer> tracer = MakeFlowTracer(scenario, label, 0);
+    for (uint32_t i = 0; i < mix.size(); ++i)
+    {
+        uint16_t port = 8080 + i;
+        Ipv4Address remote = f.receivers.Get(i)->GetObject<Ipv4>()->GetAddress(1, 0).GetLocal();
+        Ptr<Application> sender = InstallFlowSender(f.senders.Get(i), InetSocketAddress(remote, port), mix[i], 1000);
+        sender->SetStartTime(Seconds(kDumbbellTcpStart));
+        SetNodeTcpVariant(f.receivers.Get(i), mix[i]);
+        PacketSinkHelper sink("ns3::TcpSocketFactory", InetSocketAddress(Ipv4Address::GetAny(), port));
+        Ptr<Application> sinkApp = sink.Install(f.receivers.Get(i)).Get(0);
+
+        probe.Install(f.senders.Get(i));
+        probe.Install(f.receivers.Get(i));
+        probe.TraceRtt(sender, Seconds(kDumbbellTcpStart), port);
+        if (tracer)
+        {
+            tracer->AddFlow(std::to_string(port), sender, sinkApp, Seconds(kDumbbellTcpStart));
+        }
+    }
+    if (tracer)
+    {
+        tracer->Start(Seconds(kDumbbellTcpStart));
+    }
+    std::unique_ptr<PacketCapture> capture = MakePacketCapture(scenario, label, 0, f.bottleneck);
+    if (g_perfLog.IsOpen())
+    {
+        perf.CountLinks();
+    }
 
-    Ipv4GlobalRoutingHelper::PopulateRoutingTables();
+    Simulator::Stop(Seconds(kDumbbellStop));
+    perf.Run();
+    if (tracer)
+    {
+        tracer->Finish();
+    }
+    if (capture)
+    {
+        capture->Finish();
+    }
+
+    double seconds = Simulator::Now().GetSeconds() - kDumbbellTcpStart;
+    double sum = 0;
+    double sumSquares = 0;
+    for (uint32_t i = 0; i < mix.size(); ++i)
+    {
+        uint16_t port = 8080 + i;
+        FlowPath path;
+        path.baseRttMs =
+            2 * (SenderAccessDelay(i, profile.accessDelay) + profile.bottleneckDelay + profile.accessDelay).GetSeconds() * 1000;
+        path.hops = 1;
+        ReportFlow(scenario, label, 0, probe, port, Seconds(kDumbbellTcpStart), &f.queue, path);
+        double mbps = 0;
+        for (const auto& flow : probe.GetFlows())
+        {
+            if (flow.first.protocol == 6 && flow.first.dstPort == port)
+            {
+                mbps += flow.second.rxBytes * 8.0 / (seconds * 1e6);
+            }
+        }
+        sum += mbps;
+        sumSquares += mbps * mbps;
+    }
+    ResultRecord r;
+    r.key = ConfigKey(scenario, label, 0);
+    r.flow = "mix";
+    r.throughputMbps = sum;
+    r.avgRttMs = -1;
+    r.dropRate = -1;
+    r.stopTimeSec = Simulator::Now().GetSeconds();
+    f.queue.Fill(r);
+    r.jainIndex = sumSquares > 0 ? sum * sum / (mix.size() * sumSquares) : 0;
+    r.utilization = sum / kFabricBottleneckMbps;
+    EmitResult(g_results, r);
+    g_perfLog.Append(scenario, label, 0, perf.Finish(probe.GetPacketsSeen()));
 
+    Simulator::Destroy();
+}
+
+// Runs every pairwise mix of variants (including a variant against itself), every mix
+// of 3 up to maxMix distinct variants and, with more than two variants, the mix of
+// all of them, once per bottleneck AQM. Rows go to the CSV; summary gets one line per
+// mix and, per AQM, the matrix of the throughput share the row variant got against
+// the column variant. Returns the failed mixes.
+size_t RunFairness(const std::vector<std::string>& variants, const std::vector<std::string>& aqms,
+                   uint32_t maxMix, const SweepOptions& sweep, std::ostream& summary)
+{
+    std::vector<std::vector<std::string>> mixes;
+    for (size_t a = 0; a < variants.size(); ++a)
+    {
+        for (size_t b = a; b < variants.size(); ++b)
+        {
+            mixes.push_back({variants[a], variants[b]});
+        }
+    }
+    for (size_t n = 3; n < variants.size() && n <= maxMix; ++n)
+    {
+        // Subsets in the order of the variant list, e.g. ABC, ABD, ACD, BCD.
+        std::vector<bool> pick(variants.size(), false);
+        std::fill(pick.begin(), pick.begin() + n, true);
+        do
+        {
+            std::vector<std::string> mix;
+            for (size_t i = 0; i < variants.size(); ++i)
+            {
+                if (pick[i])
+                {
+                    mix.push_back(variants[i]);
+                }
+            }
+            mixes.push_back(mix);
+        } while (std::prev_permutation(pick.begin(), pick.end()));
+    }
+    if (variants.size() > 2)
+    {
+        mixes.push_back(variants);
+    }
+
+    size_t failed = 0;
+    for (const auto& aqm : aqms)
+    {
+        std::string scenario = DumbbellLabel("Fairness", aqm) + g_options.accessLabel;
+        std::vector<SweepJob> jobs;
+        for (const auto& mix : mixes)
+        {
+            SweepJob job {scenario + "/" + MixLabel(mix), EstimateCost(kDumbbellStop, 0, 0) * mix.size(),
+                          [=]() { RunFairnessMix(scenario, mix, aqm); }};
+            ResumeFromStore(job, g_results, ConfigKey(scenario, MixLabel(mix), 0));
+            jobs.push_back(job);
+        }
+
+        // rows[m]: the flow rows of mix m followed by its summary row
+        std::vector<std::vector<ResultRecord>> rows(mixes.size());
+        failed += RunSweep(jobs, sweep, [&](size_t i, const SweepOutcome& outcome) {
+            std::cout << outcome.output << std::flush;
+            std::istringstream lines(outcome.output);
+            std::string line;
+            ResultRecord r;
+            while (std::getline(lines, line))
+            {
+                if (ParseCsvRow(line, r))
+                {
+                    rows[i].push_back(r);
+                }
+            }
+        });
+
+        summary << scenario << ",Mix,Flows,Throughputs(Mbps),JainIndex,Utilization\n";
+        std::map<std::pair<std::string, std::string>, double> share;
+        for (size_t m = 0; m < mixes.size(); ++m)
+        {
+            if (rows[m].size() != mixes[m].size() + 1)
+            {
+                continue;
+            }
+            const ResultRecord& total = rows[m].back();
+            summary << scenario << "," << MixLabel(mixes[m]) << "," << mixes[m].size() << ",";
+            for (size_t f = 0; f < mixes[m].size(); ++f)
+            {
+                summary << (f ? " " : "") << rows[m][f].throughputMbps;
+            }
+            summary << "," << total.jainIndex << "," << total.utilization << "\n";
+            if (mixes[m].size() == 2 && total.throughputMbps > 0)
+            {
+                share[{mixes[m][0], mixes[m][1]}] = rows[m][0].throughputMbps / total.throughputMbps;
+                share[{mixes[m][1], mixes[m][0]}] = rows[m][1].throughputMbps / total.throughputMbps;
+            }
+        }
+        summary << scenario << ",Share";
+        for (const auto& column : variants)
+        {
+            summary << "," << column;
+        }
+        summary << "\n";
+        for (const auto& row : variants)
+        {
+            summary << scenario << "," << row;
+            for (const auto& column : variants)
+            {
+                auto it = share.find({row, column});
+                summary << ",";
+                if (it != share.end())
+                {
+                    summary << it->second;
+                }
+            }
+            summary << "\n";
+        }
+    }
+    return failed;
+}
+
+// Data-center workload over the dumbbell: Poisson flows with sizes from the CDF file
+// and optional incast bursts, all from left-hand to right-hand hosts, with the load
+// relative to the bottleneck. New flows start until the workload's stop time; the
+// run goes on for another 10 s so that they can finish.
+void RunWorkloadDumbbell(const std::string& scenario, const std::string& tcpVariant, double load,
+                         const std::string& aqm)
+{
+    PerfCounters perf;
+    perf.Begin();
+    Config::SetDefault("ns3::TcpL4Protocol::SocketType", TypeIdValue(GetTcpVariant(tcpVariant)));
+    DumbbellFabric f;
+    BuildDumbbellFabric(f, g_options.workloadPairs, aqm, perf);
+
+    WorkloadOptions options = g_options.workload;
+    options.load = load;
+    DcWorkload workload;
+    workload.Install(f.senders, f.receivers, options, kFabricBottleneckMbps * 1e6,
+                     [](uint32_t, uint32_t, uint64_t bytes) {
+                         return MilliSeconds(kFabricBaseRttMs) + Seconds(bytes * 8.0 / (kFabricBottleneckMbps * 1e6));
+                     });
+    if (g_perfLog.IsOpen())
+    {
+        perf.CountLinks();
+    }
+
+    Simulator::Stop(options.stop + Seconds(10));
+    perf.Run();
+
+    g_fctLog.Append(scenario, tcpVariant, load, workload.Finish());
+    g_perfLog.Append(scenario, tcpVariant, load, perf.Finish(0));
+
+    Simulator::Destroy();
+}
+
+// Bottleneck buffer of a HighBandwidth run, bufferBdp bandwidth-delay products but
+// at least one frame.
+uint64_t HighBandwidthBufferBytes(double bufferBdp)
+{
+    const HighBandwidthOptions& o = g_options.highBandwidth;
+    double bdp = DataRate(o.rate).GetBitRate() / 8.0 * o.baseRtt.GetSeconds();
+    return std::max<uint64_t>(o.mtu, uint64_t(bufferBdp * bdp));
+}
+
+// HighBandwidth: flows of one variant share a dumbbell whose links all run at the
+// configured rate, with jumbo frames and senders that write whole batches, so that a
+// simulated second costs packets rather than socket calls. A Default AQM means a
+// FIFO of the swept size. Rows: every flow, then a summary row (flow "all") with the
+// aggregate throughput, Jain's index, the utilisation and the queue columns; the
+// rate column holds the buffer in BDPs.
+void RunHighBandwidth(const std::string& scenario, const std::string& tcpVariant, double bufferBdp,
+                      const std::string& aqm)
+{
+    const HighBandwidthOptions& o = g_options.highBandwidth;
+    uint64_t buffer = HighBandwidthBufferBytes(bufferBdp);
+    double bdp = DataRate(o.rate).GetBitRate() / 8.0 * o.baseRtt.GetSeconds();
+
+    PerfCounters perf;
+    perf.Begin();
+    Config::SetDefault("ns3::TcpL4Protocol::SocketType", TypeIdValue(GetTcpVariant(tcpVariant)));
+    FabricProfile profile;
+    profile.access = DataRate(o.rate);
+    profile.bottleneck = DataRate(o.rate);
+    // A quarter of the base RTT per access link and per bottleneck, each way.
+    profile.accessDelay = o.baseRtt / 8;
+    profile.bottleneckDelay = o.baseRtt / 4;
+    profile.mtu = o.mtu;
+    profile.segmentSize = o.mtu - 52;      // IPv4, TCP and the timestamp option
+    profile.socketBuffer = uint32_t(std::max(1.0 * (1 << 20), 2 * (bdp + buffer)));
+    profile.queueLimit = std::to_string(buffer) + "B";
+    DumbbellFabric f;
+    BuildDumbbellFabric(f, o.flows, IsDefaultAqm(aqm) ? "DropTail" : aqm, perf, profile);
+
+    Time start = MilliSeconds(1);
+    EndpointFlowProbe probe;
+    probe.InstallBottleneck(f.bottleneck);
+    for (uint32_t i = 0; i < o.flows; ++i)
+    {
+        uint16_t port = 8080 + i;
+        Ipv4Address remote = f.receivers.Get(i)->GetObject<Ipv4>()->GetAddress(1, 0).GetLocal();
+        Ptr<Application> sender =
+            InstallFlowSender(f.senders.Get(i), InetSocketAddress(remote, port), tcpVariant, o.sendSize);
+        sender->SetStartTime(start);
+        PacketSinkHelper sink("ns3::TcpSocketFactory", InetSocketAddress(Ipv4Address::GetAny(), port));
+        sink.Install(f.receivers.Get(i));
+        probe.Install(f.senders.Get(i));
+        probe.Install(f.receivers.Get(i));
+        probe.TraceRtt(sender, start, port);
+    }
+    if (g_perfLog.IsOpen())
+    {
+        perf.CountLinks();
+    }
+
+    Simulator::Stop(start + o.duration);
+    perf.Run();
+
+    double seconds = o.duration.GetSeconds();
+    double sum = 0;
+    double sumSquares = 0;
+    FlowProbeStats all;
+    for (uint32_t i = 0; i < o.flows; ++i)
+    {
+        uint16_t port = 8080 + i;
+        ReportFlow(scenario, tcpVariant, bufferBdp, probe, port, start, &f.queue);
+        for (const auto& flow : probe.GetFlows())
+        {
+            if (flow.first.protocol == 6 && flow.first.dstPort == port)
+            {
+                double mbps = flow.second.rxBytes * 8.0 / (seconds * 1e6);
+                sum += mbps;
+                sumSquares += mbps * mbps;
+                all.Merge(flow.second);
+            }
+        }
+    }
+    ResultRecord r;
+    r.key = ConfigKey(scenario, tcpVariant, bufferBdp);
+    r.flow = "all";
+    r.throughputMbps = sum;
+    r.avgRttMs = all.rxPackets > 0 ? all.delaySumNs / 1e6 / all.rxPackets : -1.0;
+    r.dropRate = DropRate(all.txPackets, all.rxPackets);
+    r.stopTimeSec = Simulator::Now().GetSeconds();
+    SetTailLatency(r, all, nullptr);
+    f.queue.Fill(r);
+    r.jainIndex = sumSquares > 0 ? sum * sum / (o.flows * sumSquares) : 0;
+    r.utilization = sum * 1e6 / DataRate(o.rate).GetBitRate();
+    EmitResult(g_results, r);
+    g_perfLog.Append(scenario, tcpVariant, bufferBdp, perf.Finish(probe.GetPacketsSeen()));
+
+    Simulator::Destroy();
+}
+
+// Buffer sizing: per HighBandwidth label and variant, the utilisation and queueing
+// delay of every buffer size, from the summary rows of the sweep.
+void PrintBufferSizing(std::ostream& os, const std::vector<ResultRecord>& rows)
+{
+    std::vector<ResultRecord> sorted = rows;
+    std::sort(sorted.begin(), sorted.end(), [](const ResultRecord& a, const ResultRecord& b) {
+        return std::tie(a.key.scenario, a.key.variant, a.key.cbrRateMbps) <
+               std::tie(b.key.scenario, b.key.variant, b.key.cbrRateMbps);
+    });
+    os << "Scenario,Variant,Buffer(BDP),Buffer(B),Throughput(Mbps),Utilization,JainIndex,SojournP50(ms),"
+          "SojournP99(ms),QueueDrops\n";
+    for (const auto& r : sorted)
+    {
+        os << r.key.scenario << "," << r.key.variant << "," << r.key.cbrRateMbps << ","
+           << HighBandwidthBufferBytes(r.key.cbrRateMbps) << "," << r.throughputMbps << "," << r.utilization << ","
+           << r.jainIndex << "," << r.sojournP50Ms << "," << r.sojournP99Ms << "," << r.queueDrops << "\n";
+    }
+}
+
+// ParkingLot: hopCount bottleneck hops in a chain of routers. The long flows enter at
+// the first router and leave at the last one; at every hop, cross flows enter at the
+// router before it and leave at the one after it. Every link gets a /30 of its own,
+// so the chain and the flows scale without an address plan. Rows: every flow (its
+// hops and base RTT filled in, queue columns of its first hop), then a summary row
+// (flow "all") with the aggregate throughput, Jain's index and the mean utilisation
+// of the hops; the rate column holds hopCount.
+void RunParkingLot(const std::string& scenario, const std::string& tcpVariant, double hopCount, const std::string& aqm)
+{
+    const ParkingLotOptions& o = g_options.parkingLot;
+    uint32_t hops = uint32_t(hopCount);
+    DataRate rate(o.rate);
+    DataRate access(rate.GetBitRate() * 10);
+
+    PerfCounters perf;
+    perf.Begin();
     Config::SetDefault("ns3::TcpL4Protocol::SocketType", TypeIdValue(GetTcpVariant(tcpVariant)));
     Config::SetDefault("ns3::TcpSocket::SegmentSize", UintegerValue(1000));
     Config::SetDefault("ns3::TcpSocket::SndBufSize", UintegerValue(1 << 20));
     Config::SetDefault("ns3::TcpSocket::RcvBufSize", UintegerValue(1 << 20));
 
-    // TCP: Sender 0 -> Receiver 0
-    BulkSendHelper tcp("ns3::TcpSocketFactory",
-        InetSocketAddress(receivers.Get(0)->GetObject<Ipv4>()->GetAddress(1, 0).GetLocal(), 8080));
-    tcp.SetAttribute("MaxBytes", UintegerValue(0));
-    tcp.SetAttribute("SendSize", UintegerValue(1000));
-    tcp.Install(senders.Get(0)).Start(Seconds(1.0));
+    // first, last: the routers a flow enters and leaves the chain at
+    std::vector<std::pair<uint32_t, uint32_t>> spans(o.longFlows, std::make_pair(0u, hops));
+    for (uint32_t h = 0; h < hops; ++h)
+    {
+        spans.insert(spans.end(), o.crossFlows, std::make_pair(h, h + 1));
+    }
+    uint32_t flows = spans.size();
 
-    PacketSinkHelper sink("ns3::TcpSocketFactory",
-        InetSocketAddress(Ipv4Address::GetAny(), 8080));
-    sink.Install(receivers.Get(0)).Start(Seconds(0.0));
+    NodeContainer routers, senders, receivers;
+    routers.Create(hops + 1);
+    senders.Create(flows);
+    receivers.Create(flows);
+    InternetStackHelper stack;
+    stack.InstallAll();
 
-    // Background bursty UDP traffic: Sender 1–3 → Receiver 1–3
-    for (int i = 1; i < 4; ++i)
+    PointToPointHelper p2p;
+    Ipv4AddressHelper address("10.0.0.0", "255.255.255.252");
+    auto connect = [&](Ptr<Node> a, Ptr<Node> b, DataRate linkRate, Time delay) {
+        p2p.SetDeviceAttribute("DataRate", DataRateValue(linkRate));
+        p2p.SetChannelAttribute("Delay", TimeValue(delay));
+        NetDeviceContainer devices = p2p.Install(a, b);
+        address.Assign(devices);
+        address.NewNetwork();
+        return devices;
+    };
+    BottleneckQueueOptions queue = g_options.queue;
+    queue.aqm = aqm;
+    std::vector<std::unique_ptr<BottleneckQueue>> queues;
+    for (uint32_t h = 0; h < hops; ++h)
     {
-        OnOffHelper udp("ns3::UdpSocketFactory",
-            InetSocketAddress(receivers.Get(i)->GetObject<Ipv4>()->GetAddress(1, 0).GetLocal(), 9000 + i));
-        udp.SetAttribute("DataRate", DataRateValue(DataRate(std::to_string(int(cbrRateMbps)) + "Mbps")));
-        udp.SetAttribute("PacketSize", UintegerValue(950));
-        udp.SetAttribute("OnTime", StringValue("ns3::UniformRandomVariable[Min=0.5|Max=1.5]"));
-        udp.SetAttribute("OffTime", StringValue("ns3::UniformRandomVariable[Min=0.5|Max=1.5]"));
-        udp.SetAttribute("StartTime", TimeValue(Seconds(1.0)));
-        udp.SetAttribute("StopTime", TimeValue(Seconds(100.0)));
-        udp.Install(senders.Get(i));
+        NetDeviceContainer devices = connect(routers.Get(h), routers.Get(h + 1), rate, o.hopDelay);
+        queues.push_back(std::make_unique<BottleneckQueue>());
+        queues.back()->Install(devices.Get(0), queue);
+    }
+    for (uint32_t i = 0; i < flows; ++i)
+    {
+        connect(senders.Get(i), routers.Get(spans[i].first), access, SenderAccessDelay(i, o.accessDelay));
+        connect(receivers.Get(i), routers.Get(spans[i].second), access, o.accessDelay);
     }
 
-    FlowMonitorHelper flowmon;
-    Ptr<FlowMonitor> monitor = flowmon.InstallAll();
-
-    Simulator::Stop(Seconds(100.0));
-    Simulator::Run();
+    perf.BeginRouting();
+    Ipv4GlobalRoutingHelper::PopulateRoutingTables();
+    perf.EndRouting();
 
-    Ptr<Ipv4FlowClassifier> classifier = DynamicCast<Ipv4FlowClassifier>(flowmon.GetClassifier());
-    auto stats = monitor->GetFlowStats();
+    Time start = Seconds(kDumbbellTcpStart);
+    // Staggered by a millisecond per flow so that the flows do not slow-start in lockstep.
+    auto flowStart = [start](uint32_t i) { return start + MilliSeconds(i % 100); };
+    EndpointFlowProbe probe;
+    for (uint32_t i = 0; i < flows; ++i)
+    {
+        uint16_t port = 8080 + i;
+        Ipv4Address remote = receivers.Get(i)->GetObject<Ipv4>()->GetAddress(1, 0).GetLocal();
+        Ptr<Application> sender = InstallFlowSender(senders.Get(i), InetSocketAddress(remote, port), tcpVariant, 1000);
+        sender->SetStartTime(flowStart(i));
+        PacketSinkHelper sink("ns3::TcpSocketFactory", InetSocketAddress(Ipv4Address::GetAny(), port));
+        sink.Install(receivers.Get(i));
+        probe.Install(senders.Get(i));
+        probe.Install(receivers.Get(i));
+        probe.TraceRtt(sender, flowStart(i), port);
+    }
+    if (g_perfLog.IsOpen())
+    {
+        perf.CountLinks();
+    }
 
-    for (auto& entry : stats) {
-        auto fiveTuple = classifier->FindFlow(entry.first);
-        if (fiveTuple.destinationPort == 8080) {
-            double throughput = entry.second.rxBytes * 8.0 / (99.0 * 1e6);
-            double avgRttMs = (entry.second.rxPackets > 0) ? entry.second.delaySum.GetSeconds() * 1000.0 / entry.second.rxPackets : -1.0;
-            double dropRate = (entry.second.txPackets > 0) ? (entry.second.txPackets - entry.second.rxPackets) / (double)entry.second.txPackets : 1.0;
+    Simulator::Stop(start + o.duration);
+    perf.Run();
 
-            std::cout << "Scenario4," << tcpVariant
-                      << ", " << cbrRateMbps
-                      << ", " << throughput
-                      << ", " << avgRttMs
-                      << ", " << dropRate << std::endl;
+    double sum = 0;
+    double sumSquares = 0;
+    std::vector<double> hopMbps(hops, 0.0);
+    for (uint32_t i = 0; i < flows; ++i)
+    {
+        uint16_t port = 8080 + i;
+        FlowPath path;
+        path.hops = spans[i].second - spans[i].first;
+        path.baseRttMs = 2 * (SenderAccessDelay(i, o.accessDelay) + o.hopDelay * int64_t(path.hops) + o.accessDelay)
+                                 .GetSeconds() * 1000;
+        ReportFlow(scenario, tcpVariant, hopCount, probe, port, flowStart(i), queues[spans[i].first].get(), path);
+        double seconds = Simulator::Now().GetSeconds() - flowStart(i).GetSeconds();
+        double mbps = 0;
+        for (const auto& flow : probe.GetFlows())
+        {
+            if (flow.first.protocol == 6 && flow.first.dstPort == port)
+            {
+                mbps += flow.second.rxBytes * 8.0 / (seconds * 1e6);
+            }
+        }
+        sum += mbps;
+        sumSquares += mbps * mbps;
+        for (uint32_t h = spans[i].first; h < spans[i].second; ++h)
+        {
+            hopMbps[h] += mbps;
         }
     }
+    ResultRecord r;
+    r.key = ConfigKey(scenario, tcpVariant, hopCount);
+    r.flow = "all";
+    r.throughputMbps = sum;
+    r.avgRttMs = -1;
+    r.dropRate = -1;
+    r.stopTimeSec = Simulator::Now().GetSeconds();
+    r.jainIndex = sumSquares > 0 ? sum * sum / (flows * sumSquares) : 0;
+    double utilization = 0;
+    for (double mbps : hopMbps)
+    {
+        utilization += mbps * 1e6 / rate.GetBitRate() / hops;
+    }
+    r.utilization = utilization;
+    r.hops = hops;
+    EmitResult(g_results, r);
+    g_perfLog.Append(scenario, tcpVariant, hopCount, perf.Finish(probe.GetPacketsSeen()));
 
     Simulator::Destroy();
 }
 
+// Parking lot: per label, variant and topology, the mean throughput and RTT of the
+// flows with the same hop count and base RTT, from the flow rows of the sweep.
+void PrintParkingLot(std::ostream& os, const std::vector<ResultRecord>& rows)
+{
+    struct Group
+    {
+        uint32_t flows = 0;
+        double throughputMbps = 0;
+        double avgRttMs = 0;
+    };
+    std::map<std::tuple<std::string, std::string, double, double, double>, Group> groups;
+    for (const auto& r : rows)
+    {
+        Group& g = groups[std::make_tuple(r.key.scenario, r.key.variant, r.key.cbrRateMbps, r.hops, r.baseRttMs)];
+        g.flows++;
+        g.throughputMbps += r.throughputMbps;
+        g.avgRttMs += r.avgRttMs;
+    }
+    os << "Scenario,Variant,Hops,FlowHops,BaseRTT(ms),Flows,Throughput(Mbps),AvgRTT(ms)\n";
+    for (const auto& g : groups)
+    {
+        os << std::get<0>(g.first) << "," << std::get<1>(g.first) << "," << std::get<2>(g.first) << ","
+           << std::get<3>(g.first) << "," << std::get<4>(g.first) << "," << g.second.flows << ","
+           << g.second.throughputMbps / g.second.flows << "," << g.second.avgRttMs / g.second.flows << "\n";
+    }
+}
+
+// One point of a --scenarioFile sweep: the file's measured TCP flow is probed at its
+// end hosts and the bottleneck link, and reported like the built-in scenarios.
+void RunScenarioFile(const ScenarioSpec& spec, const std::string& tcpVariant, double cbrRateMbps)
+{
+    PerfCounters perf;
+    perf.Begin();
+    BuiltScenario s;
+    BuildScenario(spec, tcpVariant, cbrRateMbps, s, perf);
+
+    EndpointFlowProbe probe;
+    InstallFlowProbe(probe, s.sender, s.sink, s.bottleneck, s.port, s.start);
+    std::unique_ptr<FlowTracer> tracer = MakeFlowTracer(spec.name, tcpVariant, cbrRateMbps);
+    if (tracer)
+    {
+        tracer->AddFlow(std::to_string(s.port), s.sender, s.sink, s.start);
+        tracer->Start(s.start);
+    }
+    std::unique_ptr<PacketCapture> capture = MakePacketCapture(spec.name, tcpVariant, cbrRateMbps, s.bottleneck);
+    if (g_perfLog.IsOpen())
+    {
+        perf.CountLinks();
+    }
+
+    Simulator::Stop(spec.duration);
+    perf.Run();
+    if (tracer)
+    {
+        tracer->Finish();
+    }
+    if (capture)
+    {
+        capture->Finish();
+    }
+
+    ReportFlow(spec.name, tcpVariant, cbrRateMbps, probe, s.port, s.start, &s.bottleneckQueue);
+    g_perfLog.Append(spec.name, tcpVariant, cbrRateMbps, perf.Finish(probe.GetPacketsSeen()));
+
+    Simulator::Destroy();
+}
 
 int main (int argc, char *argv[])
 {
-    std::vector<std::string> tcpVariants = {"TcpVegas", "TcpWestwoodPlus", "TcpBbr", "TcpCubic", "TcpVeno"};
-    std::cout << "Scenario,Variant,CBR(Mbps),Throughput(Mbps),AvgRTT(ms),DropRate" << std::endl;
+    SweepOptions sweep;
+    sweep.workers = std::max (1u, std::thread::hardware_concurrency ());
+    double warmup = 0.0;
+    bool warmupFork = true;
+    std::string resultsPath;
+    std::string codeVersion = SIM_CODE_VERSION;
+    std::string exportCsv;
+    std::string exportColumns;
+    ReplicationOptions replication;
+    std::string benchmarkSummary;
+    std::string perfOut;
+    std::string perfLinksOut;
+    std::string scheduler = "Map";
+    std::string scenarios = "Scenario1,Scenario2,Scenario3,Scenario4,Benchmark";
+    std::string variants = "TcpVegas,TcpWestwoodPlus,TcpBbr,TcpCubic,TcpVeno";
+    std::string aqms = "Default";
+    bool ecn = false;
+    std::string fairnessSummary;
+    uint32_t fairnessMix = 3;
+    std::string workloadLoads = "0.5";
+    std::string fctOut = "fct.csv";
+    std::string events;
+    std::string eventsShare;
+    std::string eventsOut = "events.csv";
+    std::string hbBuffers = "0.25,0.5,1,2,4";
+    std::string parkingHops = "1,2,4,8";
+    std::string parkingLotSummary;
+    std::string accessDelays;
+    std::string scenarioFile;
+    RegressionOptions regression;
+    std::string scenarioVariants;
+    std::string scenarioRates;
+    std::string bufferSummary;
+    bool kneeSearch = false;
+    KneeOptions knee;
+    std::string kneeSummary;
+    bool fluidOnly = false;
+    bool fluidValidate = false;
+    bool fluidScreen = false;
+    double fluidStep = 0.5;
+    double fluidMargin = 1.0;
+    std::string fluidReport;
+
+    CommandLine cmd (__FILE__);
+    cmd.AddValue ("jobs", "Worker processes for the sweep (0 runs every configuration in this process)", sweep.workers);
+    cmd.AddValue ("jobTimeout", "Per-configuration wall-clock limit in seconds (0 disables it)", sweep.timeoutSec);
+    cmd.AddValue ("warmup", "Simulated seconds Scenarios 3/4 run before the CBR rate and variant are applied (0 disables)", warmup);
+    cmd.AddValue ("trace", "Write per-flow cwnd/RTT/pacing/goodput time series to <prefix>-<scenario>-<variant>-<rate>-run<n>.ftrc (and the Scenario 3/4 bottleneck queue to ...-queue.csv)", g_options.tracePrefix);
+    cmd.AddValue ("traceInterval", "Sampling interval of the flow traces", g_options.traceInterval);
+    cmd.AddValue ("capture", "Comma-separated links to write pcap files of: bottleneck or <node>-<node> (what the first node sends the second)", g_options.capture.links);
+    cmd.AddValue ("capturePrefix", "Capture files are <prefix>-<scenario>-<variant>-<rate>-run<n>-<link>-<k>.pcap", g_options.capture.prefix);
+    cmd.AddValue ("capturePorts", "Comma-separated TCP/UDP ports to capture (default: every packet)", g_options.capture.ports);
+    cmd.AddValue ("captureSnapLen", "Bytes kept of each captured packet, PPP header included", g_options.capture.snapLength);
+    cmd.AddValue ("captureSample", "Capture 1 in N of the matching packets", g_options.capture.sampleEvery);
+    cmd.AddValue ("captureStart", "Start of the capture window", g_options.capture.windowStart);
+    cmd.AddValue ("captureStop", "End of the capture window (0: end of the run)", g_options.capture.windowStop);
+    cmd.AddValue ("captureFileBytes", "Size at which a capture file is rotated", g_options.capture.fileBytes);
+    cmd.AddValue ("captureFiles", "Capture files kept per link; older ones are removed", g_options.capture.files);
+    cmd.AddValue ("captureTrigger", "Only capture around intervals in which a captured link drops at least this fraction (0: always)", g_options.capture.triggerDropRate);
+    cmd.AddValue ("captureTriggerInterval", "Interval over which the trigger drop rate is measured", g_options.capture.triggerInterval);
+    cmd.AddValue ("captureTriggerHold", "Time the capture continues after the last triggering interval", g_options.capture.triggerHold);
+    cmd.AddValue ("capturePreTrigger", "Packets per link kept from before a trigger", g_options.capture.preTriggerPackets);
+    cmd.AddValue ("events", "Timeline of Scenarios 1-4, e.g. 30s:rate=5Mbps,50s:delay=40ms,60s:fail=bottleneck,62s:restore=bottleneck,70s:flow=TcpCubic", events);
+    cmd.AddValue ("eventsOut", "Append the measured flow's response to every timeline event to this CSV file", eventsOut);
+    cmd.AddValue ("eventsSample", "Bin width of the goodput and RTT the event responses are computed from", g_options.transient.sample);
+    cmd.AddValue ("eventsWindow", "Averaging window of the goodput after an event", g_options.transient.window);
+    cmd.AddValue ("eventsFraction", "Fraction of the fair share or settled goodput within which the flow counts as converged", g_options.transient.fraction);
+    cmd.AddValue ("eventsShare", "Comma-separated fair shares (Mbps) of the measured flow after each event; empty entries are computed", eventsShare);
+    cmd.AddValue ("warmupFork", "Share each warm-up through forked snapshots instead of cold runs", warmupFork);
+    cmd.AddValue ("converge", "Stop each run once the measured flow's goodput and delay have converged", g_options.convergence.enabled);
+    cmd.AddValue ("convergeWindow", "Batch length of the convergence check", g_options.convergence.window);
+    cmd.AddValue ("convergePrecision", "Relative 95% confidence half-width at which a run counts as converged", g_options.convergence.precision);
+    cmd.AddValue ("convergeMin", "Measured time before a run may stop early", g_options.convergence.minTime);
+    cmd.AddValue ("convergeMax", "Measured time after which a run stops regardless (0 keeps the scenario's length)", g_options.convergence.maxTime);
+    cmd.AddValue ("benchmarkPrecision", "Relative 95% CI half-width the benchmark replicates are added until", replication.precision);
+    cmd.AddValue ("benchmarkMinRuns", "Replicates every benchmark configuration gets at least", replication.minRuns);
+    cmd.AddValue ("benchmarkMaxRuns", "Replicates no benchmark configuration gets more than", replication.maxRuns);
+    cmd.AddValue ("benchmarkFirstRun", "RngRun of the first benchmark replicate", replication.firstRun);
+    cmd.AddValue ("benchmarkSummary", "Write the per-variant benchmark means and CIs to this CSV file (default: stderr)", benchmarkSummary);
+    cmd.AddValue ("knee", "Search Scenarios 1-4 for the CBR rate at which the measured flow collapses instead of running rates 1..10", kneeSearch);
+    cmd.AddValue ("kneeLow", "Lowest CBR rate (Mbps) of the knee search", knee.low);
+    cmd.AddValue ("kneeHigh", "Highest CBR rate (Mbps) of the knee search", knee.high);
+    cmd.AddValue ("kneePoints", "Evenly spaced rates the knee search starts with, both ends included", knee.initialPoints);
+    cmd.AddValue ("kneeResolution", "Rate interval (Mbps) to which the knee is narrowed down", knee.resolution);
+    cmd.AddValue ("kneeBudget", "Runs per scenario and variant the knee search may use", knee.budget);
+    cmd.AddValue ("kneeMetric", "Knee criterion: DropRate (reaches kneeDropRate) or Throughput (falls below kneeThroughputFraction of the best)", knee.metric);
+    cmd.AddValue ("kneeDropRate", "Drop rate that marks the knee", knee.dropRate);
+    cmd.AddValue ("kneeThroughputFraction", "Fraction of the best throughput below which the knee is passed", knee.throughputFraction);
+    cmd.AddValue ("kneeSummary", "Write the knee of every scenario and variant to this CSV file (default: stderr)", kneeSummary);
+    cmd.AddValue ("fluid", "Print fluid-model predictions of Scenarios 1-4 every fluidStep Mbps instead of simulating packets", fluidOnly);
+    cmd.AddValue ("fluidStep", "CBR rate step (Mbps) of the fluid predictions and of the fluid knee screening", fluidStep);
+    cmd.AddValue ("fluidValidate", "Compare the fluid prediction of every Scenario 1-4 row of the sweep with the packet-level result", fluidValidate);
+    cmd.AddValue ("fluidReport", "Write the fluid validation to this CSV file (default: stderr)", fluidReport);
+    cmd.AddValue ("fluidScreen", "With --knee, search only around the knee the fluid model predicts", fluidScreen);
+    cmd.AddValue ("fluidMargin", "Rate margin (Mbps) kept on both sides of the predicted knee by --fluidScreen", fluidMargin);
+    cmd.AddValue ("scheduler", "Event scheduler: Map, Heap, List, Calendar or PriorityQueue", scheduler);
+    cmd.AddValue ("scenarioFile", "Sweep the scenario this file describes instead of the built-in ones (see scenarios/dumbbell.scn)", scenarioFile);
+    cmd.AddValue ("scenarioVariants", "Comma-separated variants to sweep the scenario file over (default: its sweep variant line, else --variants)", scenarioVariants);
+    cmd.AddValue ("scenarioRates", "Comma-separated CBR rates (Mbps) to sweep the scenario file over (default: its sweep rate line, else 1..10)", scenarioRates);
+    cmd.AddValue ("scenarios", "Comma-separated subset of Scenario1..Scenario4, Benchmark, Fairness, Workload, HighBandwidth and ParkingLot to run", scenarios);
+    cmd.AddValue ("fairnessMix", "Largest mix of distinct variants the Fairness scenario runs every subset of, besides the pairs and the mix of all", fairnessMix);
+    cmd.AddValue ("fairnessSummary", "Write the per-mix fairness summary and share matrices to this CSV file (default: stderr)", fairnessSummary);
+    cmd.AddValue ("variants", "Comma-separated TCP variants to sweep", variants);
+    cmd.AddValue ("aqm", "Comma-separated Scenario 3/4 bottleneck queues: Default, DropTail, RED, CoDel, FqCoDel, PIE, DctcpStep", aqms);
+    cmd.AddValue ("ecn", "Negotiate ECN on every TCP connection and let the AQMs mark instead of drop", ecn);
+    cmd.AddValue ("aqmLimit", "Capacity of a non-default bottleneck queue disc", g_options.queue.limit);
+    cmd.AddValue ("aqmMarkThreshold", "Queued packets above which DctcpStep marks", g_options.queue.markThreshold);
+    cmd.AddValue ("workloadCdf", "Flow size CDF file of the Workload scenario (lines of <bytes> <cumulative probability>)", g_options.workload.cdfPath);
+    cmd.AddValue ("workloadLoads", "Comma-separated offered loads of the Workload scenario, relative to the bottleneck", workloadLoads);
+    cmd.AddValue ("workloadStop", "Time after which the Workload scenario starts no new flows", g_options.workload.stop);
+    cmd.AddValue ("workloadFlows", "Poisson flows the Workload scenario starts at most (0: until workloadStop)", g_options.workload.maxFlows);
+    cmd.AddValue ("workloadPairs", "Sender and receiver hosts on each side of the Workload dumbbell", g_options.workloadPairs);
+    cmd.AddValue ("incastInterval", "Time between partition/aggregate incast bursts (0 disables them)", g_options.workload.incastInterval);
+    cmd.AddValue ("incastFanIn", "Senders answering each incast burst", g_options.workload.incastFanIn);
+    cmd.AddValue ("hbRate", "Rate of every link of the HighBandwidth scenario, e.g. 10Gbps, 40Gbps or 100Gbps", g_options.highBandwidth.rate);
+    cmd.AddValue ("hbRtt", "Base RTT of the HighBandwidth dumbbell", g_options.highBandwidth.baseRtt);
+    cmd.AddValue ("hbMtu", "Frame size of the HighBandwidth links (9000: jumbo frames); segments fill them", g_options.highBandwidth.mtu);
+    cmd.AddValue ("hbSendSize", "Bytes a HighBandwidth sender hands to its socket per call", g_options.highBandwidth.sendSize);
+    cmd.AddValue ("hbFlows", "Flows sharing the HighBandwidth bottleneck", g_options.highBandwidth.flows);
+    cmd.AddValue ("hbDuration", "Simulated time of a HighBandwidth run after its flows started", g_options.highBandwidth.duration);
+    cmd.AddValue ("hbBuffers", "Comma-separated HighBandwidth bottleneck buffers in bandwidth-delay products", hbBuffers);
+    cmd.AddValue ("bufferSummary", "Write the HighBandwidth buffer sizing table to this CSV file (default: stderr)", bufferSummary);
+    cmd.AddValue ("parkingHops", "Comma-separated bottleneck hop counts of the ParkingLot scenario", parkingHops);
+    cmd.AddValue ("parkingRate", "Rate of every ParkingLot hop; access links run ten times as fast", g_options.parkingLot.rate);
+    cmd.AddValue ("parkingHopDelay", "Delay of every ParkingLot hop", g_options.parkingLot.hopDelay);
+    cmd.AddValue ("parkingAccessDelay", "Delay of the ParkingLot access links not set by --accessDelays", g_options.parkingLot.accessDelay);
+    cmd.AddValue ("parkingLongFlows", "ParkingLot flows crossing every hop", g_options.parkingLot.longFlows);
+    cmd.AddValue ("parkingCrossFlows", "ParkingLot cross flows entering before and leaving after each hop", g_options.parkingLot.crossFlows);
+    cmd.AddValue ("parkingDuration", "Simulated time of a ParkingLot run after its flows started", g_options.parkingLot.duration);
+    cmd.AddValue ("parkingLotSummary", "Write the ParkingLot throughput by flow hop count and base RTT to this CSV file (default: stderr)", parkingLotSummary);
+    cmd.AddValue ("accessDelays", "Comma-separated access link delays given to the Scenario 3/4, Fairness and ParkingLot senders in turn, e.g. 2ms,20ms,50ms", accessDelays);
+    cmd.AddValue ("incastBytes", "Bytes each incast sender answers with", g_options.workload.incastBytes);
+    cmd.AddValue ("workloadTimeWait", "TIME_WAIT of the Workload scenario's finished flows (twice the TCP segment lifetime)", g_options.workload.timeWait);
+    cmd.AddValue ("fctOut", "Append the Workload scenario's flow completion times by size bucket to this CSV file", fctOut);
+    cmd.AddValue ("perfOut", "Append a performance record (phase times, events, queue depth, peak RSS, link packets) per run to this CSV file", perfOut);
+    cmd.AddValue ("perfLinksOut", "Append the packets of every link per run to this CSV file (needs --perfOut)", perfLinksOut);
+    cmd.AddValue ("regression", "Run the short fixed-seed regression suite and compare its rows with this golden CSV file", regression.golden);
+    cmd.AddValue ("regressionBaseline", "Performance log (see --perfOut) whose wall times, event rates and peak RSS the suite is compared with", regression.baseline);
+    cmd.AddValue ("regressionUpdate", "Rewrite the golden file and the baseline from this run instead of comparing", regression.update);
+    cmd.AddValue ("regressionSummary", "Append the comparison table to this CSV file (default: stderr)", regression.summary);
+    cmd.AddValue ("regressionLength", "Measured time of every regression run", regression.length);
+    cmd.AddValue ("regressionThroughputTol", "Relative throughput change that counts as a regression", regression.throughputTolerance);
+    cmd.AddValue ("regressionRttTol", "Relative RTT change that counts as a regression", regression.rttTolerance);
+    cmd.AddValue ("regressionDropTol", "Absolute drop rate change that counts as a regression", regression.dropTolerance);
+    cmd.AddValue ("regressionSlowdown", "Factor by which wall time or peak RSS may grow, and the event rate shrink, over the baseline", regression.slowdown);
+    cmd.AddValue ("results", "Append results to this store and skip configurations it already holds", resultsPath);
+    cmd.AddValue ("codeVersion", "Code version recorded with each result; stored results of other versions are rerun", codeVersion);
+    cmd.AddValue ("exportCsv", "Write every record of the results store to this CSV file and exit", exportCsv);
+    cmd.AddValue ("exportColumns", "Write the results store as one .npy file per column into this directory and exit", exportColumns);
+    cmd.Parse (argc, argv);
+
+    NS_ABORT_MSG_IF (g_options.capture.sampleEvery < 1, "--captureSample must be at least 1");
+    SelectScheduler (scheduler);
+    for (const auto& delay : SplitList (accessDelays))
+    {
+        g_options.accessDelays.push_back (Time (delay));
+        g_options.accessLabel += (g_options.accessLabel.empty () ? "-Access" : "+") + delay;
+    }
+    g_options.queue.ecn = ecn;
+    g_options.events = ParseTimeline (events);
+    g_options.transient.shares = ParseShares (eventsShare);
+    if (!g_options.events.empty ())
+    {
+        g_eventLog.Open (eventsOut);
+    }
+    if (ecn)
+    {
+        Config::SetDefault ("ns3::TcpSocketBase::UseEcn", StringValue ("On"));
+    }
+    if (!perfOut.empty ())
+    {
+        g_perfLog.Open (perfOut);
+    }
+    if (!perfLinksOut.empty ())
+    {
+        g_perfLog.OpenLinks (perfLinksOut);
+    }
+    if (!resultsPath.empty ())
+    {
+        g_results.Open (resultsPath, codeVersion);
+    }
+    if (!exportCsv.empty () || !exportColumns.empty ())
+    {
+        NS_ABORT_MSG_IF (!g_results.IsOpen (), "Exporting needs --results");
+        if (!exportCsv.empty ())
+        {
+            g_results.ExportCsv (exportCsv);
+        }
+        if (!exportColumns.empty ())
+        {
+            g_results.ExportColumns (exportColumns);
+        }
+        return 0;
+    }
+
+    std::vector<SweepJob> jobs;
+    // Keyed with this process's seed and run, which every worker inherits.
+    auto addJob = [&] (SweepJob job, const std::string& scenario, const std::string& variant, double rate) {
+        ResumeFromStore (job, g_results, ConfigKey (scenario, variant, rate));
+        jobs.push_back (job);
+    };
+
+    auto selected = [&] (const std::string& scenario) {
+        return ("," + scenarios + ",").find ("," + scenario + ",") != std::string::npos;
+    };
 
+    std::vector<std::string> tcpVariants = SplitList (variants);
     for (const auto& variant : tcpVariants)
     {
-        for (int rate = 1; rate <= 10; ++rate)
+        GetTcpVariant (variant);
+    }
+    // Regression suite: Scenarios 1-4 and HighBandwidth, shortened and with a fixed
+    // seed, one run at a time so that wall times and peak RSS are comparable.
+    if (!regression.golden.empty ())
+    {
+        RngSeedManager::SetSeed (1);
+        RngSeedManager::SetRun (1);
+        g_options.convergence.enabled = true;
+        g_options.convergence.minTime = regression.length;
+        g_options.convergence.maxTime = regression.length;
+        std::string perfLog = perfOut;
+        if (perfLog.empty ())
+        {
+            perfLog = regression.golden + ".perf";
+            std::remove (perfLog.c_str ());
+            g_perfLog.Open (perfLog);
+        }
+        regression.codeVersion = codeVersion;
+
+        std::vector<SweepJob> suite;
+        for (const auto& variant : tcpVariants)
         {
-            RunScenario1 (variant, rate);
+            for (int rate : {2, 8})
+            {
+                std::string suffix = "/" + variant + "/" + std::to_string (rate);
+                suite.push_back ({"Scenario1" + suffix, 0, [=] () { RunScenario1 (variant, rate); }});
+                suite.push_back ({"Scenario2" + suffix, 0, [=] () { RunScenario2 (variant, rate); }});
+                suite.push_back ({"Scenario3" + suffix, 0, [=] () { RunScenario3 (variant, rate); }});
+                suite.push_back ({"Scenario4" + suffix, 0, [=] () { RunScenario4 (variant, rate); }});
+            }
+            std::string label = "HighBandwidth-" + g_options.highBandwidth.rate;
+            suite.push_back ({label + "/" + variant + "/1", 0, [=] () { RunHighBandwidth (label, variant, 1, "Default"); }});
         }
+        SweepOptions sequential = sweep;
+        sequential.workers = 1;
+        PrintCsvHeader (std::cout);
+        std::vector<ResultRecord> rows;
+        size_t failed = RunSweep (suite, sequential, [&] (size_t, const SweepOutcome& outcome) {
+            std::cout << outcome.output << std::flush;
+            std::istringstream lines (outcome.output);
+            std::string line;
+            ResultRecord r;
+            while (std::getline (lines, line))
+            {
+                if (ParseCsvRow (line, r))
+                {
+                    rows.push_back (r);
+                }
+            }
+        });
+        NS_ABORT_MSG_IF (failed > 0 && regression.update, failed << " regression runs failed; nothing was updated");
+        size_t regressed = RegressionCheck (regression).Finish (rows, perfLog);
+        std::clog << "# regression: " << suite.size () << " runs, " << failed << " failed, " << regressed
+                  << " values regressed" << std::endl;
+        return failed + regressed == 0 ? 0 : 1;
     }
-    for (const auto& variant : tcpVariants)
+    NS_ABORT_MSG_IF (knee.metric != "DropRate" && knee.metric != "Throughput", "Unknown knee metric: " << knee.metric);
+    NS_ABORT_MSG_IF (knee.resolution <= 0 || knee.high <= knee.low, "The knee search needs kneeLow < kneeHigh and a positive resolution");
+    // With --knee, Scenarios 1-4 are searched after the other jobs instead of swept.
+    std::vector<KneeConfig> kneeConfigs;
+
+    // A scenario file replaces the built-in scenarios; its axes come from the command
+    // line, then the file, then the defaults.
+    if (!scenarioFile.empty ())
+    {
+        ScenarioSpec spec = LoadScenario (scenarioFile);
+        scenarios.clear ();
+        std::vector<std::string> fileVariants = scenarioVariants.empty () ? spec.variants : SplitList (scenarioVariants);
+        if (fileVariants.empty ())
+        {
+            fileVariants = tcpVariants;
+        }
+        std::vector<double> fileRates = spec.rates;
+        if (!scenarioRates.empty ())
+        {
+            fileRates.clear ();
+            for (const auto& rate : SplitList (scenarioRates))
+            {
+                fileRates.push_back (std::stod (rate));
+            }
+        }
+        if (fileRates.empty ())
+        {
+            fileRates = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10};
+        }
+        int udpFlows = 0;
+        for (const auto& flow : spec.flows)
+        {
+            udpFlows += flow.protocol == "udp" ? 1 : 0;
+        }
+        for (const auto& variant : fileVariants)
+        {
+            GetTcpVariant (variant);
+            for (double rate : fileRates)
+            {
+                std::ostringstream name;
+                name << spec.name << "/" << variant << "/" << rate;
+                addJob ({name.str (), EstimateCost (spec.duration.GetSeconds (), udpFlows, rate),
+                         [=] () { RunScenarioFile (spec, variant, rate); }},
+                        spec.name, variant, rate);
+            }
+        }
+    }
+
+    if (fluidOnly || fluidValidate || fluidScreen)
     {
-        for (int rate = 1; rate <= 10; ++rate)
+        for (const auto& variant : tcpVariants)
+        {
+            NS_ABORT_MSG_IF (!FluidNetwork::Supports (variant), "No fluid model of " << variant);
+        }
+        NS_ABORT_MSG_IF (fluidStep <= 0, "--fluidStep must be positive");
+        NS_ABORT_MSG_IF (!g_options.accessDelays.empty (), "The fluid models assume the default access delays");
+    }
+    // Fluid predictions only: every selected scenario, variant and AQM over the rate range.
+    if (fluidOnly)
+    {
+        std::vector<std::string> labels;
+        for (const auto& scenario : {"Scenario1", "Scenario2"})
+        {
+            if (selected (scenario))
+            {
+                labels.push_back (scenario);
+            }
+        }
+        for (const auto& aqm : SplitList (aqms))
+        {
+            for (const auto& scenario : {"Scenario3", "Scenario4"})
+            {
+                if (selected (scenario))
+                {
+                    labels.push_back (DumbbellLabel (scenario, aqm));
+                }
+            }
+        }
+        PrintCsvHeader (std::cout);
+        auto start = std::chrono::steady_clock::now ();
+        size_t points = 0;
+        for (const auto& label : labels)
         {
-            RunScenario2 (variant, rate);
+            for (const auto& variant : tcpVariants)
+            {
+                for (double rate = knee.low; rate <= knee.high + 1e-9; rate += fluidStep, ++points)
+                {
+                    PrintCsvRow (std::cout, PredictScenario (label, variant, rate));
+                }
+            }
         }
+        double sec = std::chrono::duration<double> (std::chrono::steady_clock::now () - start).count ();
+        std::clog << "# fluid points=" << points << " total=" << sec << "s perPoint=" << 1000 * sec / std::max<size_t> (1, points)
+                  << "ms" << std::endl;
+        return 0;
     }
+
     for (const auto& variant : tcpVariants)
     {
-        for (int rate = 1; rate <= 10; ++rate)
+        if (kneeSearch && selected ("Scenario1"))
+        {
+            kneeConfigs.push_back ({"Scenario1/" + variant, [] (double rate) { return EstimateCost (50.0, 1, rate); },
+                                    [=] (double rate) { RunScenario1 (variant, rate); }, ConfigKey ("Scenario1", variant, 0)});
+            continue;
+        }
+        for (int rate = 1; rate <= 10 && selected ("Scenario1"); ++rate)
         {
-            RunScenario3 (variant, rate);
+            addJob ({"Scenario1/" + variant + "/" + std::to_string (rate),
+                     EstimateCost (50.0, 1, rate), [=] () { RunScenario1 (variant, rate); }},
+                    "Scenario1", variant, rate);
         }
     }
     for (const auto& variant : tcpVariants)
     {
-        for (int rate = 1; rate <= 10; ++rate)
+        if (kneeSearch && selected ("Scenario2"))
+        {
+            kneeConfigs.push_back ({"Scenario2/" + variant, [] (double rate) { return EstimateCost (100.0, 1, rate); },
+                                    [=] (double rate) { RunScenario2 (variant, rate); }, ConfigKey ("Scenario2", variant, 0)});
+            continue;
+        }
+        for (int rate = 1; rate <= 10 && selected ("Scenario2"); ++rate)
         {
-            RunScenario4 (variant, rate);
+            addJob ({"Scenario2/" + variant + "/" + std::to_string (rate),
+                     EstimateCost (100.0, 1, rate), [=] () { RunScenario2 (variant, rate); }},
+                    "Scenario2", variant, rate);
         }
     }
+    // Scenarios 3 and 4 only differ in the CBR rate and variant between points, so
+    // with a warm-up time they share one topology build per forked snapshot.
+    std::vector<int> rates = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10};
+    // Every AQM is a scenario of its own, labelled e.g. Scenario3-CoDel.
+    auto addDumbbell = [&] (const std::string& scenario, bool bursty, const std::string& aqm) {
+        if (!selected (scenario))
+        {
+            return;
+        }
+        std::string label = DumbbellLabel (scenario, aqm) + g_options.accessLabel;
+        if (kneeSearch)
+        {
+            // Search points are not known up front, so they run cold.
+            for (const auto& variant : tcpVariants)
+            {
+                kneeConfigs.push_back ({label + "/" + variant, [] (double rate) { return EstimateCost (kDumbbellStop, 3, rate); },
+                                        [=] (double rate) { RunDumbbell (label, variant, rate, bursty, warmup, aqm); },
+                                        ConfigKey (label, variant, 0)});
+            }
+            return;
+        }
+        if (warmup > 0 && warmupFork)
+        {
+            std::vector<std::vector<std::string>> groups;
+            if (warmup <= kDumbbellTcpStart)
+            {
+                groups.push_back (tcpVariants);
+            }
+            else
+            {
+                for (const auto& variant : tcpVariants)
+                {
+                    groups.push_back ({variant});
+                }
+            }
+            SweepOptions inner = sweep;
+            inner.workers = std::max (1u, sweep.workers / unsigned (groups.size ()));
+            for (const auto& group : groups)
+            {
+                SweepJob job {label + "/warm/" + group.front (), 0.0, [=] () {
+                    RunDumbbellWarmSweep (label, bursty, group, rates, warmup, inner, aqm);
+                }};
+                for (int rate : rates)
+                {
+                    job.cost += group.size () * EstimateCost (kDumbbellStop - warmup, 3, rate);
+                }
+                job.timeoutSec = 0;
+                jobs.push_back (job);
+            }
+            return;
+        }
+        for (const auto& variant : tcpVariants)
+        {
+            for (int rate : rates)
+            {
+                addJob ({label + "/" + variant + "/" + std::to_string (rate),
+                         EstimateCost (kDumbbellStop, 3, rate),
+                         [=] () { RunDumbbell (label, variant, rate, bursty, warmup, aqm); }},
+                        label, variant, rate);
+            }
+        }
+    };
+    for (const auto& aqm : SplitList (aqms))
+    {
+        addDumbbell ("Scenario3", false, aqm);
+        addDumbbell ("Scenario4", true, aqm);
+    }
 
-    // Benchmarking
-    int rate = 10;
-    for (const auto& variant : tcpVariants)
+    // Data-center workloads: their flow completion times go to the --fctOut file.
+    if (selected ("Workload"))
+    {
+        NS_ABORT_MSG_IF (g_options.workload.cdfPath.empty (), "The Workload scenario needs --workloadCdf");
+        g_fctLog.Open (fctOut);
+        double seconds = g_options.workload.stop.GetSeconds () + 10;
+        for (const auto& aqm : SplitList (aqms))
+        {
+            std::string label = DumbbellLabel ("Workload", aqm);
+            for (const auto& variant : tcpVariants)
+            {
+                for (const auto& load : SplitList (workloadLoads))
+                {
+                    double l = std::stod (load);
+                    // Its flows run to completion, so the results store has no row to resume from.
+                    jobs.push_back ({label + "/" + variant + "/" + load, EstimateCost (seconds, 1, 10 * l),
+                                     [=] () { RunWorkloadDumbbell (label, variant, l, aqm); }});
+                }
+            }
+        }
+    }
+
+    // Data-center rates: every variant and AQM over the buffer sizes.
+    if (selected ("HighBandwidth"))
     {
-        for (int i = 1; i <= 10; ++i)
+        const HighBandwidthOptions& o = g_options.highBandwidth;
+        // Relative to the 1000-byte packets of the dumbbell scenarios.
+        double packets = DataRate (o.rate).GetBitRate () / 8.0 / o.mtu * o.duration.GetSeconds () * o.flows;
+        for (const auto& aqm : SplitList (aqms))
         {
-            RunScenario4 (variant, rate);
+            std::string label = DumbbellLabel ("HighBandwidth-" + o.rate, aqm);
+            for (const auto& variant : tcpVariants)
+            {
+                for (const auto& buffer : SplitList (hbBuffers))
+                {
+                    double bdps = std::stod (buffer);
+                    SweepJob job {label + "/" + variant + "/" + buffer, packets / 1250.0,
+                                  [=] () { RunHighBandwidth (label, variant, bdps, aqm); }};
+                    ResumeFromStore (job, g_results, ConfigKey (label, variant, bdps));
+                    jobs.push_back (job);
+                }
+            }
         }
     }
 
-    return 0;
-}
\ No newline at end of file
+    // Multi-bottleneck chains: every variant and AQM over the hop counts.
+    if (selected ("ParkingLot"))
+    {
+        const ParkingLotOptions& o = g_options.parkingLot;
+        for (const auto& aqm : SplitList (aqms))
+        {
+            std::string label = DumbbellLabel ("ParkingLot", aqm) + g_options.accessLabel;
+            for (const auto& variant : tcpVariants)
+            {
+                for (const auto& hops : SplitList (parkingHops))
+                {
+                    double n = std::stod (hops);
+                    NS_ABORT_MSG_IF (n < 1, "ParkingLot needs at least one hop");
+                    double flows = o.longFlows + n * o.crossFlows;
+                    addJob ({label + "/" + variant + "/" + hops, EstimateCost (o.duration.GetSeconds (), 0, 0) * flows * n,
+                             [=] () { RunParkingLot (label, variant, n, aqm); }},
+                            label, variant, n);
+                }
+            }
+        }
+    }
+
+    PrintCsvHeader (std::cout);
+    std::cout.flush ();
+    std::vector<ResultRecord> measured;
+    std::vector<ResultRecord> bufferRows;
+    std::vector<ResultRecord> parkingRows;
+    size_t failed = RunSweep (jobs, sweep, [&] (size_t, const SweepOutcome& outcome) {
+        std::cout << outcome.output << std::flush;
+        std::istringstream lines (outcome.output);
+        std::string line;
+        ResultRecord r;
+        while (std::getline (lines, line))
+        {
+            if (!ParseCsvRow (line, r))
+            {
+                continue;
+            }
+            if (fluidValidate && r.key.scenario.compare (0, 8, "Scenario") == 0)
+            {
+                measured.push_back (r);
+            }
+            // Only the summary rows of a HighBandwidth run have a Jain index.
+            if (r.key.scenario.compare (0, 13, "HighBandwidth") == 0 && r.jainIndex >= 0)
+            {
+                bufferRows.push_back (r);
+            }
+            // The flow rows of a ParkingLot run are the ones with a base RTT.
+            if (r.key.scenario.compare (0, 10, "ParkingLot") == 0 && r.baseRttMs >= 0)
+            {
+                parkingRows.push_back (r);
+            }
+        }
+    });
+    if (!bufferRows.empty ())
+    {
+        if (bufferSummary.empty ())
+        {
+            PrintBufferSizing (std::clog, bufferRows);
+        }
+        else
+        {
+            std::ofstream out (bufferSummary);
+            PrintBufferSizing (out, bufferRows);
+        }
+    }
+    if (!parkingRows.empty ())
+    {
+        if (parkingLotSummary.empty ())
+        {
+            PrintParkingLot (std::clog, parkingRows);
+        }
+        else
+        {
+            std::ofstream out (parkingLotSummary);
+            PrintParkingLot (out, parkingRows);
+        }
+    }
+    if (fluidValidate)
+    {
+        if (fluidReport.empty ())
+        {
+            PrintFluidValidation (std::clog, measured);
+        }
+        else
+        {
+            std::ofstream out (fluidReport);
+            PrintFluidValidation (out, measured);
+        }
+    }
+
+    if (!kneeConfigs.empty ())
+    {
+        // Screening: the packet-level search only covers the fluid knee and a margin.
+        for (auto& config : kneeConfigs)
+        {
+            if (!fluidScreen)
+            {
+                break;
+            }
+            KneeSummary predicted;
+            for (double rate = knee.low; rate <= knee.high + 1e-9; rate += fluidStep)
+            {
+                ResultRecord r = PredictScenario (config.key.scenario, config.key.variant, rate);
+                predicted.points[rate] = KneeMetric (knee, r);
+            }
+            predicted.runs = 1;
+            Summarize (predicted, knee);
+            if (predicted.below >= 0 && predicted.knee >= 0)
+            {
+                config.low = std::max (knee.low, predicted.below - fluidMargin);
+                config.high = std::min (knee.high, predicted.knee + fluidMargin);
+                std::clog << "# fluid knee " << config.name << ": " << predicted.below << ".." << predicted.knee
+                          << " Mbps, searching " << config.low << ".." << config.high << std::endl;
+            }
+        }
+        std::vector<KneeSummary> summaries = RunKneeSearches (kneeConfigs, knee, sweep, g_results, failed);
+        if (kneeSummary.empty ())
+        {
+            PrintKneeSummary (std::clog, kneeConfigs, summaries, knee);
+        }
+        else
+        {
+            std::ofstream out (kneeSummary);
+            PrintKneeSummary (out, kneeConfigs, summaries, knee);
+        }
+    }
+
+    // Benchmarking: Scenario 4 at 10 Mbps is replicated with independent RNG runs
+    // until the confidence intervals of its metrics reach the target precision. The
+    // replicates are labelled Benchmark, so that the one sharing the sweep's RNG run
+    // is not taken for the sweep's Scenario 4 point in the results store.
+    if (selected ("Benchmark"))
+    {
+        int rate = 10;
+        std::string label = "Benchmark" + g_options.accessLabel;
+        std::vector<ReplicatedConfig> benchmark;
+        for (const auto& variant : tcpVariants)
+        {
+            benchmark.push_back ({"Benchmark/" + variant, EstimateCost (kDumbbellStop, 3, rate),
+                                  [=] () { RunDumbbell (label, variant, rate, true, 0.0); },
+                                  ConfigKey (label, variant, rate)});
+        }
+        std::vector<ReplicationSummary> summaries = RunReplications (benchmark, replication, sweep, g_results, failed);
+        if (benchmarkSummary.empty ())
+        {
+            PrintReplicationSummary (std::clog, benchmark, summaries);
+        }
+        else
+        {
+            std::ofstream out (benchmarkSummary);
+            PrintReplicationSummary (out, benchmark, summaries);
+        }
+    }
+
+    // Mixed-variant fairness: every pair of the swept variants, every subset of 3 up
+    // to --fairnessMix of them, and all of them at once share the dumbbell bottleneck.
+    if (selected ("Fairness"))
+    {
+        if (fairnessSummary.empty ())
+        {
+            failed += RunFairness (tcpVariants, SplitList (aqms), fairnessMix, sweep, std::clog);
+        }
+        else
+        {
+            std::ofstream out (fairnessSummary);
+            failed += RunFairness (tcpVariants, SplitList (aqms), fairnessMix, sweep, out);
+        }
+    }
+
+    return failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,164 @@
+#ifndef TCP_VARIANTS_H
+#define TCP_VARIANTS_H
+
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/internet-module.h"
+#include "ns3/tcp-bbr.h"
+#include "ns3/tcp-bic.h"
+#include "ns3/tcp-cubic.h"
+#include "ns3/tcp-dctcp.h"
+#include "ns3/tcp-highspeed.h"
+#include "ns3/tcp-htcp.h"
+#include "ns3/tcp-illinois.h"
+#include "ns3/tcp-ledbat.h"
+#include "ns3/tcp-lp.h"
+#include "ns3/tcp-scalable.h"
+#include "ns3/tcp-vegas.h"
+#include "ns3/tcp-veno.h"
+#include "ns3/tcp-westwood-plus.h"
+#include "ns3/tcp-yeah.h"
+
+#include <algorithm>
+#include <string>
+
+namespace ns3 {
+
+inline TypeId GetTcpVariant (const std::string& variant)
+{
+    if (variant == "TcpNewReno") return TcpNewReno::GetTypeId ();
+    if (variant == "TcpVegas") return TcpVegas::GetTypeId ();
+    if (variant == "TcpWestwoodPlus") return TcpWestwoodPlus::GetTypeId ();
+    if (variant == "TcpBbr") return TcpBbr::GetTypeId ();
+    if (variant == "TcpCubic") return TcpCubic::GetTypeId ();
+    if (variant == "TcpVeno") return TcpVeno::GetTypeId ();
+    if (variant == "TcpDctcp") return TcpDctcp::GetTypeId ();
+    if (variant == "TcpHighSpeed") return TcpHighSpeed::GetTypeId ();
+    if (variant == "TcpIllinois") return TcpIllinois::GetTypeId ();
+    if (variant == "TcpBic") return TcpBic::GetTypeId ();
+    if (variant == "TcpHtcp") return TcpHtcp::GetTypeId ();
+    if (variant == "TcpLedbat") return TcpLedbat::GetTypeId ();
+    if (variant == "TcpYeah") return TcpYeah::GetTypeId ();
+    if (variant == "TcpLp") return TcpLp::GetTypeId ();
+    if (variant == "TcpScalable") return TcpScalable::GetTypeId ();
+    NS_ABORT_MSG ("Unknown TCP variant: " << variant);
+}
+
+// Congestion control of the sockets a node creates from now on, e.g. the ones a
+// PacketSink accepts, which matters for receiver-side behaviour such as DCTCP's ECE.
+inline void SetNodeTcpVariant (Ptr<Node> node, const std::string& variant)
+{
+    node->GetObject<TcpL4Protocol> ()->SetAttribute ("SocketType", TypeIdValue (GetTcpVariant (variant)));
+}
+
+// Bulk TCP sender like BulkSendApplication, but its socket is created with its own
+// congestion control. Changing the SocketType default between flows does not work:
+// every node's TcpL4Protocol takes it when the stack is installed and uses it for
+// all the sockets it creates.
+class FlowSender : public Application
+{
+public:
+    static TypeId GetTypeId ()
+    {
+        static TypeId tid = TypeId ("ns3::FlowSender")
+                                .SetParent<Application> ()
+                                .SetGroupName ("Applications")
+                                .AddConstructor<FlowSender> ()
+                                .AddAttribute ("Remote", "Address of the sink", AddressValue (),
+                                               MakeAddressAccessor (&FlowSender::m_peer), MakeAddressChecker ())
+                                .AddAttribute ("CongestionControl", "TcpCongestionOps of the socket",
+                                               TypeIdValue (TcpNewReno::GetTypeId ()),
+                                               MakeTypeIdAccessor (&FlowSender::m_congestion), MakeTypeIdChecker ())
+                                .AddAttribute ("SendSize", "Bytes handed to the socket per send", UintegerValue (512),
+                                               MakeUintegerAccessor (&FlowSender::m_sendSize),
+                                               MakeUintegerChecker<uint32_t> (1))
+                                .AddAttribute ("MaxBytes", "Bytes to send, 0 for no limit", UintegerValue (0),
+                                               MakeUintegerAccessor (&FlowSender::m_maxBytes),
+                                               MakeUintegerChecker<uint64_t> ());
+        return tid;
+    }
+
+    // Null until the application has started.
+    Ptr<Socket> GetSocket () const { return m_socket; }
+
+private:
+    void StartApplication () override
+    {
+        if (m_socket)
+        {
+            return;
+        }
+        m_socket = GetNode ()->GetObject<TcpL4Protocol> ()->CreateSocket (m_congestion);
+        m_socket->Bind ();
+        m_socket->Connect (m_peer);
+        m_socket->ShutdownRecv ();
+        m_socket->SetConnectCallback (MakeCallback (&FlowSender::Connected, this),
+                                      MakeNullCallback<void, Ptr<Socket>> ());
+        m_socket->SetSendCallback (MakeCallback (&FlowSender::Sent, this));
+    }
+
+    void StopApplication () override
+    {
+        if (m_socket)
+        {
+            m_socket->Close ();
+            m_connected = false;
+        }
+    }
+
+    void Connected (Ptr<Socket>)
+    {
+        m_connected = true;
+        Send ();
+    }
+
+    void Sent (Ptr<Socket>, uint32_t)
+    {
+        if (m_connected)
+        {
+            Send ();
+        }
+    }
+
+    // Fills the send buffer, the same way BulkSendApplication does.
+    void Send ()
+    {
+        while (m_maxBytes == 0 || m_sentBytes < m_maxBytes)
+        {
+            uint32_t size = m_maxBytes == 0 ? m_sendSize : uint32_t (std::min<uint64_t> (m_sendSize, m_maxBytes - m_sentBytes));
+            if (m_socket->Send (Create<Packet> (size)) != int (size))
+            {
+                return;
+            }
+            m_sentBytes += size;
+        }
+        m_socket->Close ();
+        m_connected = false;
+    }
+
+    Address m_peer;
+    TypeId m_congestion;
+    uint32_t m_sendSize = 512;
+    uint64_t m_maxBytes = 0;
+    uint64_t m_sentBytes = 0;
+    Ptr<Socket> m_socket;
+    bool m_connected = false;
+};
+
+NS_OBJECT_ENSURE_REGISTERED (FlowSender);
+
+// A FlowSender on node towards remote using the named congestion control.
+inline Ptr<Application> InstallFlowSender (Ptr<Node> node, const Address& remote, const std::string& variant,
+                                           uint32_t sendSize = 512)
+{
+    Ptr<FlowSender> sender = CreateObject<FlowSender> ();
+    sender->SetAttribute ("Remote", AddressValue (remote));
+    sender->SetAttribute ("CongestionControl", TypeIdValue (GetTcpVariant (variant)));
+    sender->SetAttribute ("SendSize", UintegerValue (sendSize));
+    node->AddApplication (sender);
+    return sender;
+}
+
+} // namespace ns3
+
+#endif // TCP_VARIANTS_H